@@ -0,0 +1,49 @@
+#include "accesstracker_p.h"
+
+#include <QtCore/QDateTime>
+
+using namespace QtDataSync;
+
+const int AccessTracker::FlushThreshold = 100;
+
+namespace {
+
+QSet<QByteArray> recentTypes(const QVariantHash &preloadPolicies)
+{
+	QSet<QByteArray> types;
+	for(auto it = preloadPolicies.constBegin(); it != preloadPolicies.constEnd(); it++) {
+		if(it.value().toInt() > 0)
+			types.insert(it.key().toUtf8());
+	}
+	return types;
+}
+
+}
+
+AccessTracker::AccessTracker(const QVariantHash &preloadPolicies) :
+	_trackedTypes{recentTypes(preloadPolicies)}
+{}
+
+bool AccessTracker::isTracked(const QByteArray &typeName) const
+{
+	return _trackedTypes.contains(typeName);
+}
+
+bool AccessTracker::record(const ObjectKey &key)
+{
+	//the types never change, so untracked loads do not need the lock
+	if(!isTracked(key.typeName))
+		return false;
+
+	QMutexLocker _(&_mutex);
+	_pending.insert(key, QDateTime::currentMSecsSinceEpoch());
+	return _pending.size() >= FlushThreshold;
+}
+
+QHash<ObjectKey, qint64> AccessTracker::take()
+{
+	QMutexLocker _(&_mutex);
+	QHash<ObjectKey, qint64> pending;
+	pending.swap(_pending);
+	return pending;
+}
@@ -0,0 +1,39 @@
+#ifndef QTDATASYNC_ACCESSTRACKER_P_H
+#define QTDATASYNC_ACCESSTRACKER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QMutex>
+#include <QtCore/QVariant>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+
+namespace QtDataSync {
+
+//no export needed
+class AccessTracker
+{
+	Q_DISABLE_COPY(AccessTracker)
+
+public:
+	static const int FlushThreshold;
+
+	//only types preloaded by recency are tracked
+	explicit AccessTracker(const QVariantHash &preloadPolicies);
+
+	bool isTracked(const QByteArray &typeName) const;
+	//returns true once enough accesses are pending to be worth writing
+	bool record(const ObjectKey &key);
+	//the accesses since the last call, as (key, msecs since epoch)
+	QHash<ObjectKey, qint64> take();
+
+private:
+	const QSet<QByteArray> _trackedTypes;
+	QMutex _mutex;
+	QHash<ObjectKey, qint64> _pending;
+};
+
+}
+
+#endif // QTDATASYNC_ACCESSTRACKER_P_H
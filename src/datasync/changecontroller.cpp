@@ -43,6 +43,8 @@ void ChangeController::clearUploads()
 		logDebug() << "Finished uploading changes";
 	_activeUploads.clear();
 	_changeEstimate = 0;
+	_changeCursor = 0;
+	_deviceUploads.clear();
 }
 
 void ChangeController::updateUploadLimit(quint32 limit)
@@ -85,7 +87,22 @@ void ChangeController::deviceUploadDone(const QByteArray &key, QUuid deviceId)
 
 	try {
 		auto info = _activeUploads.take({key, deviceId});
-		_store->removeDeviceChange(info.key, deviceId);
+
+		//the device cursor can only move over uploads that are all completed
+		auto &uploads = _deviceUploads[deviceId];
+		for(auto &upload : uploads) {
+			if(upload.key == info.key) {
+				upload.done = true;
+				break;
+			}
+		}
+		ObjectKey lastKey;
+		while(!uploads.isEmpty() && uploads.first().done)
+			lastKey = uploads.takeFirst().key;
+		if(uploads.isEmpty())
+			_deviceUploads.remove(deviceId);
+		if(!lastKey.typeName.isNull())
+			_store->completeDeviceChanges(lastKey, deviceId);
 		_changeEstimate--;
 		emit progressIncrement();
 		logDebug() << "Completed device upload. Marked"
@@ -132,13 +149,22 @@ void ChangeController::uploadNext(bool emitStarted)
 			}
 		}
 
-		_store->loadChanges(_uploadLimit, [this, emitProgress, &emitStarted](const ObjectKey &objKey, quint64 version, const QString &file, QUuid deviceId) {
+		_store->loadChanges(_uploadLimit, _changeCursor, [this, emitProgress, &emitStarted](const ObjectKey &objKey, quint64 version, const QString &file, QUuid deviceId) {
 			CachedObjectKey key(objKey, deviceId);
 
 			//skip stuff already beeing uploaded (could still have changed, but to prevent errors)
 //			auto skip = false;
 			if(_activeUploads.contains(key))
 				return true;
+			if(!deviceId.isNull()) {
+				//completed device uploads stay until the cursor moves past them
+				auto &uploads = _deviceUploads[deviceId];
+				for(const auto &upload : qAsConst(uploads)) {
+					if(upload.key == objKey)
+						return true;
+				}
+				uploads.append({objKey, false});
+			}
 //			for(const auto &mKey : _activeUploads.keys()) {
 //				if(key == mKey) {
 //					skip = true;
@@ -187,8 +213,14 @@ void ChangeController::uploadNext(bool emitStarted)
 					}
 				} catch (Exception &e) {
 					logWarning() << "Failed to read json for upload. Assuming unchanged. Error:" << e.what();
-					QMetaObject::invokeMethod(this, "uploadDone", Qt::QueuedConnection,
-											  Q_ARG(QByteArray, keyHash));
+					if(deviceId.isNull()) {
+						QMetaObject::invokeMethod(this, "uploadDone", Qt::QueuedConnection,
+												  Q_ARG(QByteArray, keyHash));
+					} else {
+						QMetaObject::invokeMethod(this, "deviceUploadDone", Qt::QueuedConnection,
+												  Q_ARG(QByteArray, keyHash),
+												  Q_ARG(QUuid, deviceId));
+					}
 				}
 			}
 
@@ -196,6 +228,7 @@ void ChangeController::uploadNext(bool emitStarted)
 		});
 
 		if(_activeUploads.isEmpty()) {
+			_changeCursor = 0; //start over for the next round, to catch anything that was skipped
 			endOp(); //stop any timeouts
 			logDebug() << "Finished uploading changes";
 			emit uploadingChanged(false);
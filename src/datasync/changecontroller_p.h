@@ -74,6 +74,10 @@ private:
 		quint64 version;
 		bool isDelete;
 	};
+	struct DeviceUpload {
+		ObjectKey key;
+		bool done;
+	};
 
 	LocalStore *_store = nullptr;
 	ChangeEmitter *_emitter = nullptr;
@@ -81,6 +85,8 @@ private:
 	int _uploadLimit = 10;
 	QHash<CachedObjectKey, UploadInfo> _activeUploads;
 	quint32 _changeEstimate = 0;
+	quint64 _changeCursor = 0;
+	QHash<QUuid, QList<DeviceUpload>> _deviceUploads; //in the order of the store, until completed without gaps
 };
 
 //not exported, just like the class
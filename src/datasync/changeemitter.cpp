@@ -3,7 +3,8 @@ using namespace QtDataSync;
 
 ChangeEmitter::ChangeEmitter(const Defaults &defaults, QObject *parent) :
 	ChangeEmitterSource{parent},
-	_cache{defaults.cacheHandle().value<QSharedPointer<EmitterAdapter::CacheInfo>>()}
+	_cache{defaults.cacheHandle().value<QSharedPointer<ObjectCache>>()},
+	_keyFilter{defaults.keyFilter()}
 {}
 
 void ChangeEmitter::triggerChange(QObject *origin, const ObjectKey &key, bool deleted, bool changed)
@@ -14,6 +15,16 @@ void ChangeEmitter::triggerChange(QObject *origin, const ObjectKey &key, bool de
 	emit remoteDataChanged(key, deleted);
 }
 
+void ChangeEmitter::triggerChanges(QObject *origin, const QByteArray &typeName, const QStringList &ids, bool changed)
+{
+	if(changed)
+		emit uploadNeeded();
+	for(const auto &id : ids) {
+		emit dataChanged(origin, {typeName, id}, false);
+		emit remoteDataChanged({typeName, id}, false);
+	}
+}
+
 void ChangeEmitter::triggerClear(QObject *origin, const QByteArray &typeName, const QStringList &ids)
 {
 	emit uploadNeeded();
@@ -37,32 +48,33 @@ void ChangeEmitter::triggerUpload()
 
 void ChangeEmitter::triggerRemoteChange(const ObjectKey &key, bool deleted, bool changed)
 {
-	if(_cache) {
-		auto contains = false;
-		//check if cached
-		{
-			QReadLocker _(&_cache->lock);
-			contains = _cache->cache.contains(key);
-		}
-		//if chached, remove
-		if(contains) {
-			QWriteLocker _(&_cache->lock);
-			_cache->cache.remove(key);
-		}
-	}
+	if(_cache)
+		_cache->remove(key);
+	if(!deleted)
+		_keyFilter->insert(key);
 	if(changed)
 		emit uploadNeeded();
 	emit dataChanged(nullptr, key, deleted);
 	emit remoteDataChanged(key, deleted);
 }
 
-void ChangeEmitter::triggerRemoteClear(const QByteArray &typeName, const QStringList &ids)
+void ChangeEmitter::triggerRemoteChanges(const QByteArray &typeName, const QStringList &ids, bool changed)
 {
-	if(_cache) {
-		QWriteLocker _(&_cache->lock);
-		for(const auto &id : ids)
-			_cache->cache.remove({typeName, id});
+	if(_cache)
+		_cache->remove(typeName, ids);
+	_keyFilter->insert(typeName, ids);
+	if(changed)
+		emit uploadNeeded();
+	for(const auto &id : ids) {
+		emit dataChanged(nullptr, {typeName, id}, false);
+		emit remoteDataChanged({typeName, id}, false);
 	}
+}
+
+void ChangeEmitter::triggerRemoteClear(const QByteArray &typeName, const QStringList &ids)
+{
+	if(_cache)
+		_cache->remove(typeName, ids);
 	emit uploadNeeded();
 	for(const auto &id : ids) {
 		emit dataChanged(nullptr, {typeName, id}, true);
@@ -72,10 +84,8 @@ void ChangeEmitter::triggerRemoteClear(const QByteArray &typeName, const QString
 
 void ChangeEmitter::triggerRemoteReset()
 {
-	if(_cache) {
-		QWriteLocker _(&_cache->lock);
-		_cache->cache.clear();
-	}
+	if(_cache)
+		_cache->clear();
 	emit uploadNeeded();
 	emit dataResetted(nullptr);
 	emit remoteDataResetted();
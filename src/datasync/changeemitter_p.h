@@ -7,6 +7,7 @@
 #include "qtdatasync_global.h"
 #include "defaults.h"
 #include "emitteradapter_p.h"
+#include "keyfilter_p.h"
 
 #include "rep_changeemitter_p_source.h"
 
@@ -25,6 +26,7 @@ public Q_SLOTS:
 					   const QtDataSync::ObjectKey &key,
 					   bool deleted,
 					   bool changed);
+	void triggerChanges(QObject *origin, const QByteArray &typeName, const QStringList &ids, bool changed);
 	void triggerClear(QObject *origin, const QByteArray &typeName, const QStringList &ids);
 	void triggerReset(QObject *origin);
 	void triggerUpload() override;
@@ -38,11 +40,13 @@ Q_SIGNALS:
 protected Q_SLOTS:
 	//remcon interface
 	void triggerRemoteChange(const ObjectKey &key, bool deleted, bool changed) override;
+	void triggerRemoteChanges(const QByteArray &typeName, const QStringList &ids, bool changed) override;
 	void triggerRemoteClear(const QByteArray &typeName, const QStringList &ids) override;
 	void triggerRemoteReset() override;
 
 private:
-	QSharedPointer<EmitterAdapter::CacheInfo> _cache;//needed to clear cache on remote changes
+	QSharedPointer<ObjectCache> _cache;//needed to clear cache on remote changes
+	KeyFilter *_keyFilter;//needed to add keys saved by passive setups
 };
 
 }
@@ -1,6 +1,9 @@
 #include "datastore.h"
 #include "datastore_p.h"
 #include "defaults_p.h"
+#include "gadgetserializer_p.h"
+
+#include <QtCore/QCoreApplication>
 
 #include <QtJsonSerializer/QJsonSerializer>
 
@@ -54,50 +57,63 @@ QVariantList DataStore::loadAll(int metaTypeId) const
 	QVariantList resList;
 	resList.reserve(allData.size());
 	for(const auto &val : allData)
-		resList.append(d->serializer->deserialize(val, metaTypeId));
+		resList.append(d->deserialize(val, metaTypeId));
 	return resList;
 }
 
 QVariant DataStore::load(int metaTypeId, const QString &key) const
 {
-	auto data = d->store->load({d->typeName(metaTypeId), key});
-	return d->serializer->deserialize(data, metaTypeId);
+	ObjectKey objectKey{d->typeName(metaTypeId), key};
+	QVariant value;
+	auto typedCache = DataStorePrivate::isTypedCacheable(metaTypeId);
+	if(typedCache && d->store->loadTyped(objectKey, metaTypeId, value))
+		return value;
+
+	quint64 generation = 0;
+	auto data = d->store->load(objectKey, &generation);
+	value = d->deserialize(data, metaTypeId);
+	if(typedCache)
+		d->store->cacheTyped(objectKey, generation, metaTypeId, value);
+	return value;
 }
 
-void DataStore::save(int metaTypeId, QVariant value)
+bool DataStore::tryLoad(int metaTypeId, const QString &key, QVariant &value) const
 {
-	auto typeName = d->typeName(metaTypeId);
-	if(!value.convert(metaTypeId))
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Failed to convert passed variant to the target type"));
+	ObjectKey objectKey{d->typeName(metaTypeId), key};
+	auto typedCache = DataStorePrivate::isTypedCacheable(metaTypeId);
+	if(typedCache && d->store->loadTyped(objectKey, metaTypeId, value))
+		return true;
+
+	QJsonObject data;
+	quint64 generation = 0;
+	if(!d->store->tryLoad(objectKey, data, &generation))
+		return false;
+	value = d->deserialize(data, metaTypeId);
+	if(typedCache)
+		d->store->cacheTyped(objectKey, generation, metaTypeId, value);
+	return true;
+}
 
-	auto meta = QMetaType::metaObjectForType(metaTypeId);
-	if(!meta)
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Type does not have a meta object"));
-	auto userProp = meta->userProperty();
-	if(!userProp.isValid())
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Type does not have a user property"));
+bool DataStore::contains(int metaTypeId, const QString &key) const
+{
+	return d->store->contains({d->typeName(metaTypeId), key});
+}
 
-	QString key;
-	auto flags = QMetaType::typeFlags(metaTypeId);
-	if(flags.testFlag(QMetaType::IsGadget))
-		key = userProp.readOnGadget(value.data()).toString();
-	else if(flags.testFlag(QMetaType::PointerToQObject))
-		key = userProp.read(value.value<QObject*>()).toString();
-	else if(flags.testFlag(QMetaType::SharedPointerToQObject))
-		key = userProp.read(value.value<QSharedPointer<QObject>>().data()).toString();
-	else if(flags.testFlag(QMetaType::WeakPointerToQObject))
-		key = userProp.read(value.value<QWeakPointer<QObject>>().data()).toString();
-	else if(flags.testFlag(QMetaType::TrackingPointerToQObject))
-		key = userProp.read(value.value<QPointer<QObject>>().data()).toString();
-	else
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Type is neither a gadget nor a pointer to an object"));
+void DataStore::save(int metaTypeId, QVariant value)
+{
+	auto typeName = d->typeName(metaTypeId);
+	auto data = d->serialize(typeName, metaTypeId, std::move(value));
+	d->store->save({typeName, data.first}, data.second);
+}
 
-	if(key.isEmpty())
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Failed to convert USER property to a string"));
-	auto json = d->serializer->serialize(value);
-	if(!json.isObject())
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Serialization converted to invalid json type. Only json objects are allowed"));
-	d->store->save({typeName, key}, json.toObject());
+void DataStore::saveAll(int metaTypeId, const QVariantList &values)
+{
+	auto typeName = d->typeName(metaTypeId);
+	QList<QPair<QString, QJsonObject>> dataList;
+	dataList.reserve(values.size());
+	for(const auto &value : values)
+		dataList.append(d->serialize(typeName, metaTypeId, value));
+	d->store->saveBatch(typeName, dataList);
 }
 
 bool DataStore::remove(int metaTypeId, const QString &key)
@@ -140,16 +156,33 @@ QVariantList DataStore::search(int metaTypeId, const QString &query, SearchMode
 	QVariantList resList;
 	resList.reserve(dataList.size());
 	for(const auto &val : dataList)
-		resList.append(d->serializer->deserialize(val, metaTypeId));
+		resList.append(d->deserialize(val, metaTypeId));
+	return resList;
+}
+
+QVariantList DataStore::query(int metaTypeId, const QString &property, QueryOperator op, const QVariant &value) const
+{
+	const auto allData = d->store->query(d->typeName(metaTypeId), property, op, value);
+	QVariantList resList;
+	resList.reserve(allData.size());
+	for(const auto &val : allData)
+		resList.append(d->deserialize(val, metaTypeId));
 	return resList;
 }
 
 void DataStore::iterate(int metaTypeId, const function<bool (QVariant)> &iterator) const
 {
-	for(const auto &key : keys(metaTypeId)) {
-		if(!iterator(load(metaTypeId, key)))
-			break;
-	}
+	iterate(metaTypeId, iterator, DataStorePrivate::DefaultPageSize);
+}
+
+void DataStore::iterate(int metaTypeId, const function<bool (QVariant)> &iterator, int pageSize, bool useCache) const
+{
+	if(pageSize <= 0)
+		pageSize = DataStorePrivate::DefaultPageSize;
+	d->store->iterate(d->typeName(metaTypeId), pageSize, useCache, [&](const QString &key, const QJsonObject &data) {
+		Q_UNUSED(key)
+		return iterator(d->deserialize(data, metaTypeId));
+	});
 }
 
 void DataStore::clear(int metaTypeId)
@@ -157,14 +190,126 @@ void DataStore::clear(int metaTypeId)
 	d->store->clear(d->typeName(metaTypeId));
 }
 
+void DataStore::flush()
+{
+	d->store->flush();
+}
+
+QFuture<QVariant> DataStore::loadAsync(int metaTypeId, const QString &key) const
+{
+	QFutureInterface<QVariant> futureInterface;
+	auto thread = QThread::currentThread();
+	runAsync(futureInterface, [futureInterface, metaTypeId, key, thread](DataStore *store) mutable {
+		auto value = store->load(metaTypeId, key);
+		DataStorePrivate::moveToThread(value, metaTypeId, thread);
+		futureInterface.reportResult(value);
+	});
+	return futureInterface.future();
+}
+
+QFuture<QVariant> DataStore::loadAllAsync(int metaTypeId, int chunkSize) const
+{
+	if(chunkSize <= 0)
+		chunkSize = DataStorePrivate::DefaultPageSize;
+
+	QFutureInterface<QVariant> futureInterface;
+	auto thread = QThread::currentThread();
+	runAsync(futureInterface, [futureInterface, metaTypeId, chunkSize, thread](DataStore *store) mutable {
+		QVector<QVariant> chunk;
+		chunk.reserve(chunkSize);
+		store->iterate(metaTypeId, [&](QVariant value) {
+			DataStorePrivate::moveToThread(value, metaTypeId, thread);
+			chunk.append(value);
+			if(chunk.size() == chunkSize) {
+				futureInterface.reportResults(chunk);
+				chunk.clear();
+			}
+			return !futureInterface.isCanceled();
+		}, chunkSize);
+		if(!chunk.isEmpty())
+			futureInterface.reportResults(chunk);
+	});
+	return futureInterface.future();
+}
+
+QFuture<void> DataStore::saveAsync(int metaTypeId, QVariant value)
+{
+	QFutureInterface<void> futureInterface;
+	//objects belong to the calling thread, so the value is serialized here and only the json is passed on
+	QByteArray typeName;
+	QPair<QString, QJsonObject> data;
+	try {
+		typeName = d->typeName(metaTypeId);
+		data = d->serialize(typeName, metaTypeId, std::move(value));
+	} catch(QException &e) {
+		futureInterface.reportStarted();
+		futureInterface.reportException(e);
+		futureInterface.reportFinished();
+		return futureInterface.future();
+	}
+
+	runAsync(futureInterface, [typeName, data](DataStore *store) {
+		store->d->store->save({typeName, data.first}, data.second);
+	});
+	return futureInterface.future();
+}
+
+QFuture<bool> DataStore::removeAsync(int metaTypeId, const QString &key)
+{
+	QFutureInterface<bool> futureInterface;
+	runAsync(futureInterface, [futureInterface, metaTypeId, key](DataStore *store) mutable {
+		futureInterface.reportResult(store->remove(metaTypeId, key));
+	});
+	return futureInterface.future();
+}
+
+QFuture<QVariant> DataStore::searchAsync(int metaTypeId, const QString &query, SearchMode mode) const
+{
+	QFutureInterface<QVariant> futureInterface;
+	auto thread = QThread::currentThread();
+	runAsync(futureInterface, [futureInterface, metaTypeId, query, mode, thread](DataStore *store) mutable {
+		auto values = store->search(metaTypeId, query, mode);
+		for(auto &value : values)
+			DataStorePrivate::moveToThread(value, metaTypeId, thread);
+		futureInterface.reportResults(values.toVector());
+	});
+	return futureInterface.future();
+}
+
+void DataStore::runAsync(QFutureInterfaceBase futureInterface, const function<void(DataStore*)> &task) const
+{
+	futureInterface.reportStarted();
+	d->defaults.asyncPool()->start(new DataStoreTask{d->defaults.setupName(), futureInterface, task});
+}
+
 // ------------- PRIVATE IMPLEMENTATION -------------
 
+const int DataStorePrivate::DefaultPageSize = 100;
+QThreadStorage<DataStore*> DataStorePrivate::asyncStores;
+
 DataStorePrivate::DataStorePrivate(DataStore *q, const QString &setupName) :
 	defaults{DefaultsPrivate::obtainDefaults(setupName)},
 	logger{defaults.createLogger("datastore", q)},
 	serializer{defaults.serializer()},
 	store{new LocalStore(defaults, q)}
-{}
+{
+	for(const auto &typeName : defaults.property(Defaults::DirectSerializedTypes).toStringList())
+		directTypes.insert(QMetaType::type(typeName.toUtf8()));
+}
+
+void DataStorePrivate::moveToThread(const QVariant &value, int metaTypeId, QThread *thread)
+{
+	if(QMetaType::typeFlags(metaTypeId).testFlag(QMetaType::PointerToQObject)) {
+		auto object = value.value<QObject*>();
+		if(object)
+			object->moveToThread(thread);
+	}
+}
+
+bool DataStorePrivate::isTypedCacheable(int metaTypeId)
+{
+	return QMetaType::typeFlags(metaTypeId).testFlag(QMetaType::IsGadget);
+}
 
 QByteArray DataStorePrivate::typeName(int metaTypeId) const
 {
@@ -175,6 +320,86 @@ QByteArray DataStorePrivate::typeName(int metaTypeId) const
 		throw InvalidDataException(defaults, "type_" + QByteArray::number(metaTypeId), QStringLiteral("Not a valid metatype id"));
 }
 
+QPair<QString, QJsonObject> DataStorePrivate::serialize(const QByteArray &typeName, int metaTypeId, QVariant value) const
+{
+	if(!value.convert(metaTypeId))
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Failed to convert passed variant to the target type"));
+
+	auto direct = directTypes.contains(metaTypeId) ? GadgetSerializer::forType(metaTypeId) : nullptr;
+	if(direct) {
+		auto key = direct->key(value.constData());
+		if(key.isEmpty())
+			throw InvalidDataException(defaults, typeName, QStringLiteral("Failed to convert USER property to a string"));
+		return {key, direct->serialize(value.constData())};
+	}
+
+	auto meta = QMetaType::metaObjectForType(metaTypeId);
+	if(!meta)
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Type does not have a meta object"));
+	auto userProp = meta->userProperty();
+	if(!userProp.isValid())
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Type does not have a user property"));
+
+	QString key;
+	auto flags = QMetaType::typeFlags(metaTypeId);
+	if(flags.testFlag(QMetaType::IsGadget))
+		key = userProp.readOnGadget(value.data()).toString();
+	else if(flags.testFlag(QMetaType::PointerToQObject))
+		key = userProp.read(value.value<QObject*>()).toString();
+	else if(flags.testFlag(QMetaType::SharedPointerToQObject))
+		key = userProp.read(value.value<QSharedPointer<QObject>>().data()).toString();
+	else if(flags.testFlag(QMetaType::WeakPointerToQObject))
+		key = userProp.read(value.value<QWeakPointer<QObject>>().data()).toString();
+	else if(flags.testFlag(QMetaType::TrackingPointerToQObject))
+		key = userProp.read(value.value<QPointer<QObject>>().data()).toString();
+	else
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Type is neither a gadget nor a pointer to an object"));
+
+	if(key.isEmpty())
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Failed to convert USER property to a string"));
+	auto json = serializer->serialize(value);
+	if(!json.isObject())
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Serialization converted to invalid json type. Only json objects are allowed"));
+	return {key, json.toObject()};
+}
+
+QVariant DataStorePrivate::deserialize(const QJsonObject &data, int metaTypeId) const
+{
+	auto direct = directTypes.contains(metaTypeId) ? GadgetSerializer::forType(metaTypeId) : nullptr;
+	if(direct) {
+		QVariant value{metaTypeId, nullptr};
+		if(direct->deserialize(data, value.data()))
+			return value;
+	}
+	return serializer->deserialize(data, metaTypeId);
+}
+
+DataStoreTask::DataStoreTask(QString setupName, QFutureInterfaceBase futureInterface, function<void(DataStore*)> task) :
+	_setupName{std::move(setupName)},
+	_futureInterface{std::move(futureInterface)},
+	_task{std::move(task)}
+{}
+
+void DataStoreTask::run()
+{
+	if(!_futureInterface.isCanceled()) {
+		try {
+			//every worker keeps its own store, and thus database connection, until the thread exits
+			if(!DataStorePrivate::asyncStores.hasLocalData())
+				DataStorePrivate::asyncStores.setLocalData(new DataStore{_setupName});
+			_task(DataStorePrivate::asyncStores.localData());
+		} catch(QException &e) {
+			_futureInterface.reportException(e);
+		} catch(std::exception &) {
+			_futureInterface.reportException(QUnhandledException{});
+		}
+	}
+	_futureInterface.reportFinished();
+
+	//workers have no event loop, so the change notifications sent to the store must be processed here
+	QCoreApplication::sendPostedEvents();
+}
+
 // ------------- Exceptions -------------
 
 DataStoreException::DataStoreException(const Defaults &defaults, const QString &message) :
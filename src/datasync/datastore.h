@@ -6,6 +6,9 @@
 #include <QtCore/qobject.h>
 #include <QtCore/qscopedpointer.h>
 #include <QtCore/qvariant.h>
+#include <QtCore/qfuture.h>
+#include <QtCore/qfutureinterface.h>
+#include <QtCore/qthread.h>
 
 #include "QtDataSync/qtdatasync_global.h"
 #include "QtDataSync/objectkey.h"
@@ -31,10 +34,22 @@ public:
 		WildcardMode, //!< Interpret the search string as a wildcard string (with * and ?)
 		ContainsMode, //!< The data key must contain the search string
 		StartsWithMode, //!< The data key must start with the search string
-		EndsWithMode //!< The data key must end with the search string
+		EndsWithMode, //!< The data key must end with the search string
+		FullTextMode //!< Search the full text index of the type with a FTS5 query. Results are ordered by relevance. See Setup::addFullTextIndex
 	};
 	Q_ENUM(SearchMode)
 
+	//! Possible comparisons of a property with a value for DataStore::query
+	enum QueryOperator {
+		EqualTo, //!< The property must be equal to the value
+		NotEqualTo, //!< The property must not be equal to the value
+		LessThan, //!< The property must be less than the value
+		LessOrEqual, //!< The property must be less than or equal to the value
+		GreaterThan, //!< The property must be greater than the value
+		GreaterOrEqual //!< The property must be greater than or equal to the value
+	};
+	Q_ENUM(QueryOperator)
+
 	//! Default constructor, uses the default setup
 	explicit DataStore(QObject *parent = nullptr);
 	//! Constructor with an explicit setup
@@ -53,8 +68,18 @@ public:
 	inline QVariant load(int metaTypeId, const QVariant &key) const {
 		return load(metaTypeId, key.toString());
 	}
+	//! @copybrief DataStore::tryLoad(const QString &, T &) const
+	bool tryLoad(int metaTypeId, const QString &key, QVariant &value) const;
+	//! @copybrief DataStore::contains(const QString &) const
+	bool contains(int metaTypeId, const QString &key) const;
+	//! @copybrief DataStore::contains(int, const QString &) const
+	inline bool contains(int metaTypeId, const QVariant &key) const {
+		return contains(metaTypeId, key.toString());
+	}
 	//! @copybrief DataStore::save(const T &)
 	void save(int metaTypeId, QVariant value);
+	//! @copybrief DataStore::saveAll(const QList<T> &)
+	void saveAll(int metaTypeId, const QVariantList &values);
 	//! @copybrief DataStore::remove(const QString &)
 	bool remove(int metaTypeId, const QString &key);
 	//! @copybrief DataStore::remove(int, const QString &)
@@ -65,11 +90,30 @@ public:
 	void update(int metaTypeId, QObject *object) const;
 	//! @copybrief DataStore::search(const QString &, SearchMode) const
 	QVariantList search(int metaTypeId, const QString &query, SearchMode mode = RegexpMode) const;
+	//! @copybrief DataStore::query(const QString &, QueryOperator, const QVariant &) const
+	QVariantList query(int metaTypeId, const QString &property, QueryOperator op, const QVariant &value) const;
 	//! @copybrief DataStore::iterate(const std::function<bool(T)> &) const
 	void iterate(int metaTypeId,
 				 const std::function<bool(QVariant)> &iterator) const;
+	//! @copybrief DataStore::iterate(const std::function<bool(T)> &, int, bool) const
+	void iterate(int metaTypeId,
+				 const std::function<bool(QVariant)> &iterator,
+				 int pageSize,
+				 bool useCache = false) const;
 	//! @copybrief DataStore::clear()
 	void clear(int metaTypeId);
+	//! @copybrief DataStore::loadAsync(const QString &) const
+	QFuture<QVariant> loadAsync(int metaTypeId, const QString &key) const;
+	//! @copybrief DataStore::loadAllAsync(int) const
+	QFuture<QVariant> loadAllAsync(int metaTypeId, int chunkSize = 100) const;
+	//! @copybrief DataStore::saveAsync(const T &)
+	QFuture<void> saveAsync(int metaTypeId, QVariant value);
+	//! @copybrief DataStore::removeAsync(const QString &)
+	QFuture<bool> removeAsync(int metaTypeId, const QString &key);
+	//! @copybrief DataStore::searchAsync(const QString &, SearchMode) const
+	QFuture<QVariant> searchAsync(int metaTypeId, const QString &query, SearchMode mode = RegexpMode) const;
+	//! Writes all datasets that are kept in memory because of the Setup::coalescingWindow
+	void flush();
 
 	//! Counts the number of datasets for the given type
 	template<typename T>
@@ -93,9 +137,24 @@ public:
 	//! @copybrief DataStore::load(const QString &) const
 	template<typename T, typename K>
 	T load(const K &key) const;
+	//! Loads the dataset with the given key for the given type, if it exists
+	template<typename T>
+	bool tryLoad(const QString &key, T &value) const;
+	//! @copybrief DataStore::tryLoad(const QString &, T &) const
+	template<typename T, typename K>
+	bool tryLoad(const K &key, T &value) const;
+	//! Checks if a dataset with the given key exists for the given type
+	template<typename T>
+	bool contains(const QString &key) const;
+	//! @copybrief DataStore::contains(const QString &) const
+	template<typename T, typename K>
+	bool contains(const K &key) const;
 	//! Saves the given dataset in the store
 	template<typename T>
 	void save(const T &value);
+	//! Saves all the given datasets in the store at once
+	template<typename T>
+	void saveAll(const QList<T> &values);
 	//! Removes the dataset with the given key for the given type
 	template<typename T>
 	bool remove(const QString &key);
@@ -108,12 +167,33 @@ public:
 	//! Searches the store for datasets of the given type where the key matches the query
 	template<typename T>
 	QList<T> search(const QString &query, SearchMode mode = RegexpMode) const;
+	//! Searches the store for datasets of the given type where an indexed property matches the value
+	template<typename T>
+	QList<T> query(const QString &property, QueryOperator op, const QVariant &value) const;
 	//! Iterates over all existing datasets of the given types
 	template<typename T>
 	void iterate(const std::function<bool(T)> &iterator) const;
+	//! Iterates over all existing datasets of the given types, loading them in pages of the given size
+	template<typename T>
+	void iterate(const std::function<bool(T)> &iterator, int pageSize, bool useCache = false) const;
 	//! Removes all datasets of the given type from the store
 	template<typename T>
 	void clear();
+	//! Asynchronously loads the dataset with the given key for the given type
+	template<typename T>
+	QFuture<T> loadAsync(const QString &key) const;
+	//! Asynchronously loads all existing datasets for the given type, reporting them in chunks
+	template<typename T>
+	QFuture<T> loadAllAsync(int chunkSize = 100) const;
+	//! Asynchronously saves the given dataset in the store
+	template<typename T>
+	QFuture<void> saveAsync(const T &value);
+	//! Asynchronously removes the dataset with the given key for the given type
+	template<typename T>
+	QFuture<bool> removeAsync(const QString &key);
+	//! Asynchronously searches the store for datasets of the given type where the key matches the query
+	template<typename T>
+	QFuture<T> searchAsync(const QString &query, SearchMode mode = RegexpMode) const;
 
 Q_SIGNALS:
 	//! Is emitted whenever a dataset has been changed
@@ -131,6 +211,8 @@ protected:
 
 private:
 	QScopedPointer<DataStorePrivate> d;
+
+	void runAsync(QFutureInterfaceBase futureInterface, const std::function<void(DataStore*)> &task) const;
 };
 
 
@@ -268,6 +350,42 @@ T DataStore::load(const K &key) const
 	return load(qMetaTypeId<T>(), QVariant::fromValue(key)).template value<T>();
 }
 
+template<typename T>
+bool DataStore::tryLoad(const QString &key, T &value) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QVariant variant;
+	if(!tryLoad(qMetaTypeId<T>(), key, variant))
+		return false;
+	value = variant.template value<T>();
+	return true;
+}
+
+template<typename T, typename K>
+bool DataStore::tryLoad(const K &key, T &value) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QVariant variant;
+	if(!tryLoad(qMetaTypeId<T>(), QVariant::fromValue(key).toString(), variant))
+		return false;
+	value = variant.template value<T>();
+	return true;
+}
+
+template<typename T>
+bool DataStore::contains(const QString &key) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return contains(qMetaTypeId<T>(), key);
+}
+
+template<typename T, typename K>
+bool DataStore::contains(const K &key) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return contains(qMetaTypeId<T>(), QVariant::fromValue(key));
+}
+
 template<typename T>
 void DataStore::save(const T &value)
 {
@@ -275,6 +393,17 @@ void DataStore::save(const T &value)
 	save(qMetaTypeId<T>(), QVariant::fromValue(value));
 }
 
+template<typename T>
+void DataStore::saveAll(const QList<T> &values)
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QVariantList vList;
+	vList.reserve(values.size());
+	for(const auto &value : values)
+		vList.append(QVariant::fromValue(value));
+	saveAll(qMetaTypeId<T>(), vList);
+}
+
 template<typename T>
 bool DataStore::remove(const QString &key)
 {
@@ -306,6 +435,16 @@ QList<T> DataStore::search(const QString &query, SearchMode mode) const
 	return rList;
 }
 
+template<typename T>
+QList<T> DataStore::query(const QString &property, QueryOperator op, const QVariant &value) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QList<T> rList;
+	for(auto v : query(qMetaTypeId<T>(), property, op, value))
+		rList.append(v.template value<T>());
+	return rList;
+}
+
 template<typename T>
 void DataStore::iterate(const std::function<bool (T)> &iterator) const
 {
@@ -315,6 +454,15 @@ void DataStore::iterate(const std::function<bool (T)> &iterator) const
 	});
 }
 
+template<typename T>
+void DataStore::iterate(const std::function<bool (T)> &iterator, int pageSize, bool useCache) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	iterate(qMetaTypeId<T>(), [iterator](const QVariant &v) {
+		return iterator(v.template value<T>());
+	}, pageSize, useCache);
+}
+
 template<typename T>
 void DataStore::clear()
 {
@@ -322,6 +470,77 @@ void DataStore::clear()
 	clear(qMetaTypeId<T>());
 }
 
+template<typename T>
+QFuture<T> DataStore::loadAsync(const QString &key) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QFutureInterface<T> futureInterface;
+	auto thread = QThread::currentThread();
+	runAsync(futureInterface, [futureInterface, key, thread](DataStore *store) mutable {
+		auto value = store->load<T>(key);
+		__helpertypes::move_to_thread(value, thread);
+		futureInterface.reportResult(value);
+	});
+	return futureInterface.future();
+}
+
+template<typename T>
+QFuture<T> DataStore::loadAllAsync(int chunkSize) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QFutureInterface<T> futureInterface;
+	auto thread = QThread::currentThread();
+	runAsync(futureInterface, [futureInterface, chunkSize, thread](DataStore *store) mutable {
+		QVector<T> chunk;
+		chunk.reserve(chunkSize);
+		store->iterate<T>([&](T value) {
+			__helpertypes::move_to_thread(value, thread);
+			chunk.append(value);
+			if(chunk.size() == chunkSize) {
+				futureInterface.reportResults(chunk);
+				chunk.clear();
+			}
+			return !futureInterface.isCanceled();
+		}, chunkSize);
+		if(!chunk.isEmpty())
+			futureInterface.reportResults(chunk);
+	});
+	return futureInterface.future();
+}
+
+template<typename T>
+QFuture<void> DataStore::saveAsync(const T &value)
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return saveAsync(qMetaTypeId<T>(), QVariant::fromValue(value));
+}
+
+template<typename T>
+QFuture<bool> DataStore::removeAsync(const QString &key)
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QFutureInterface<bool> futureInterface;
+	runAsync(futureInterface, [futureInterface, key](DataStore *store) mutable {
+		futureInterface.reportResult(store->remove<T>(key));
+	});
+	return futureInterface.future();
+}
+
+template<typename T>
+QFuture<T> DataStore::searchAsync(const QString &query, SearchMode mode) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QFutureInterface<T> futureInterface;
+	auto thread = QThread::currentThread();
+	runAsync(futureInterface, [futureInterface, query, mode, thread](DataStore *store) mutable {
+		auto values = store->search<T>(query, mode);
+		for(const auto &value : values)
+			__helpertypes::move_to_thread(value, thread);
+		futureInterface.reportResults(values.toVector());
+	});
+	return futureInterface.future();
+}
+
 }
 
 #endif // QTDATASYNC_DATASTORE_H
@@ -2,6 +2,9 @@
 #define QTDATASYNC_DATASTORE_P_H
 
 #include <QtCore/QPointer>
+#include <QtCore/QRunnable>
+#include <QtCore/QSet>
+#include <QtCore/QThreadStorage>
 
 #include "qtdatasync_global.h"
 #include "datastore.h"
@@ -15,17 +18,43 @@ namespace QtDataSync {
 class DataStorePrivate
 {
 public:
+	static const int DefaultPageSize;
+	static QThreadStorage<DataStore*> asyncStores;
+
 	DataStorePrivate(DataStore *q, const QString &setupName);
 
+	static void moveToThread(const QVariant &value, int metaTypeId, QThread *thread);
+	//only gadgets: QVariant::value<T>() returns a copy, so the cached instance itself is never modified
+	static bool isTypedCacheable(int metaTypeId);
+
 	QByteArray typeName(int metaTypeId) const;
+	//types registered via Setup::serializeDirectly are converted directly, if they have only plain properties.
+	//Everything else is converted by the QJsonSerializer, so its converters apply
+	QPair<QString, QJsonObject> serialize(const QByteArray &typeName, int metaTypeId, QVariant value) const;
+	QVariant deserialize(const QJsonObject &data, int metaTypeId) const;
 
 	Defaults defaults;
 	Logger *logger;
 	QPointer<const QJsonSerializer> serializer;
+	QSet<int> directTypes;
 
 	LocalStore *store;
 };
 
+//no export needed
+class DataStoreTask : public QRunnable
+{
+public:
+	DataStoreTask(QString setupName, QFutureInterfaceBase futureInterface, std::function<void(DataStore*)> task);
+
+	void run() override;
+
+private:
+	QString _setupName;
+	QFutureInterfaceBase _futureInterface;
+	std::function<void(DataStore*)> _task;
+};
+
 }
 
 #endif // QTDATASYNC_DATASTORE_P_H
@@ -36,12 +36,22 @@ HEADERS += \
 	userexchangemanager.h \
 	userexchangemanager_p.h \
 	emitteradapter_p.h \
+	objectcache_p.h \
+	writebuffer_p.h \
+	writequeue_p.h \
+	accesstracker_p.h \
+	keyfilter_p.h \
+	recordcodec_p.h \
+	gadgetserializer_p.h \
 	changeemitter_p.h \
 	signal_private_connect_p.h \
 	migrationhelper.h \
 	migrationhelper_p.h \
 	remoteconfig.h \
-	remoteconfig_p.h
+	remoteconfig_p.h \
+	storagebackend_p.h \
+	filestoragebackend_p.h \
+	packstoragebackend_p.h
 
 SOURCES += \
 	localstore.cpp \
@@ -69,9 +79,19 @@ SOURCES += \
 	accountmanager_p.cpp \
 	userexchangemanager.cpp \
 	emitteradapter.cpp \
+	objectcache.cpp \
+	writebuffer.cpp \
+	writequeue.cpp \
+	accesstracker.cpp \
+	keyfilter.cpp \
+	recordcodec.cpp \
+	gadgetserializer.cpp \
 	changeemitter.cpp \
 	migrationhelper.cpp \
-	remoteconfig.cpp
+	remoteconfig.cpp \
+	storagebackend.cpp \
+	filestoragebackend.cpp \
+	packstoragebackend.cpp
 
 STATECHARTS += \
 	connectorstatemachine.scxml
@@ -53,8 +53,14 @@ public:
 	QList<TType> loadAll() const;
 	//! @copybrief DataStore::load(const K &) const
 	TType load(const TKey &key) const;
+	//! @copybrief DataStore::tryLoad(const K &, T &) const
+	bool tryLoad(const TKey &key, TType &value) const;
+	//! @copybrief DataStore::contains(const K &) const
+	bool contains(const TKey &key) const;
 	//! @copybrief DataStore::save(const T &)
 	void save(const TType &value);
+	//! @copybrief DataStore::saveAll(const QList<T> &)
+	void saveAll(const QList<TType> &values);
 	//! @copybrief DataStore::remove(const K &)
 	bool remove(const TKey &key);
 	//! @copybrief DataStore::update(T) const
@@ -62,10 +68,24 @@ public:
 	void update(std::enable_if_t<__helpertypes::is_object<TX>::value, TX> object) const;
 	//! @copybrief DataStore::search(const QString &, SearchMode) const
 	QList<TType> search(const QString &query, DataStore::SearchMode mode = DataStore::RegexpMode);
+	//! @copybrief DataStore::query(const QString &, QueryOperator, const QVariant &) const
+	QList<TType> query(const QString &property, DataStore::QueryOperator op, const QVariant &value);
 	//! @copybrief DataStore::iterate(const std::function<bool(T)> &) const
 	void iterate(const std::function<bool(TType)> &iterator);
+	//! @copybrief DataStore::iterate(const std::function<bool(T)> &, int, bool) const
+	void iterate(const std::function<bool(TType)> &iterator, int pageSize, bool useCache = false);
 	//! @copybrief DataStore::clear()
 	void clear();
+	//! @copybrief DataStore::loadAsync(const QString &) const
+	QFuture<TType> loadAsync(const TKey &key) const;
+	//! @copybrief DataStore::loadAllAsync(int) const
+	QFuture<TType> loadAllAsync(int chunkSize = 100) const;
+	//! @copybrief DataStore::saveAsync(const T &)
+	QFuture<void> saveAsync(const TType &value);
+	//! @copybrief DataStore::removeAsync(const QString &)
+	QFuture<bool> removeAsync(const TKey &key);
+	//! @copybrief DataStore::searchAsync(const QString &, SearchMode) const
+	QFuture<TType> searchAsync(const QString &query, DataStore::SearchMode mode = DataStore::RegexpMode) const;
 
 	//! Shortcut to convert a string to the stores key type
 	static TKey toKey(const QString &key);
@@ -109,6 +129,8 @@ public:
 	TType load(const TKey &key) const;
 	//! @copydoc DataTypeStore::save
 	void save(const TType &value);
+	//! @copydoc DataTypeStore::saveAll
+	void saveAll(const QList<TType> &values);
 	//! @copydoc DataTypeStore::remove
 	bool remove(const TKey &key);
 	//! Returns the dataset for the given key and removes it from the store
@@ -165,6 +187,8 @@ public:
 	TType* load(const TKey &key) const;
 	//!@copydoc CachingDataTypeStore::save
 	void save(TType *value);
+	//!@copydoc CachingDataTypeStore::saveAll
+	void saveAll(const QList<TType*> &values);
 	//!@copydoc CachingDataTypeStore::remove
 	bool remove(const TKey &key);
 	//!@copydoc CachingDataTypeStore::take
@@ -243,12 +267,30 @@ TType DataTypeStore<TType, TKey>::load(const TKey &key) const
 	return _store->load<TType>(key);
 }
 
+template <typename TType, typename TKey>
+bool DataTypeStore<TType, TKey>::tryLoad(const TKey &key, TType &value) const
+{
+	return _store->tryLoad<TType>(key, value);
+}
+
+template <typename TType, typename TKey>
+bool DataTypeStore<TType, TKey>::contains(const TKey &key) const
+{
+	return _store->contains<TType>(key);
+}
+
 template <typename TType, typename TKey>
 void DataTypeStore<TType, TKey>::save(const TType &value)
 {
 	_store->save(value);
 }
 
+template <typename TType, typename TKey>
+void DataTypeStore<TType, TKey>::saveAll(const QList<TType> &values)
+{
+	_store->saveAll(values);
+}
+
 template <typename TType, typename TKey>
 bool DataTypeStore<TType, TKey>::remove(const TKey &key)
 {
@@ -268,12 +310,54 @@ QList<TType> DataTypeStore<TType, TKey>::search(const QString &query, DataStore:
 	return _store->search<TType>(query, mode);
 }
 
+template<typename TType, typename TKey>
+QList<TType> DataTypeStore<TType, TKey>::query(const QString &property, DataStore::QueryOperator op, const QVariant &value)
+{
+	return _store->query<TType>(property, op, value);
+}
+
 template<typename TType, typename TKey>
 void DataTypeStore<TType, TKey>::iterate(const std::function<bool (TType)> &iterator)
 {
 	_store->iterate(iterator);
 }
 
+template <typename TType, typename TKey>
+void DataTypeStore<TType, TKey>::iterate(const std::function<bool (TType)> &iterator, int pageSize, bool useCache)
+{
+	_store->iterate(iterator, pageSize, useCache);
+}
+
+template<typename TType, typename TKey>
+QFuture<TType> DataTypeStore<TType, TKey>::loadAsync(const TKey &key) const
+{
+	return _store->loadAsync<TType>(QVariant::fromValue(key).toString());
+}
+
+template<typename TType, typename TKey>
+QFuture<TType> DataTypeStore<TType, TKey>::loadAllAsync(int chunkSize) const
+{
+	return _store->loadAllAsync<TType>(chunkSize);
+}
+
+template<typename TType, typename TKey>
+QFuture<void> DataTypeStore<TType, TKey>::saveAsync(const TType &value)
+{
+	return _store->saveAsync(value);
+}
+
+template<typename TType, typename TKey>
+QFuture<bool> DataTypeStore<TType, TKey>::removeAsync(const TKey &key)
+{
+	return _store->removeAsync<TType>(QVariant::fromValue(key).toString());
+}
+
+template<typename TType, typename TKey>
+QFuture<TType> DataTypeStore<TType, TKey>::searchAsync(const QString &query, DataStore::SearchMode mode) const
+{
+	return _store->searchAsync<TType>(query, mode);
+}
+
 template<typename TType, typename TKey>
 void DataTypeStore<TType, TKey>::clear()
 {
@@ -368,6 +452,12 @@ void CachingDataTypeStore<TType, TKey>::save(const TType &value)
 	_store->save(value);
 }
 
+template <typename TType, typename TKey>
+void CachingDataTypeStore<TType, TKey>::saveAll(const QList<TType> &values)
+{
+	_store->saveAll(values);
+}
+
 template <typename TType, typename TKey>
 bool CachingDataTypeStore<TType, TKey>::remove(const TKey &key)
 {
@@ -505,6 +595,12 @@ void CachingDataTypeStore<TType*, TKey>::save(TType *value)
 	_store->save(value);
 }
 
+template <typename TType, typename TKey>
+void CachingDataTypeStore<TType*, TKey>::saveAll(const QList<TType*> &values)
+{
+	_store->saveAll(values);
+}
+
 template <typename TType, typename TKey>
 bool CachingDataTypeStore<TType*, TKey>::remove(const TKey &key)
 {
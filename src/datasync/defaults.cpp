@@ -124,6 +124,14 @@ DatabaseRef Defaults::aquireDatabase(QObject *object) const
 	return DatabaseRef(new DatabaseRefPrivate(d, object));
 }
 
+QHash<QByteArray, CacheStatistics> Defaults::cacheStatistics() const
+{
+	if(d->cache)
+		return d->cache->statistics();
+	else
+		return {};
+}
+
 EmitterAdapter *Defaults::createEmitter(QObject *parent) const
 {
 	QObject *emitter = nullptr;
@@ -131,12 +139,37 @@ EmitterAdapter *Defaults::createEmitter(QObject *parent) const
 		emitter = d->passiveEmitter;
 	else
 		emitter = SetupPrivate::engine(d->setupName)->emitter();
-	return new EmitterAdapter(emitter, d->cacheInfo, parent);
+	return new EmitterAdapter(emitter, d->cache, parent);
 }
 
 QVariant Defaults::cacheHandle() const
 {
-	return QVariant::fromValue(d->cacheInfo);
+	return QVariant::fromValue(d->cache);
+}
+
+QThreadPool *Defaults::asyncPool() const
+{
+	return d->asyncPool;
+}
+
+WriteBuffer *Defaults::writeBuffer() const
+{
+	return d->writeBuffer;
+}
+
+WriteQueue *Defaults::writeQueue() const
+{
+	return &d->writeQueue;
+}
+
+AccessTracker *Defaults::accessTracker() const
+{
+	return &d->accessTracker;
+}
+
+KeyFilter *Defaults::keyFilter() const
+{
+	return &d->keyFilter;
 }
 
 // ------------- DatabaseRef -------------
@@ -218,6 +251,18 @@ void DefaultsPrivate::createDefaults(const QString &setupName, bool isPassive, c
 
 void DefaultsPrivate::removeDefaults(const QString &setupName)
 {
+	//stop the async workers first, as their stores keep a reference to the defaults
+	//must not be locked while waiting, as the workers may need to obtain the defaults
+	{
+		QSharedPointer<DefaultsPrivate> ref;
+		{
+			QMutexLocker _(&setupDefaultsMutex);
+			ref = setupDefaults.value(setupName);
+		}
+		if(ref)
+			ref->asyncPool->waitForDone(); //also removes all threads, and thus the thread local stores
+	}
+
 	QMutexLocker _(&setupDefaultsMutex);
 	QWeakPointer<DefaultsPrivate> weakRef;
 	{
@@ -251,7 +296,10 @@ DefaultsPrivate::DefaultsPrivate(QString setupName, QDir storageDir, QUrl roAddr
 	roAddress{std::move(roAddress)},
 	serializer{serializer},
 	resolver{resolver},
-	properties{std::move(properties)}
+	properties{std::move(properties)},
+	asyncPool{new QThreadPool{this}},
+	writeBuffer{new WriteBuffer{this->setupName, this}},
+	accessTracker{this->properties.value(Defaults::PreloadedTypes).toHash()}
 {
 	//parenting
 	serializer->setParent(this);
@@ -271,8 +319,15 @@ DefaultsPrivate::DefaultsPrivate(QString setupName, QDir storageDir, QUrl roAddr
 
 	//create cache
 	auto maxSize = properties.value(Defaults::CacheSize).toInt();
-	if(maxSize > 0)
-		cacheInfo = QSharedPointer<EmitterAdapter::CacheInfo>::create(maxSize);
+	if(maxSize > 0) {
+		cache = QSharedPointer<ObjectCache>::create(maxSize,
+													static_cast<Setup::CacheCostModel>(properties.value(Defaults::CacheCostModel).toInt()));
+	}
+
+	//create async workers
+	auto threadCount = this->properties.value(Defaults::AsyncThreadCount).toInt();
+	if(threadCount > 0)
+		asyncPool->setMaxThreadCount(threadCount);
 }
 
 DefaultsPrivate::~DefaultsPrivate()
@@ -324,6 +379,40 @@ QSqlDatabase DefaultsPrivate::acquireDatabase()
 		QSqlQuery pragmaForeignKeys(database);
 		if(!pragmaForeignKeys.exec(QStringLiteral("PRAGMA foreign_keys = ON")))
 			logWarning() << "Failed to enable foreign_keys support";
+
+		//set the journal mode
+		auto walMode = static_cast<Setup::JournalMode>(properties.value(Defaults::DbJournalMode).toInt()) == Setup::WriteAheadLog;
+		auto journalMode = walMode ? QStringLiteral("wal") : QStringLiteral("delete");
+		QSqlQuery pragmaJournalMode(database);
+		if(!pragmaJournalMode.exec(QStringLiteral("PRAGMA journal_mode = %1").arg(journalMode)) ||
+		   !pragmaJournalMode.first())
+			logWarning() << "Failed to set journal_mode to" << journalMode;
+		else if(pragmaJournalMode.value(0).toString().toLower() != journalMode) { //happens if other connections prevent the switch
+			logWarning() << "Database is operating in journal_mode" << pragmaJournalMode.value(0).toString()
+						 << "instead of" << journalMode;
+		}
+
+		//configure synchronisation, memory mapping and caching
+		QSqlQuery pragmaSynchronous(database);
+		if(!pragmaSynchronous.exec(QStringLiteral("PRAGMA synchronous = %1")
+								   .arg(properties.value(Defaults::DbSynchronous).toInt())))
+			logWarning() << "Failed to set synchronous mode";
+		QSqlQuery pragmaMmapSize(database);
+		if(!pragmaMmapSize.exec(QStringLiteral("PRAGMA mmap_size = %1")
+								.arg(properties.value(Defaults::DbMmapSize).toLongLong())))
+			logWarning() << "Failed to set mmap_size";
+		auto cacheSize = properties.value(Defaults::DbCacheSize).toInt();
+		if(cacheSize > 0) {
+			QSqlQuery pragmaCacheSize(database);
+			if(!pragmaCacheSize.exec(QStringLiteral("PRAGMA cache_size = -%1").arg(qMax(cacheSize / 1024, 1)))) //negative values are in KiB
+				logWarning() << "Failed to set cache_size";
+		}
+		if(walMode) {
+			QSqlQuery pragmaCheckpoint(database);
+			if(!pragmaCheckpoint.exec(QStringLiteral("PRAGMA wal_autocheckpoint = %1")
+									  .arg(properties.value(Defaults::DbWalCheckpoint).toInt())))
+				logWarning() << "Failed to set wal_autocheckpoint";
+		}
 	}
 
 	return QSqlDatabase::database(name);
@@ -4,6 +4,7 @@
 #include <QtCore/qglobal.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qdir.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qsettings.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qdebug.h>
@@ -16,12 +17,17 @@
 
 class QSqlDatabase;
 class QJsonSerializer;
+class QThreadPool;
 
 namespace QtDataSync {
 
 class Logger;
 class Defaults;
 class EmitterAdapter;
+class WriteBuffer;
+class WriteQueue;
+class AccessTracker;
+class KeyFilter;
 
 class DatabaseRefPrivate;
 //! A wrapper around QSqlDatabase to manage the connections
@@ -53,6 +59,23 @@ private:
 	QScopedPointer<DatabaseRefPrivate> d;
 };
 
+//! Statistics of the object cache for one data type
+struct Q_DATASYNC_EXPORT CacheStatistics
+{
+	//! The number of loads that were served from the cache
+	quint64 hits = 0;
+	//! The number of loads that had to read from the store
+	quint64 misses = 0;
+	//! The number of datasets added to the cache, including replacements
+	quint64 inserts = 0;
+	//! The number of datasets dropped to make room, or because they were too big
+	quint64 evictions = 0;
+	//! The cost of all datasets currently held, as counted by the cost model
+	qint64 bytes = 0;
+	//! The cost model used to count the bytes
+	Setup::CacheCostModel costModel = Setup::StoredSizeCost;
+};
+
 class DefaultsPrivate;
 //! A helper class to get defaults per datasync instance (threadsafe)
 class Q_DATASYNC_EXPORT Defaults
@@ -74,7 +97,27 @@ public:
 		CryptScheme, //!< @copybrief Setup::encryptionScheme
 		CryptKeyParam, //!< @copybrief Setup::encryptionKeyParam
 		SymScheme, //!< @copybrief Setup::cipherScheme
-		SymKeyParam //!< @copybrief Setup::cipherKeySize
+		SymKeyParam, //!< @copybrief Setup::cipherKeySize
+		InlineThreshold, //!< @copybrief Setup::inlineDataThreshold
+		DbJournalMode, //!< @copybrief Setup::journalMode
+		DbSynchronous, //!< @copybrief Setup::synchronousMode
+		DbMmapSize, //!< @copybrief Setup::mmapSize
+		DbCacheSize, //!< @copybrief Setup::databaseCacheSize
+		DbWalCheckpoint, //!< @copybrief Setup::walAutoCheckpoint
+		PropertyIndexes, //!< @copybrief Setup::addPropertyIndex
+		FullTextIndexes, //!< @copybrief Setup::addFullTextIndex
+		AsyncThreadCount, //!< @copybrief Setup::asyncThreadCount
+		StorageEngine, //!< @copybrief Setup::storageEngine
+		CompressionLevel, //!< @copybrief Setup::compressionLevel
+		CompressionThreshold, //!< @copybrief Setup::compressionThreshold
+		ChecksumAlgorithm, //!< @copybrief Setup::checksumAlgorithm
+		DeferredChecksums, //!< @copybrief Setup::deferChecksums
+		CoalescingWindow, //!< @copybrief Setup::coalescingWindow
+		CoalescedTypes, //!< @copybrief Setup::coalesceWrites
+		Durability, //!< @copybrief Setup::durability
+		CacheCostModel, //!< @copybrief Setup::cacheCostModel
+		PreloadedTypes, //!< @copybrief Setup::preload
+		DirectSerializedTypes //!< @copybrief Setup::serializeDirectly
 	};
 	Q_ENUM(PropertyKey)
 
@@ -119,11 +162,23 @@ public:
 
 	//! Aquire a reference to the standard sqlite database
 	DatabaseRef aquireDatabase(QObject *object) const;
+	//! Returns the statistics of the object cache, per data type
+	QHash<QByteArray, CacheStatistics> cacheStatistics() const;
 
 	//! @private
 	EmitterAdapter *createEmitter(QObject *parent = nullptr) const;
 	//! @private
 	QVariant cacheHandle() const;
+	//! @private
+	QThreadPool *asyncPool() const;
+	//! @private
+	WriteBuffer *writeBuffer() const;
+	//! @private
+	WriteQueue *writeQueue() const;
+	//! @private
+	AccessTracker *accessTracker() const;
+	//! @private
+	KeyFilter *keyFilter() const;
 
 private:
 	QSharedPointer<DefaultsPrivate> d;
@@ -3,6 +3,7 @@
 
 #include <QtCore/QMutex>
 #include <QtCore/QThreadStorage>
+#include <QtCore/QThreadPool>
 
 #include <QtSql/QSqlDatabase>
 
@@ -14,6 +15,10 @@
 #include "logger.h"
 #include "conflictresolver.h"
 #include "emitteradapter_p.h"
+#include "writebuffer_p.h"
+#include "writequeue_p.h"
+#include "accesstracker_p.h"
+#include "keyfilter_p.h"
 
 class ChangeEmitterReplica;
 
@@ -102,7 +107,12 @@ private:
 	QMutex roMutex;
 	QHash<QThread*, QRemoteObjectNode*> roNodes;
 
-	QSharedPointer<EmitterAdapter::CacheInfo> cacheInfo;
+	QSharedPointer<ObjectCache> cache;
+	QThreadPool *asyncPool;
+	WriteBuffer *writeBuffer;
+	WriteQueue writeQueue;
+	AccessTracker accessTracker;
+	KeyFilter keyFilter;
 
 	ChangeEmitterReplica *passiveEmitter = nullptr;
 };
@@ -2,11 +2,11 @@
 #include "changeemitter_p.h"
 using namespace QtDataSync;
 
-EmitterAdapter::EmitterAdapter(QObject *changeEmitter, QSharedPointer<CacheInfo> cacheInfo, QObject *origin) :
+EmitterAdapter::EmitterAdapter(QObject *changeEmitter, QSharedPointer<ObjectCache> cache, QObject *origin) :
 	QObject{origin},
 	_isPrimary{changeEmitter->metaObject()->inherits(&ChangeEmitter::staticMetaObject)},
 	_emitterBackend{changeEmitter},
-	_cache{std::move(cacheInfo)}
+	_cache{std::move(cache)}
 {
 	if(_isPrimary) {
 		connect(_emitterBackend, SIGNAL(dataChanged(QObject*,QtDataSync::ObjectKey,bool)),
@@ -25,6 +25,11 @@ EmitterAdapter::EmitterAdapter(QObject *changeEmitter, QSharedPointer<CacheInfo>
 	}
 }
 
+bool EmitterAdapter::isPrimary() const
+{
+	return _isPrimary;
+}
+
 void EmitterAdapter::triggerChange(const ObjectKey &key, bool deleted, bool changed)
 {
 	if(_isPrimary) {
@@ -45,6 +50,27 @@ void EmitterAdapter::triggerChange(const ObjectKey &key, bool deleted, bool chan
 	}
 }
 
+void EmitterAdapter::triggerChanges(const QByteArray &typeName, const QStringList &ids, bool changed)
+{
+	if(_isPrimary) {
+		QMetaObject::invokeMethod(_emitterBackend, "triggerChanges",
+								  Qt::QueuedConnection,
+								  Q_ARG(QObject*, parent()),
+								  Q_ARG(QByteArray, typeName),
+								  Q_ARG(QStringList, ids),
+								  Q_ARG(bool, changed));
+		for(const auto &id : ids)
+			emit dataChanged({typeName, id}, false);//own change
+	} else {
+		QMetaObject::invokeMethod(_emitterBackend, "triggerRemoteChanges",
+								  Qt::QueuedConnection,
+								  Q_ARG(QByteArray, typeName),
+								  Q_ARG(QStringList, ids),
+								  Q_ARG(bool, changed));
+		//no change signal, because operating in passive setup
+	}
+}
+
 void EmitterAdapter::triggerClear(const QByteArray &typeName, const QStringList &ids)
 {
 	if(_isPrimary) {
@@ -84,74 +110,60 @@ void EmitterAdapter::triggerUpload()
 							  Qt::QueuedConnection);
 }
 
-void EmitterAdapter::putCached(const ObjectKey &key, const QJsonObject &data, int costs)
+quint64 EmitterAdapter::putCached(const ObjectKey &key, const QJsonObject &data, int costs)
 {
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	_cache->cache.insert(key, new QJsonObject(data), costs);
+	if(_cache)
+		return _cache->put(key, data, costs);
+	else
+		return 0;
 }
 
 void EmitterAdapter::putCached(const QList<ObjectKey> &keys, const QList<QJsonObject> &data, const QList<int> &costs)
 {
-	Q_ASSERT(keys.size() == data.size());
-	Q_ASSERT(keys.size() == costs.size());
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	for(auto i = 0; i < keys.size(); i++)
-		_cache->cache.insert(keys[i], new QJsonObject(data[i]), costs[i]);
+	if(_cache)
+		_cache->put(keys, data, costs);
 }
 
-bool EmitterAdapter::getCached(const ObjectKey &key, QJsonObject &data)
+bool EmitterAdapter::getCached(const ObjectKey &key, QJsonObject &data, quint64 *generation)
 {
-	if(!_cache)
+	if(_cache)
+		return _cache->get(key, data, generation);
+	else
 		return false;
+}
 
-	QReadLocker _(&_cache->lock);
-	auto json = _cache->cache.object(key);
-	if(json) {
-		data = *json;
-		return true;
-	} else
+void EmitterAdapter::putCachedTyped(const ObjectKey &key, quint64 generation, int metaTypeId, const QVariant &value)
+{
+	if(_cache)
+		_cache->putTyped(key, generation, metaTypeId, value);
+}
+
+bool EmitterAdapter::getCachedTyped(const ObjectKey &key, int metaTypeId, QVariant &value)
+{
+	if(_cache)
+		return _cache->getTyped(key, metaTypeId, value);
+	else
 		return false;
 }
 
 bool EmitterAdapter::dropCached(const ObjectKey &key)
 {
-	if(!_cache)
+	if(_cache)
+		return _cache->remove(key);
+	else
 		return false;
-
-	//check if cached
-	{
-		QReadLocker _(&_cache->lock);
-		if(!_cache->cache.contains(key))
-			return false;
-	}
-
-	QWriteLocker _(&_cache->lock);
-	return _cache->cache.remove(key);
 }
 
 void EmitterAdapter::dropCached(const QByteArray &typeName, const QStringList &ids)
 {
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	for(const auto &id : ids)
-		_cache->cache.remove({typeName, id});
+	if(_cache)
+		_cache->remove(typeName, ids);
 }
 
 void EmitterAdapter::dropCached()
 {
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	_cache->cache.clear();
+	if(_cache)
+		_cache->clear();
 }
 
 void EmitterAdapter::dataChangedImpl(QObject *origin, const ObjectKey &key, bool deleted)
@@ -168,33 +180,14 @@ void EmitterAdapter::dataResettedImpl(QObject *origin)
 
 void EmitterAdapter::remoteDataChangedImpl(const ObjectKey &key, bool deleted)
 {
-	if(_cache) {
-		auto contains = false;
-		//check if cached
-		{
-			QReadLocker _(&_cache->lock);
-			contains = _cache->cache.contains(key);
-		}
-		//if chached, remove
-		if(contains) {
-			QWriteLocker _(&_cache->lock);
-			_cache->cache.remove(key);
-		}
-	}
+	if(_cache)
+		_cache->remove(key);
 	emit dataChanged(key, deleted);
 }
 
 void EmitterAdapter::remoteDataResettedImpl()
 {
-	if(_cache) {
-		QWriteLocker _(&_cache->lock);
-		_cache->cache.clear();
-	}
+	if(_cache)
+		_cache->clear();
 	emit dataResetted();
 }
-
-
-
-EmitterAdapter::CacheInfo::CacheInfo(int maxSize) :
-	cache{maxSize}
-{}
@@ -2,12 +2,11 @@
 #define QTDATASYNC_EMITTERADAPTER_P_H
 
 #include <QtCore/QObject>
-#include <QtCore/QReadWriteLock>
-#include <QtCore/QCache>
 
 #include "qtdatasync_global.h"
 #include "objectkey.h"
 #include "defaults.h"
+#include "objectcache_p.h"
 
 namespace QtDataSync {
 
@@ -16,25 +15,23 @@ class Q_DATASYNC_EXPORT EmitterAdapter : public QObject
 	Q_OBJECT
 
 public:
-	struct Q_DATASYNC_EXPORT CacheInfo {
-		QReadWriteLock lock;
-		QCache<ObjectKey, QJsonObject> cache;
-
-		CacheInfo(int maxSize);
-	};
-
 	explicit EmitterAdapter(QObject *changeEmitter,
-							QSharedPointer<CacheInfo> cacheInfo,
+							QSharedPointer<ObjectCache> cache,
 							QObject *origin = nullptr);
 
+	bool isPrimary() const;
+
 	void triggerChange(const QtDataSync::ObjectKey &key, bool deleted, bool changed);
+	void triggerChanges(const QByteArray &typeName, const QStringList &ids, bool changed);
 	void triggerClear(const QByteArray &typeName, const QStringList &ids);
 	void triggerReset();
 	void triggerUpload();
 
-	void putCached(const ObjectKey &key, const QJsonObject &data, int costs);
+	quint64 putCached(const ObjectKey &key, const QJsonObject &data, int costs);
 	void putCached(const QList<ObjectKey> &keys, const QList<QJsonObject> &data, const QList<int> &costs);
-	bool getCached(const ObjectKey &key, QJsonObject &data);
+	bool getCached(const ObjectKey &key, QJsonObject &data, quint64 *generation = nullptr);
+	void putCachedTyped(const ObjectKey &key, quint64 generation, int metaTypeId, const QVariant &value);
+	bool getCachedTyped(const ObjectKey &key, int metaTypeId, QVariant &value);
 	bool dropCached(const ObjectKey &key);
 	void dropCached(const QByteArray &typeName, const QStringList &ids);
 	void dropCached();
@@ -52,11 +49,9 @@ private Q_SLOTS:
 private:
 	bool _isPrimary;
 	QObject *_emitterBackend;
-	QSharedPointer<CacheInfo> _cache;
+	QSharedPointer<ObjectCache> _cache;
 };
 
 }
 
-Q_DECLARE_METATYPE(QSharedPointer<QtDataSync::EmitterAdapter::CacheInfo>)
-
 #endif // QTDATASYNC_EMITTERADAPTER_P_H
@@ -143,6 +143,9 @@ void ExchangeEngine::initialize()
 		_roHost->enableRemoting(_accountManager);
 		logDebug() << "RemoteObject host node initialized";
 
+		//warm the cache in the background, nothing waits for it
+		PreloadTask::schedule(_defaults);
+
 		if(_initialImport.isSet()) {
 			try {
 				if(_initialImport.password.isEmpty()) {
@@ -172,6 +175,19 @@ void ExchangeEngine::finalize()
 {
 	logDebug() << "Beginning engine finalization";
 
+	//write datasets that are still kept in memory, before the setup is gone
+	try {
+		_localStore->flush();
+	} catch(QException &e) {
+		logWarning() << "Failed to write coalesced datasets with error:" << e.what();
+	}
+	//remember what was used recently for the next start
+	try {
+		_localStore->flushAccessHints();
+	} catch(QException &e) {
+		logWarning() << "Failed to write access hints with error:" << e.what();
+	}
+
 	//remoteconnector is the only one asynchronous (for now)
 	connect(_remoteConnector, &RemoteConnector::finalized,
 			thread(), &QThread::quit,
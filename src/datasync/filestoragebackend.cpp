@@ -0,0 +1,262 @@
+#include "filestoragebackend_p.h"
+#include "datastore.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QUuid>
+#include <QtCore/QSharedPointer>
+
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlError>
+
+using namespace QtDataSync;
+using std::function;
+
+#define QTDATASYNC_LOG _logger
+
+const int FileStorageBackend::MigrationBatchSize = 1000;
+QMutex FileStorageBackend::detectMutex;
+QSet<QString> FileStorageBackend::detectedStores;
+
+FileStorageBackend::FileStorageBackend(Defaults defaults, Logger *logger) :
+	StorageBackend{std::move(defaults), logger}
+{}
+
+void FileStorageBackend::detectFlatLayout(const DatabaseRef &db)
+{
+	{
+		QMutexLocker _(&detectMutex);
+		auto storePath = _defaults.storageDir().absolutePath();
+		if(detectedStores.contains(storePath))
+			return;
+		detectedStores.insert(storePath);
+	}
+
+	//flat file names contain neither a shard directory, nor the ':' of inline or packed data
+	QSqlQuery detectQuery(db);
+	detectQuery.prepare(QStringLiteral("SELECT 1 FROM DataIndex "
+									   "WHERE File IS NOT NULL AND instr(File, '/') = 0 AND instr(File, ':') = 0 "
+									   "LIMIT 1"));
+	if(!detectQuery.exec()) {
+		logWarning() << "Failed to check for datasets in the flat file layout with error:"
+					 << detectQuery.lastError().text();
+	} else if(detectQuery.first()) {
+		logDebug() << "Found datasets in the flat file layout - scheduling migration";
+		_migrationNeeded = true;
+	}
+}
+
+QByteArray FileStorageBackend::read(const ObjectKey &key, const QString &location)
+{
+	QFile file(filePath(key, location));
+	if(!file.open(QIODevice::ReadOnly))
+		throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+	return file.readAll();
+}
+
+StorageBackend::PendingWrite FileStorageBackend::write(const DatabaseRef &db, const ObjectKey &key, const QString &oldLocation, const QByteArray &data)
+{
+	Q_UNUSED(db)
+
+	auto tableDir = typeDirectory(QStringLiteral("data"), key);
+	QSharedPointer<QFileDevice> device;
+	function<bool(QFileDevice*)> fileCommitFn;
+	QString location;
+	function<void()> afterCommitFn;
+	//replacing always syncs the file, so relaxed and grouped writes create a new one instead
+	if(!oldLocation.isNull() && isSharded(oldLocation) && _durability != Setup::DurabilityRelaxed && !_grouped) {
+		auto file = new QSaveFile(filePath(tableDir, oldLocation));
+		device.reset(file);
+		openFile(key, QStringLiteral("data"), QFileInfo(file->fileName()).absolutePath(), file, [file](){
+			return file->open(QIODevice::WriteOnly);
+		});
+		fileCommitFn = [](QFileDevice *d){
+			return static_cast<QSaveFile*>(d)->commit();
+		};
+		location = oldLocation;
+	} else {
+		auto baseName = QString::fromUtf8(QUuid::createUuid().toRfc4122().toHex());
+		auto shardDir = tableDir.absoluteFilePath(shardPath(baseName));
+		ensureDirectory(key, shardDir);
+		auto file = new QTemporaryFile(QDir(shardDir).absoluteFilePath(baseName + QStringLiteral("XXXXXX.dat")));
+		device.reset(file);
+		openFile(key, QStringLiteral("data"), shardDir, file, [file](){
+			return file->open();
+		});
+		fileCommitFn = [this, key](QFileDevice *d){
+			auto f = static_cast<QTemporaryFile*>(d);
+			//grouped files are synced all at once by endGroup
+			if(!_grouped && _durability != Setup::DurabilityRelaxed && !syncToDisk(f))
+				return false;
+			f->close();
+			if(f->error() == QFile::NoError) {
+				f->setAutoRemove(false);
+				if(_grouped)
+					_groupFiles.append({key, f->fileName()});
+				return true;
+			} else
+				return false;
+		};
+		location = shardPath(baseName) + QLatin1Char('/') + QFileInfo(file->fileName()).completeBaseName();
+
+		//written in the old layout or relaxed before -> replaced by the new file
+		if(!oldLocation.isNull())
+			afterCommitFn = remove(db, key, oldLocation);
+	}
+
+	//write the data
+	device->write(data);
+	if(device->error() != QFile::NoError)
+		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+
+	return {
+		location,
+		[this, key, device, fileCommitFn]() {
+			if(!fileCommitFn(device.data()))
+				throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+		},
+		afterCommitFn
+	};
+}
+
+function<void()> FileStorageBackend::remove(const DatabaseRef &db, const ObjectKey &key, const QString &location)
+{
+	Q_UNUSED(db)
+	auto fileName = filePath(key, location);
+	return [this, fileName]() {
+		if(!QFile::remove(fileName))
+			logWarning() << "Failed to remove data file" << fileName;
+	};
+}
+
+void FileStorageBackend::clear(const DatabaseRef &db, const QByteArray &typeName)
+{
+	Q_UNUSED(db)
+	auto tableDir = typeDirectory(QStringLiteral("data"), typeName);
+	if(!moveToTrash(_defaults, tableDir.absolutePath()) &&
+	   !tableDir.removeRecursively()) {
+		logWarning() << "Failed to delete cleared data directory for type"
+					 << typeName;
+	}
+}
+
+void FileStorageBackend::beginGroup()
+{
+	_grouped = true;
+}
+
+void FileStorageBackend::endGroup(bool commit)
+{
+	auto files = _groupFiles;
+	_groupFiles.clear();
+	_grouped = false;
+
+	//the files of a group that is rolled back are not referenced anywhere
+	auto removeFiles = [&files]() {
+		for(const auto &info : files)
+			QFile::remove(info.second);
+	};
+	if(!commit) {
+		removeFiles();
+		return;
+	}
+	if(_durability == Setup::DurabilityRelaxed)
+		return;
+
+	for(const auto &info : files) {
+		QFile file(info.second);
+		if(!file.open(QIODevice::ReadWrite) || !syncToDisk(&file)) {
+			removeFiles();
+			throw LocalStoreException(_defaults, info.first, file.fileName(), QStringLiteral("Failed to sync data file to disk"));
+		}
+	}
+}
+
+bool FileStorageBackend::takeCompactionRequest()
+{
+	auto needed = _migrationNeeded;
+	_migrationNeeded = false;
+	return needed;
+}
+
+function<void()> FileStorageBackend::compact(const DatabaseRef &db)
+{
+	//migrate files of the flat layout into shards, one batch at a time
+	QSqlQuery flatQuery(db);
+	flatQuery.prepare(QStringLiteral("SELECT Type, Id, File FROM DataIndex "
+									 "WHERE File IS NOT NULL AND instr(File, '/') = 0 AND instr(File, ':') = 0 "
+									 "LIMIT ?"));
+	flatQuery.addBindValue(MigrationBatchSize);
+	if(!flatQuery.exec()) {
+		throw LocalStoreException(_defaults,
+								  QByteArrayLiteral("any"),
+								  flatQuery.executedQuery().simplified(),
+								  flatQuery.lastError().text());
+	}
+
+	//files are copied, so a rollback leaves only unused copies. The originals are removed after the commit
+	QStringList obsoleteFiles;
+	while(flatQuery.next()) {
+		ObjectKey key {flatQuery.value(0).toByteArray(), flatQuery.value(1).toString()};
+		auto oldLocation = flatQuery.value(2).toString();
+		auto location = shardPath(oldLocation) + QLatin1Char('/') + oldLocation;
+
+		auto tableDir = typeDirectory(QStringLiteral("data"), key);
+		ensureDirectory(key, tableDir.absoluteFilePath(shardPath(oldLocation)));
+		auto oldPath = filePath(tableDir, oldLocation);
+		auto newPath = filePath(tableDir, location);
+		if(QFile::exists(newPath)) //left over from a previous, failed migration
+			QFile::remove(newPath);
+		if(!QFile::copy(oldPath, newPath))
+			throw LocalStoreException(_defaults, key, oldPath, QStringLiteral("Failed to copy file to %1").arg(newPath));
+
+		QSqlQuery moveQuery(db);
+		moveQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = ? WHERE Type = ? AND Id = ?"));
+		moveQuery.addBindValue(location);
+		moveQuery.addBindValue(key.typeName);
+		moveQuery.addBindValue(key.id);
+		if(!moveQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  key,
+									  moveQuery.executedQuery().simplified(),
+									  moveQuery.lastError().text());
+		}
+		obsoleteFiles.append(oldPath);
+	}
+
+	if(obsoleteFiles.isEmpty())
+		return {};
+	logDebug() << "Migrated" << obsoleteFiles.size() << "files to the sharded layout";
+
+	//a full batch -> there might be more
+	_migrationNeeded = obsoleteFiles.size() == MigrationBatchSize;
+	return [this, obsoleteFiles]() {
+		for(const auto &file : obsoleteFiles) {
+			if(!QFile::remove(file))
+				logWarning() << "Failed to remove migrated data file" << file;
+		}
+	};
+}
+
+bool FileStorageBackend::isSharded(const QString &location)
+{
+	return location.contains(QLatin1Char('/'));
+}
+
+QString FileStorageBackend::shardPath(const QString &baseName)
+{
+	//names start with a random uuid, so the first 4 characters are evenly distributed
+	return baseName.left(2) + QLatin1Char('/') + baseName.mid(2, 2);
+}
+
+QString FileStorageBackend::filePath(const QDir &typeDir, const QString &location) const
+{
+	return typeDir.absoluteFilePath(location + QStringLiteral(".dat"));
+}
+
+QString FileStorageBackend::filePath(const ObjectKey &key, const QString &location) const
+{
+	return filePath(typeDirectory(QStringLiteral("data"), key), location);
+}
@@ -0,0 +1,47 @@
+#ifndef QTDATASYNC_FILESTORAGEBACKEND_P_H
+#define QTDATASYNC_FILESTORAGEBACKEND_P_H
+
+#include "qtdatasync_global.h"
+#include "storagebackend_p.h"
+
+namespace QtDataSync {
+
+//no export needed
+class FileStorageBackend : public StorageBackend
+{
+public:
+	static const int MigrationBatchSize;
+
+	FileStorageBackend(Defaults defaults, Logger *logger);
+
+	//checks once per store and process if files of the old, flat layout exist
+	void detectFlatLayout(const DatabaseRef &db);
+
+	QByteArray read(const ObjectKey &key, const QString &location) override;
+	PendingWrite write(const DatabaseRef &db, const ObjectKey &key, const QString &oldLocation, const QByteArray &data) override;
+	std::function<void()> remove(const DatabaseRef &db, const ObjectKey &key, const QString &location) override;
+	void clear(const DatabaseRef &db, const QByteArray &typeName) override;
+
+	bool takeCompactionRequest() override;
+	std::function<void()> compact(const DatabaseRef &db) override;
+
+	void beginGroup() override;
+	void endGroup(bool commit) override;
+
+private:
+	static QMutex detectMutex;
+	static QSet<QString> detectedStores;
+
+	bool _migrationNeeded = false;
+	bool _grouped = false;
+	QList<QPair<ObjectKey, QString>> _groupFiles; //new files written while grouped, to be synced by endGroup
+
+	static bool isSharded(const QString &location);
+	static QString shardPath(const QString &baseName);
+	QString filePath(const QDir &typeDir, const QString &location) const;
+	QString filePath(const ObjectKey &key, const QString &location) const;
+};
+
+}
+
+#endif // QTDATASYNC_FILESTORAGEBACKEND_P_H
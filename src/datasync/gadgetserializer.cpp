@@ -0,0 +1,240 @@
+#include "gadgetserializer_p.h"
+
+#include <cmath>
+#include <limits>
+
+#include <QtCore/QMetaProperty>
+
+using namespace QtDataSync;
+
+QReadWriteLock GadgetSerializer::lock;
+QHash<int, QSharedPointer<const GadgetSerializer>> GadgetSerializer::serializers;
+
+namespace {
+
+//the static metacall of the moc accesses the members directly, without wrapping their values into variants
+template <typename T>
+T readProperty(const QMetaObject *owner, int index, const void *gadget)
+{
+	T value{};
+	void *argv[] = {&value};
+	owner->d.static_metacall(reinterpret_cast<QObject*>(const_cast<void*>(gadget)), QMetaObject::ReadProperty, index, argv);
+	return value;
+}
+
+template <typename T>
+void writeProperty(const QMetaObject *owner, int index, void *gadget, T value)
+{
+	auto status = -1;
+	auto flags = 0;
+	void *argv[] = {&value, nullptr, &status, &flags};
+	owner->d.static_metacall(reinterpret_cast<QObject*>(gadget), QMetaObject::WriteProperty, index, argv);
+}
+
+//only integral numbers that fit into the type, everything else is converted by the QJsonSerializer
+template <typename T>
+bool toInteger(const QJsonValue &value, T &result)
+{
+	if(!value.isDouble())
+		return false;
+	auto number = value.toDouble();
+	const auto limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+	const auto lower = std::numeric_limits<T>::is_signed ? -limit : 0.0;
+	if(std::trunc(number) != number || number < lower || number >= limit)
+		return false;
+	result = static_cast<T>(number);
+	return true;
+}
+
+template <typename T>
+bool writeInteger(const QMetaObject *owner, int index, void *gadget, const QJsonValue &value)
+{
+	T result;
+	if(!toInteger(value, result))
+		return false;
+	writeProperty(owner, index, gadget, result);
+	return true;
+}
+
+}
+
+QSharedPointer<const GadgetSerializer> GadgetSerializer::forType(int metaTypeId)
+{
+	{
+		QReadLocker _(&lock);
+		auto it = serializers.constFind(metaTypeId);
+		if(it != serializers.constEnd())
+			return *it;
+	}
+
+	//unsupported types are remembered as well, so they are only checked once
+	auto serializer = create(metaTypeId);
+	QWriteLocker _(&lock);
+	serializers.insert(metaTypeId, serializer);
+	return serializer;
+}
+
+int GadgetSerializer::metaTypeId() const
+{
+	return _metaTypeId;
+}
+
+QString GadgetSerializer::key(const void *gadget) const
+{
+	const auto &property = _properties[_keyIndex];
+	switch(property.type) {
+	case QMetaType::Int:
+		return QString::number(readProperty<int>(property.owner, property.index, gadget));
+	case QMetaType::UInt:
+		return QString::number(readProperty<uint>(property.owner, property.index, gadget));
+	case QMetaType::LongLong:
+		return QString::number(readProperty<qint64>(property.owner, property.index, gadget));
+	case QMetaType::ULongLong:
+		return QString::number(readProperty<quint64>(property.owner, property.index, gadget));
+	case QMetaType::QString:
+		return readProperty<QString>(property.owner, property.index, gadget);
+	default:
+		Q_UNREACHABLE();
+		return {};
+	}
+}
+
+QJsonObject GadgetSerializer::serialize(const void *gadget) const
+{
+	QJsonObject data;
+	for(const auto &property : _properties)
+		data.insert(property.name, read(property, gadget));
+	return data;
+}
+
+bool GadgetSerializer::deserialize(const QJsonObject &data, void *gadget) const
+{
+	//missing or additional properties are handled according to the validation flags of the QJsonSerializer
+	if(data.size() != _properties.size())
+		return false;
+	for(const auto &property : _properties) {
+		if(!write(property, data.value(property.name), gadget))
+			return false;
+	}
+	return true;
+}
+
+GadgetSerializer::GadgetSerializer(int metaTypeId) :
+	_metaTypeId{metaTypeId}
+{}
+
+bool GadgetSerializer::isSupported(int type)
+{
+	switch(type) {
+	case QMetaType::Bool:
+	case QMetaType::Int:
+	case QMetaType::UInt:
+	case QMetaType::LongLong:
+	case QMetaType::ULongLong:
+	case QMetaType::Double:
+	case QMetaType::QString:
+		return true;
+	default:
+		return false;
+	}
+}
+
+QSharedPointer<const GadgetSerializer> GadgetSerializer::create(int metaTypeId)
+{
+	if(!QMetaType::typeFlags(metaTypeId).testFlag(QMetaType::IsGadget))
+		return {};
+	auto meta = QMetaType::metaObjectForType(metaTypeId);
+	if(!meta)
+		return {};
+	auto userProp = meta->userProperty();
+	if(!userProp.isValid())
+		return {};
+
+	QSharedPointer<GadgetSerializer> serializer{new GadgetSerializer{metaTypeId}};
+	for(auto i = 0; i < meta->propertyCount(); i++) {
+		auto property = meta->property(i);
+		if(!property.isStored())
+			continue;
+		//enums depend on the serializer settings
+		if(property.isEnumType() || property.isFlagType() || !isSupported(property.userType()))
+			return {};
+		auto owner = property.enclosingMetaObject();
+		if(!owner || !owner->d.static_metacall)
+			return {};
+
+		if(i == userProp.propertyIndex())
+			serializer->_keyIndex = serializer->_properties.size();
+		serializer->_properties.append({
+			QString::fromUtf8(property.name()),
+			property.userType(),
+			owner,
+			i - owner->propertyOffset()
+		});
+	}
+
+	//keys must be stored and have a well defined string representation
+	if(serializer->_keyIndex < 0)
+		return {};
+	switch(serializer->_properties[serializer->_keyIndex].type) {
+	case QMetaType::Bool:
+	case QMetaType::Double:
+		return {};
+	default:
+		return serializer;
+	}
+}
+
+QJsonValue GadgetSerializer::read(const Property &property, const void *gadget) const
+{
+	switch(property.type) {
+	case QMetaType::Bool:
+		return readProperty<bool>(property.owner, property.index, gadget);
+	case QMetaType::Int:
+		return readProperty<int>(property.owner, property.index, gadget);
+	case QMetaType::UInt:
+		return static_cast<double>(readProperty<uint>(property.owner, property.index, gadget));
+	case QMetaType::LongLong:
+		return static_cast<double>(readProperty<qint64>(property.owner, property.index, gadget));
+	case QMetaType::ULongLong:
+		return static_cast<double>(readProperty<quint64>(property.owner, property.index, gadget));
+	case QMetaType::Double:
+		return readProperty<double>(property.owner, property.index, gadget);
+	case QMetaType::QString:
+		return readProperty<QString>(property.owner, property.index, gadget);
+	default:
+		Q_UNREACHABLE();
+		return {};
+	}
+}
+
+bool GadgetSerializer::write(const Property &property, const QJsonValue &value, void *gadget) const
+{
+	switch(property.type) {
+	case QMetaType::Bool:
+		if(!value.isBool())
+			return false;
+		writeProperty(property.owner, property.index, gadget, value.toBool());
+		return true;
+	case QMetaType::Int:
+		return writeInteger<int>(property.owner, property.index, gadget, value);
+	case QMetaType::UInt:
+		return writeInteger<uint>(property.owner, property.index, gadget, value);
+	case QMetaType::LongLong:
+		return writeInteger<qint64>(property.owner, property.index, gadget, value);
+	case QMetaType::ULongLong:
+		return writeInteger<quint64>(property.owner, property.index, gadget, value);
+	case QMetaType::Double:
+		if(!value.isDouble())
+			return false;
+		writeProperty(property.owner, property.index, gadget, value.toDouble());
+		return true;
+	case QMetaType::QString:
+		if(!value.isString())
+			return false;
+		writeProperty(property.owner, property.index, gadget, value.toString());
+		return true;
+	default:
+		Q_UNREACHABLE();
+		return false;
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef QTDATASYNC_GADGETSERIALIZER_P_H
+#define QTDATASYNC_GADGETSERIALIZER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMetaObject>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+
+#include "qtdatasync_global.h"
+
+namespace QtDataSync {
+
+//export needed for tests
+class Q_DATASYNC_EXPORT GadgetSerializer
+{
+	Q_DISABLE_COPY(GadgetSerializer)
+
+public:
+	//null for types that are no gadgets, or have stored properties of types not handled here.
+	//The property table is built once per type and shared by all setups
+	static QSharedPointer<const GadgetSerializer> forType(int metaTypeId);
+
+	int metaTypeId() const;
+	//the value of the USER property, empty if it cannot be converted
+	QString key(const void *gadget) const;
+	//creates the same json as the QJsonSerializer, for the types handled here
+	QJsonObject serialize(const void *gadget) const;
+	//returns false if the data contains other properties or values that would need conversions.
+	//The QJsonSerializer must be used for such data. The gadget is left partially written in that case
+	bool deserialize(const QJsonObject &data, void *gadget) const;
+
+private:
+	struct Property {
+		QString name;
+		int type;
+		const QMetaObject *owner;
+		int index; //relative to the owner
+	};
+
+	static QReadWriteLock lock;
+	static QHash<int, QSharedPointer<const GadgetSerializer>> serializers;
+
+	const int _metaTypeId;
+	QVector<Property> _properties;
+	int _keyIndex = -1;
+
+	explicit GadgetSerializer(int metaTypeId);
+
+	static bool isSupported(int type);
+	static QSharedPointer<const GadgetSerializer> create(int metaTypeId);
+
+	QJsonValue read(const Property &property, const void *gadget) const;
+	bool write(const Property &property, const QJsonValue &value, void *gadget) const;
+};
+
+}
+
+#endif // QTDATASYNC_GADGETSERIALIZER_P_H
@@ -0,0 +1,145 @@
+#include "keyfilter_p.h"
+
+using namespace QtDataSync;
+
+//about 1% false positives with 10 bits per key and 7 hashes
+const int KeyFilter::BitsPerKey = 10;
+const int KeyFilter::HashCount = 7;
+const int KeyFilter::MinCapacity = 1024;
+
+KeyFilter::KeyFilter() = default;
+
+bool KeyFilter::isReady(const QByteArray &typeName) const
+{
+	return !filter(typeName).isNull();
+}
+
+bool KeyFilter::mayContain(const ObjectKey &key) const
+{
+	auto typeFilter = filter(key.typeName);
+	return !typeFilter || typeFilter->mayContain(key.id);
+}
+
+qint64 KeyFilter::epoch(const QByteArray &typeName, quint64 *generation) const
+{
+	auto typeFilter = filter(typeName);
+	if(generation)
+		*generation = typeFilter ? typeFilter->generation() : 0;
+	return typeFilter ? typeFilter->epoch() : -1;
+}
+
+void KeyFilter::insert(const ObjectKey &key)
+{
+	auto typeFilter = filter(key.typeName);
+	if(typeFilter && !typeFilter->insert(key.id))
+		invalidate(key.typeName); //too many keys, would produce mostly false positives
+}
+
+void KeyFilter::insert(const QByteArray &typeName, const QStringList &ids)
+{
+	auto typeFilter = filter(typeName);
+	if(!typeFilter)
+		return;
+	for(const auto &id : ids) {
+		if(!typeFilter->insert(id)) {
+			invalidate(typeName);
+			return;
+		}
+	}
+}
+
+void KeyFilter::insert(const ObjectKey &key, qint64 epoch)
+{
+	auto typeFilter = filter(key.typeName);
+	if(!typeFilter)
+		return;
+	//the key must be known before the epoch is, the filter might have been built after the first insert
+	if(!typeFilter->insert(key.id))
+		invalidate(key.typeName);
+	else
+		typeFilter->advance(epoch - 1, epoch);
+}
+
+void KeyFilter::build(const QByteArray &typeName, const QStringList &ids, qint64 epoch)
+{
+	//leave room to grow, so saving new datasets does not require a rebuild right away
+	auto typeFilter = QSharedPointer<Bloom>::create(qMax(ids.size() * 2, MinCapacity), epoch, _nextGeneration.fetchAndAddRelaxed(1) + 1);
+	for(const auto &id : ids)
+		typeFilter->insert(id);
+
+	QWriteLocker _(&_lock);
+	auto current = _filters.value(typeName);
+	if(!current || current->epoch() < epoch)
+		_filters.insert(typeName, typeFilter);
+}
+
+void KeyFilter::invalidate(const QByteArray &typeName)
+{
+	QWriteLocker _(&_lock);
+	if(typeName.isNull())
+		_filters.clear();
+	else
+		_filters.remove(typeName);
+}
+
+QSharedPointer<KeyFilter::Bloom> KeyFilter::filter(const QByteArray &typeName) const
+{
+	QReadLocker _(&_lock);
+	return _filters.value(typeName);
+}
+
+
+
+KeyFilter::Bloom::Bloom(int capacity, qint64 epoch, quint64 generation) :
+	_bits((capacity * BitsPerKey + 31) / 32),
+	_bitCount{static_cast<uint>(_bits.size() * 32)},
+	_capacity{capacity},
+	_size{0},
+	_epoch{epoch},
+	_generation{generation}
+{}
+
+bool KeyFilter::Bloom::mayContain(const QString &id) const
+{
+	const auto h1 = qHash(id);
+	const auto h2 = qHash(id, 0x9E3779B9u) | 1u;
+	for(auto i = 0; i < HashCount; i++) {
+		auto index = bitIndex(h1, h2, i);
+		if((_bits[static_cast<int>(index / 32)].load() & (1u << (index % 32))) == 0)
+			return false;
+	}
+	return true;
+}
+
+bool KeyFilter::Bloom::insert(const QString &id)
+{
+	const auto h1 = qHash(id);
+	const auto h2 = qHash(id, 0x9E3779B9u) | 1u;
+	for(auto i = 0; i < HashCount; i++) {
+		auto index = bitIndex(h1, h2, i);
+		_bits[static_cast<int>(index / 32)].fetchAndOrRelaxed(1u << (index % 32));
+	}
+	return ++_size <= _capacity;
+}
+
+qint64 KeyFilter::Bloom::epoch() const
+{
+	return _epoch.load();
+}
+
+bool KeyFilter::Bloom::advance(qint64 from, qint64 to)
+{
+	//a key stored by another process in between leaves the filter behind, until it is built again
+	return _epoch.testAndSetOrdered(from, to);
+}
+
+quint64 KeyFilter::Bloom::generation() const
+{
+	return _generation;
+}
+
+uint KeyFilter::Bloom::bitIndex(uint h1, uint h2, int i) const
+{
+	//double hashing: h1 + i * h2 simulates independent hash functions
+	return (h1 + static_cast<uint>(i) * h2) % _bitCount;
+}
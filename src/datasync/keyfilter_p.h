@@ -0,0 +1,78 @@
+#ifndef QTDATASYNC_KEYFILTER_P_H
+#define QTDATASYNC_KEYFILTER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QStringList>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+
+namespace QtDataSync {
+
+//export needed for tests
+class Q_DATASYNC_EXPORT KeyFilter
+{
+	Q_DISABLE_COPY(KeyFilter)
+
+public:
+	static const int BitsPerKey;
+	static const int HashCount;
+	static const int MinCapacity;
+
+	KeyFilter();
+
+	//a type must be built from all stored keys before it can rule out any of them
+	bool isReady(const QByteArray &typeName) const;
+	//only false if the key was not stored up to the epoch of the filter. Types that are not ready always return true
+	bool mayContain(const ObjectKey &key) const;
+	//the stored key epoch of the type the filter knows all keys of, -1 if not ready. The generation changes whenever
+	//the filter of the type is replaced, so a confirmed epoch can be remembered for exactly one filter
+	qint64 epoch(const QByteArray &typeName, quint64 *generation = nullptr) const;
+	//called before the key is committed, so the filter never misses a key stored by this process
+	void insert(const ObjectKey &key);
+	void insert(const QByteArray &typeName, const QStringList &ids);
+	//called after the commit, with the epoch the key was stored with. Moves the filter to that epoch, if it knew the one before
+	void insert(const ObjectKey &key, qint64 epoch);
+	//the ids must be read from the same snapshot as the epoch. Filters that already know a newer epoch are kept
+	void build(const QByteArray &typeName, const QStringList &ids, qint64 epoch);
+	//the type must be built again before it is used. A null type name invalidates all types
+	void invalidate(const QByteArray &typeName = {});
+
+private:
+	//bloom filter, bits are only ever set, so they can be updated without a lock
+	class Bloom {
+	public:
+		Bloom(int capacity, qint64 epoch, quint64 generation);
+
+		bool mayContain(const QString &id) const;
+		//returns false once the filter holds more keys than it was sized for
+		bool insert(const QString &id);
+		qint64 epoch() const;
+		bool advance(qint64 from, qint64 to);
+		quint64 generation() const;
+
+	private:
+		QVector<QAtomicInteger<quint32>> _bits;
+		const uint _bitCount;
+		const int _capacity;
+		QAtomicInteger<int> _size;
+		QAtomicInteger<qint64> _epoch;
+		const quint64 _generation;
+
+		uint bitIndex(uint h1, uint h2, int i) const;
+	};
+
+	mutable QReadWriteLock _lock;
+	QHash<QByteArray, QSharedPointer<Bloom>> _filters;
+	QAtomicInteger<quint64> _nextGeneration;
+
+	QSharedPointer<Bloom> filter(const QByteArray &typeName) const;
+};
+
+}
+
+#endif // QTDATASYNC_KEYFILTER_P_H
@@ -2,16 +2,19 @@
 #include "changecontroller_p.h"
 #include "synchelper_p.h"
 #include "emitteradapter_p.h"
+#include "filestoragebackend_p.h"
+#include "packstoragebackend_p.h"
+#include "recordcodec_p.h"
 
-#include <QtCore/QUrl>
 #include <QtCore/QJsonDocument>
-#include <QtCore/QTemporaryFile>
 #include <QtCore/QCoreApplication>
-#include <QtCore/QSaveFile>
 #include <QtCore/QRegularExpression>
+#include <QtCore/QThreadPool>
+#include <QtCore/QDirIterator>
 
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlError>
+#include <QtSql/QSqlRecord>
 
 using namespace QtDataSync;
 using std::function;
@@ -21,54 +24,72 @@ using std::make_tuple;
 #define QTDATASYNC_LOG _logger
 #define SCOPE_ASSERT() Q_ASSERT_X(scope.d->database.isValid(), Q_FUNC_INFO, "Cannot use SyncScope after committing it")
 
+const QString LocalStore::inlineFileMarker(QStringLiteral(":inline"));
+const QByteArray LocalStore::compressionMagic("QDSZ");
+const int LocalStore::PreloadPageSize = 100;
+const int TrashSweepTask::SweepBatchSize = 1000;
+QMutex LocalStore::detectMutex;
+QSet<QString> LocalStore::detectedStores;
+const int FormatConversionTask::ConversionBatchSize = 100;
+
 LocalStore::LocalStore(Defaults defaults, QObject *parent) :
+	LocalStore{std::move(defaults), FullInit, parent}
+{}
+
+LocalStore::LocalStore(Defaults defaults, InitMode mode, QObject *parent) :
 	QObject{parent},
 	_defaults{std::move(defaults)},
 	_logger{_defaults.createLogger("store", this)},
 	_emitter{_defaults.createEmitter(this)},
-	_database{_defaults.aquireDatabase(this)}
+	_database{_defaults.aquireDatabase(this)},
+	_inlineThreshold{_defaults.property(Defaults::InlineThreshold).toInt()},
+	_compressionLevel{_defaults.property(Defaults::CompressionLevel).toInt()},
+	_compressionThreshold{_defaults.property(Defaults::CompressionThreshold).toInt()},
+	_checksumAlgorithm{static_cast<Setup::ChecksumAlgorithm>(_defaults.property(Defaults::ChecksumAlgorithm).toInt())},
+	_durability{static_cast<Setup::Durability>(_defaults.property(Defaults::Durability).toInt())},
+	_writeBuffer{_defaults.writeBuffer()},
+	_coalescingWindow{_defaults.property(Defaults::CoalescingWindow).toInt()},
+	_fileBackend{new FileStorageBackend{_defaults, _logger}},
+	_packBackend{new PackStorageBackend{_defaults, _logger, _database}},
+	_writeBackend{nullptr}
 {
+	//existing data is always read from where it was stored, only new writes use the configured engine
+	switch(_defaults.property(Defaults::StorageEngine).toInt()) {
+	case Setup::FileStorage:
+		_writeBackend = _fileBackend.data();
+		break;
+	case Setup::PackStorage:
+		_writeBackend = _packBackend.data();
+		break;
+	default:
+		Q_UNREACHABLE();
+		break;
+	}
+
+	for(const auto &typeName : _defaults.property(Defaults::DeferredChecksums).toStringList())
+		_deferredChecksums.insert(typeName.toUtf8());
+	auto coalescedTypes = _defaults.property(Defaults::CoalescedTypes).toHash();
+	for(auto it = coalescedTypes.constBegin(); it != coalescedTypes.constEnd(); it++)
+		_coalescedTypes.insert(it.key().toUtf8(), it.value().toInt());
+
 	connect(_emitter, &EmitterAdapter::dataChanged,
 			this, &LocalStore::dataChanged);
 	connect(_emitter, &EmitterAdapter::dataResetted,
 			this, &LocalStore::dataResetted);
 
-	if(!_database->tables().contains(QStringLiteral("DataIndex"))) {
-		QSqlQuery createQuery(_database);
-		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS DataIndex ("
-										   "	Type		TEXT NOT NULL,"
-										   "	Id			TEXT NOT NULL,"
-										   "	Version		INTEGER NOT NULL,"
-										   "	File		TEXT,"
-										   "	Checksum	BLOB,"
-										   "	Changed		INTEGER NOT NULL DEFAULT 1,"
-										   "	PRIMARY KEY(Type, Id)"
-										   ") WITHOUT ROWID;"));
-		if(!createQuery.exec()) {
-			throw LocalStoreException(_defaults,
-									  QByteArrayLiteral("any"),
-									  createQuery.executedQuery().simplified(),
-									  createQuery.lastError().text());
-		}
-		logDebug() << "Created DataIndex table";
-	}
-
-	if(!_database->tables().contains(QStringLiteral("DeviceUploads"))) {
-		QSqlQuery createQuery(_database);
-		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS DeviceUploads ( "
-										   "	Type	TEXT NOT NULL, "
-										   "	Id		TEXT NOT NULL, "
-										   "	Device	TEXT NOT NULL, "
-										   "	PRIMARY KEY(Type, Id, Device), "
-										   "	FOREIGN KEY(Type, Id) REFERENCES DataIndex ON DELETE CASCADE "
-										   ") WITHOUT ROWID;"));
-		if(!createQuery.exec()) {
-			throw LocalStoreException(_defaults,
-									  QByteArrayLiteral("any"),
-									  createQuery.executedQuery().simplified(),
-									  createQuery.lastError().text());
-		}
-		logDebug() << "Created DeviceUploads table";
+	//tasks are only scheduled by existing stores of the setup, so the database is ready and was checked already
+	if(mode == FullInit)
+		initDatabase();
+	initIndexes();
+
+	//stores created by older versions keep all files in one directory per type
+	if(mode == FullInit && _emitter->isPrimary()) {
+		_fileBackend->detectFlatLayout(_database);
+		checkCompaction();
+		detectLegacyRecords();
+		//continue removing what is left over from previous runs
+		if(StorageBackend::trashDirectory(_defaults).exists())
+			TrashSweepTask::schedule(_defaults);
 	}
 }
 
@@ -76,24 +97,84 @@ LocalStore::~LocalStore() = default;
 
 QJsonObject LocalStore::readJson(const ObjectKey &key, const QString &fileName, int *costs) const
 {
-	QFile file(filePath(key, fileName));
-	if(!file.open(QIODevice::ReadOnly))
-		throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+	if(fileName == inlineFileMarker) {
+		QSqlQuery dataQuery(_database);
+		dataQuery.prepare(QStringLiteral("SELECT Data FROM DataIndex WHERE Type = ? AND Id = ?"));
+		dataQuery.addBindValue(key.typeName);
+		dataQuery.addBindValue(key.id);
+		exec(dataQuery, key);
+
+		if(!dataQuery.first())
+			throw NoDataException(_defaults, key);
+		return readJson(key, fileName, dataQuery.value(0).toByteArray(), costs);
+	}
+
+	//the data returned by the backend is only valid until the next read, but decoding copies it
+	return decodeJson(key, fileName, backend(fileName)->read(key, fileName), costs);
+}
+
+QJsonObject LocalStore::readJson(const ObjectKey &key, const QString &fileName, const QByteArray &data, int *costs) const
+{
+	if(fileName != inlineFileMarker)
+		return readJson(key, fileName, costs);
+	else
+		return decodeJson(key, _database->databaseName(), data, costs);
+}
+
+QJsonObject LocalStore::decodeJson(const ObjectKey &key, const QString &context, const QByteArray &data, int *costs) const
+{
+	if(RecordCodec::isRecord(data)) {
+		QJsonObject object;
+		QString error;
+		if(!RecordCodec::readRecord(data, object, error, costs)) //the cache holds the uncompressed body
+			throw LocalStoreException(_defaults, key, context, error);
+		return object;
+	}
 
-	auto doc = QJsonDocument::fromBinaryData(file.readAll());
-	if(costs)
-		*costs = static_cast<int>(file.size());
-	file.close();
+	//written by older versions as binary json, possibly compressed
+	QJsonDocument doc;
+	if(data.startsWith(compressionMagic)) {
+		auto rawData = qUncompress(reinterpret_cast<const uchar*>(data.constData()) + compressionMagic.size(),
+								   data.size() - compressionMagic.size());
+		if(rawData.isEmpty())
+			throw LocalStoreException(_defaults, key, context, QStringLiteral("Failed to decompress stored data"));
+		doc = QJsonDocument::fromBinaryData(rawData);
+		if(costs) //the cache holds the decompressed data
+			*costs = rawData.size();
+	} else {
+		doc = QJsonDocument::fromBinaryData(data);
+		if(costs)
+			*costs = data.size();
+	}
 
 	if(!doc.isObject())
-		throw LocalStoreException(_defaults, key, file.fileName(), QStringLiteral("File contains invalid json data"));
+		throw LocalStoreException(_defaults, key, context, QStringLiteral("Stored data contains invalid json data"));
 	return doc.object();
 }
 
+QByteArray LocalStore::encodeData(const ObjectKey &key, const QByteArray &body) const
+{
+	if(_compressionLevel == 0 || body.size() < _compressionThreshold)
+		return RecordCodec::createRecord(body);
+
+	auto compressed = qCompress(body, _compressionLevel);
+	if(compressed.size() >= body.size()) //not worth it
+		return RecordCodec::createRecord(body);
+
+	logDebug().noquote() << "Compressed dataset" << key
+						 << "from" << body.size()
+						 << "to" << compressed.size()
+						 << QStringLiteral("bytes (%1%)")
+							.arg(100.0 * compressed.size() / body.size(), 0, 'f', 1);
+	return RecordCodec::createRecord(compressed, RecordCodec::Compressed);
+}
+
 quint64 LocalStore::count(const QByteArray &typeName) const
 {
+	flushType(typeName);
+
 	QSqlQuery countQuery(_database);
-	countQuery.prepare(QStringLiteral("SELECT Count(*) FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+	countQuery.prepare(QStringLiteral("SELECT Objects FROM TypeStats WHERE Type = ?"));
 	countQuery.addBindValue(typeName);
 	exec(countQuery, typeName);
 
@@ -105,6 +186,8 @@ quint64 LocalStore::count(const QByteArray &typeName) const
 
 QStringList LocalStore::keys(const QByteArray &typeName) const
 {
+	flushType(typeName);
+
 	QSqlQuery keysQuery(_database);
 	keysQuery.prepare(QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
 	keysQuery.addBindValue(typeName);
@@ -118,12 +201,16 @@ QStringList LocalStore::keys(const QByteArray &typeName) const
 
 QList<QJsonObject> LocalStore::loadAll(const QByteArray &typeName) const
 {
+	flushType(typeName);
+
 	//read transaction used to prevent writes while reading json files
 	beginReadTransaction(typeName);
 
 	try {
 		QSqlQuery loadQuery(_database);
-		loadQuery.prepare(QStringLiteral("SELECT Id, File FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+		//ordered by location, so packed datasets are read sequentially
+		loadQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL%1")
+						  .arg(_writeBackend->prefersOrderedReads() ? QStringLiteral(" ORDER BY File") : QString()));
 		loadQuery.addBindValue(typeName);
 		exec(loadQuery, typeName);
 
@@ -133,7 +220,7 @@ QList<QJsonObject> LocalStore::loadAll(const QByteArray &typeName) const
 		while(loadQuery.next()) {
 			int size;
 			ObjectKey key {typeName, loadQuery.value(0).toString()};
-			auto json = readJson(key, loadQuery.value(1).toString(), &size);
+			auto json = readJson(key, loadQuery.value(1).toString(), loadQuery.value(2).toByteArray(), &size);
 			keys.append(key);
 			array.append(json);
 			sizes.append(size);
@@ -152,75 +239,271 @@ QList<QJsonObject> LocalStore::loadAll(const QByteArray &typeName) const
 	}
 }
 
-QJsonObject LocalStore::load(const ObjectKey &key) const
+void LocalStore::iterate(const QByteArray &typeName, int pageSize, bool useCache, const function<bool(QString, QJsonObject)> &visitor) const
+{
+	Q_ASSERT_X(pageSize > 0, Q_FUNC_INFO, "pageSize must be greater than 0");
+	flushType(typeName);
+
+	QString lastId;
+	forever {
+		QStringList ids;
+		QList<QJsonObject> page;
+
+		//read transaction per page only, so writes are possible in between
+		beginReadTransaction(typeName);
+		try {
+			//keyset pagination, as the primary key is ordered by (Type, Id)
+			QSqlQuery pageQuery(_database);
+			pageQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex "
+											 "WHERE Type = ? AND Id %1 ? AND File IS NOT NULL "
+											 "ORDER BY Id "
+											 "LIMIT ?")
+							  .arg(lastId.isNull() ? QStringLiteral(">=") : QStringLiteral(">")));
+			pageQuery.addBindValue(typeName);
+			pageQuery.addBindValue(lastId.isNull() ? QStringLiteral("") : lastId);
+			pageQuery.addBindValue(pageSize);
+			exec(pageQuery, typeName);
+
+			QList<ObjectKey> cacheKeys;
+			QList<QJsonObject> cacheData;
+			QList<int> cacheSizes;
+			while(pageQuery.next()) {
+				ObjectKey key {typeName, pageQuery.value(0).toString()};
+				QJsonObject json;
+				if(!_emitter->getCached(key, json)) {
+					int size;
+					json = readJson(key, pageQuery.value(1).toString(), pageQuery.value(2).toByteArray(), &size);
+					if(useCache) {
+						cacheKeys.append(key);
+						cacheData.append(json);
+						cacheSizes.append(size);
+					}
+				}
+				ids.append(key.id);
+				page.append(json);
+			}
+
+			if(!cacheKeys.isEmpty())
+				_emitter->putCached(cacheKeys, cacheData, cacheSizes);
+
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			_database->rollback();
+			throw;
+		}
+
+		//pass the page to the visitor outside of the transaction
+		for(auto i = 0; i < page.size(); i++) {
+			if(!visitor(ids[i], page[i]))
+				return;
+		}
+
+		if(page.size() < pageSize)
+			return;
+		lastId = ids.last();
+	}
+}
+
+QJsonObject LocalStore::load(const ObjectKey &key, quint64 *generation) const
 {
-	//check if cached
 	QJsonObject json;
-	if(_emitter->getCached(key, json))
-		return json;
+	if(!tryLoad(key, json, generation))
+		throw NoDataException(_defaults, key);
+	return json;
+}
+
+bool LocalStore::tryLoad(const ObjectKey &key, QJsonObject &data, quint64 *generation) const
+{
+	//check if not written yet or cached
+	if(generation)
+		*generation = 0;
+	recordAccess(key);
+	if(_writeBuffer->get(key, data))
+		return true;
+	//cached datasets are stored, so only misses need the filter
+	if(_emitter->getCached(key, data, generation))
+		return true;
+	if(!mayContain(key))
+		return false;
 
 	if(!_database->transaction())
 		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
 
 	try {
 		QSqlQuery loadQuery(_database);
-		loadQuery.prepare(QStringLiteral("SELECT File FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+		loadQuery.prepare(QStringLiteral("SELECT File, Data FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
 		loadQuery.addBindValue(key.typeName);
 		loadQuery.addBindValue(key.id);
 		exec(loadQuery, key);
 
-		if(loadQuery.first()) {
+		auto found = loadQuery.first();
+		if(found) {
 			int size;
-			json = readJson(key, loadQuery.value(0).toString(), &size);
-			_emitter->putCached(key, json, size);
-		} else
-			throw NoDataException(_defaults, key);
+			data = readJson(key, loadQuery.value(0).toString(), loadQuery.value(1).toByteArray(), &size);
+			auto cacheGeneration = _emitter->putCached(key, data, size);
+			if(generation)
+				*generation = cacheGeneration;
+		}
 
 		//commit db
 		if(!_database->commit())
 			throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
 
-		return json;
+		return found;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+bool LocalStore::contains(const ObjectKey &key) const
+{
+	QJsonObject json;
+	if(_writeBuffer->get(key, json))
+		return true;
+	if(_emitter->getCached(key, json))
+		return true;
+	if(!mayContain(key))
+		return false;
+
+	QSqlQuery containsQuery(_database);
+	containsQuery.prepare(QStringLiteral("SELECT 1 FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+	containsQuery.addBindValue(key.typeName);
+	containsQuery.addBindValue(key.id);
+	exec(containsQuery, key);
+	return containsQuery.first();
+}
+
+bool LocalStore::loadTyped(const ObjectKey &key, int metaTypeId, QVariant &value) const
+{
+	//misses are recorded by the load that follows
+	if(!_emitter->getCachedTyped(key, metaTypeId, value))
+		return false;
+	recordAccess(key);
+	return true;
+}
+
+int LocalStore::preload(const QByteArray &typeName, int recentCount) const
+{
+	auto loaded = 0;
+	if(recentCount <= 0) {
+		iterate(typeName, PreloadPageSize, true, [&](const QString &, const QJsonObject &) {
+			loaded++;
+			return true;
+		});
+		return loaded;
+	}
+
+	flushType(typeName);
+	beginReadTransaction(typeName);
+	try {
+		QSqlQuery recentQuery(_database);
+		recentQuery.prepare(QStringLiteral("SELECT DataIndex.Id, DataIndex.File, DataIndex.Data "
+										   "FROM AccessHints "
+										   "INNER JOIN DataIndex "
+										   "ON (AccessHints.Type = DataIndex.Type AND AccessHints.Id = DataIndex.Id) "
+										   "WHERE AccessHints.Type = ? AND DataIndex.File IS NOT NULL "
+										   "ORDER BY AccessHints.LastAccess DESC "
+										   "LIMIT ?"));
+		recentQuery.addBindValue(typeName);
+		recentQuery.addBindValue(recentCount);
+		exec(recentQuery, typeName);
+
+		//most recent first, so those are kept if not all of them fit
+		QList<ObjectKey> keys;
+		QList<QJsonObject> array;
+		QList<int> sizes;
+		while(recentQuery.next()) {
+			ObjectKey key {typeName, recentQuery.value(0).toString()};
+			int size;
+			auto json = readJson(key, recentQuery.value(1).toString(), recentQuery.value(2).toByteArray(), &size);
+			keys.append(key);
+			array.append(json);
+			sizes.append(size);
+		}
+
+		_emitter->putCached(keys, array, sizes);
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		return keys.size();
 	} catch(...) {
 		_database->rollback();
 		throw;
 	}
 }
 
+void LocalStore::cacheTyped(const ObjectKey &key, quint64 generation, int metaTypeId, const QVariant &value) const
+{
+	if(generation != 0)
+		_emitter->putCachedTyped(key, generation, metaTypeId, value);
+}
+
 void LocalStore::save(const ObjectKey &key, const QJsonObject &data)
 {
-	beginWriteTransaction(key);
+	//keep the data in memory, repeated saves within the window are written only once
+	auto window = _coalescedTypes.value(key.typeName, _coalescingWindow);
+	if(window > 0 && _emitter->isPrimary()) {
+		_writeBuffer->put(key, data, window);
+		//loads are answered by the buffer, the cache gets the data with its stored size once it is written
+		_emitter->dropCached(key);
+		//the upload is triggered once the data was written
+		_emitter->triggerChange(key, false, false);
+		return;
+	}
+
+	//concurrent saves are committed together by one of the saving threads
+	if(_durability != Setup::DurabilityFull) {
+		_defaults.writeQueue()->save(key, data, [this](const QList<WriteQueue::Request*> &group) {
+			return saveGroup(group);
+		});
+	} else
+		saveDirect(key, data)();
+}
+
+void LocalStore::saveBatch(const QByteArray &typeName, const QList<QPair<QString, QJsonObject>> &data)
+{
+	if(data.isEmpty())
+		return;
+
+	QStringList ids;
+	ids.reserve(data.size());
+	for(const auto &entry : data)
+		ids.append(entry.first);
+
+	//saved before, but not written yet -> the batch replaces the older data
+	QScopedPointer<QMutexLocker> flushLocker;
+	QList<WriteBuffer::Entry> replaced;
+	if(!_writeBuffer->isEmpty()) {
+		flushLocker.reset(new QMutexLocker{_writeBuffer->flushMutex()});
+		for(const auto &entry : _writeBuffer->pending(typeName)) {
+			if(ids.contains(entry.key.id))
+				replaced.append(entry);
+		}
+	}
+
+	beginWriteTransaction(typeName);
 
 	try {
-		//check if the file exists
-		QSqlQuery existQuery(_database);
-		existQuery.prepare(QStringLiteral("SELECT Version, File FROM DataIndex WHERE Type = ? AND Id = ?"));
-		existQuery.addBindValue(key.typeName);
-		existQuery.addBindValue(key.id);
-		exec(existQuery, key);
-
-		//create the file device to write to
-		quint64 version = 1ull;
-		bool existing = existQuery.first();
-		if(existing)
-			version = existQuery.value(0).toULongLong() + 1ull;
-
-		//perform store operation
-		auto resFn = storeChangedImpl(_database,
-									  key,
-									  version,
-									  existing ? existQuery.value(1).toString() : QString(),
-									  data,
-									  true,
-									  existing);
+		//store all datasets in the same transaction, the per key change triggers are replaced by one for all
+		QList<function<void()>> resFns;
+		resFns.reserve(data.size());
+		for(const auto &entry : data)
+			resFns.append(saveImpl({typeName, entry.first}, entry.second, false));
 
 		//commit database changes
 		if(!_database->commit())
-			throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
 
-		resFn();
+		for(const auto &resFn : resFns)
+			resFn();
+		_writeBuffer->release(replaced);
+		//trigger change signals
+		_emitter->triggerChanges(typeName, ids, true);
+		checkCompaction();
 	} catch(...) {
-		_emitter->dropCached(key);
+		_emitter->dropCached(typeName, ids);
 		_database->rollback();
 		throw;
 	}
@@ -228,6 +511,7 @@ void LocalStore::save(const ObjectKey &key, const QJsonObject &data)
 
 bool LocalStore::remove(const ObjectKey &key)
 {
+	flushKey(key);
 	beginWriteTransaction(key);
 
 	try {
@@ -243,21 +527,28 @@ bool LocalStore::remove(const ObjectKey &key)
 
 			//"remove" from db
 			QSqlQuery removeQuery(_database);
-			removeQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Changed = 1 WHERE Type = ? AND Id = ?"));
+			removeQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Changed = 1, Data = NULL WHERE Type = ? AND Id = ?"));
 			removeQuery.addBindValue(version);
 			removeQuery.addBindValue(key.typeName);
 			removeQuery.addBindValue(key.id);
 			exec(removeQuery, key);
+			removeIndexes(_database, key);
+			removeTextIndex(_database, key);
 
-			//delete the file
-			QFile rmFile(filePath(key, loadQuery.value(1).toString()));
-			if(!rmFile.remove())
-				throw LocalStoreException(_defaults, key, rmFile.fileName(), rmFile.errorString());
+			//delete the stored data
+			auto fileName = loadQuery.value(1).toString();
+			function<void()> removeFn;
+			if(fileName != inlineFileMarker)
+				removeFn = backend(fileName)->remove(_database, key, fileName);
 
 			//commit db
 			if(!_database->commit())
 				throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
 
+			if(removeFn)
+				removeFn();
+			checkCompaction();
+
 			//update cache
 			_emitter->dropCached(key);
 			//trigger change signals
@@ -278,6 +569,10 @@ bool LocalStore::remove(const ObjectKey &key)
 
 QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode) const
 {
+	flushType(typeName);
+	if(mode == DataStore::FullTextMode)
+		return findText(typeName, query);
+
 	auto searchQuery = query;
 	if(mode != DataStore::RegexpMode) { //escape any of the like wildcard literals
 		if(mode != DataStore::WildcardMode)
@@ -313,7 +608,7 @@ QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &q
 
 	try {
 		QSqlQuery findQuery(_database);
-		auto queryStr = QStringLiteral("SELECT Id, File FROM DataIndex WHERE Type = ? AND %1 AND File IS NOT NULL");
+		auto queryStr = QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND %1 AND File IS NOT NULL");
 		if(mode == DataStore::RegexpMode)
 			queryStr = queryStr.arg(QStringLiteral("Id REGEXP ?"));
 		else
@@ -329,7 +624,91 @@ QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &q
 		while(findQuery.next()) {
 			int size;
 			ObjectKey key {typeName, findQuery.value(0).toString()};
-			auto json = readJson(key, findQuery.value(1).toString(), &size);
+			auto json = readJson(key, findQuery.value(1).toString(), findQuery.value(2).toByteArray(), &size);
+			keys.append(key);
+			array.append(json);
+			sizes.append(size);
+		}
+
+		_emitter->putCached(keys, array, sizes);
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+
+		return array;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+QList<QJsonObject> LocalStore::query(const QByteArray &typeName, const QString &property, DataStore::QueryOperator op, const QVariant &value) const
+{
+	flushType(typeName);
+	if(!_indexes.value(typeName).contains(property)) {
+		throw InvalidDataException(_defaults,
+								   typeName,
+								   QStringLiteral("Property %1 is not indexed. Use Setup::addPropertyIndex to create an index for it")
+								   .arg(property));
+	}
+
+	auto queryValue = indexValue(QJsonValue::fromVariant(value));
+	if(!queryValue.isValid()) {
+		throw InvalidDataException(_defaults,
+								   typeName,
+								   QStringLiteral("Only strings, numbers and booleans can be used to query indexed properties"));
+	}
+
+	QString opStr;
+	switch(op) {
+	case DataStore::EqualTo:
+		opStr = QStringLiteral("=");
+		break;
+	case DataStore::NotEqualTo:
+		opStr = QStringLiteral("!=");
+		break;
+	case DataStore::LessThan:
+		opStr = QStringLiteral("<");
+		break;
+	case DataStore::LessOrEqual:
+		opStr = QStringLiteral("<=");
+		break;
+	case DataStore::GreaterThan:
+		opStr = QStringLiteral(">");
+		break;
+	case DataStore::GreaterOrEqual:
+		opStr = QStringLiteral(">=");
+		break;
+	default:
+		Q_UNREACHABLE();
+		break;
+	}
+
+	beginReadTransaction(typeName);
+
+	try {
+		QSqlQuery indexQuery(_database);
+		indexQuery.prepare(QStringLiteral("SELECT DataIndex.Id, DataIndex.File, DataIndex.Data "
+										  "FROM PropertyIndex "
+										  "INNER JOIN DataIndex "
+										  "ON (PropertyIndex.Type = DataIndex.Type AND PropertyIndex.Id = DataIndex.Id) "
+										  "WHERE PropertyIndex.Type = ? AND PropertyIndex.Property = ? AND PropertyIndex.Value %1 ? "
+										  "AND typeof(PropertyIndex.Value) = ? " //sqlite orders different types, but they should never match
+										  "AND DataIndex.File IS NOT NULL")
+						   .arg(opStr));
+		indexQuery.addBindValue(typeName);
+		indexQuery.addBindValue(property);
+		indexQuery.addBindValue(queryValue);
+		indexQuery.addBindValue(queryValue.type() == QVariant::String ? QStringLiteral("text") : QStringLiteral("real"));
+		exec(indexQuery, typeName);
+
+		QList<ObjectKey> keys;
+		QList<QJsonObject> array;
+		QList<int> sizes;
+		while(indexQuery.next()) {
+			int size;
+			ObjectKey key {typeName, indexQuery.value(0).toString()};
+			auto json = readJson(key, indexQuery.value(1).toString(), indexQuery.value(2).toByteArray(), &size);
 			keys.append(key);
 			array.append(json);
 			sizes.append(size);
@@ -349,6 +728,15 @@ QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &q
 
 void LocalStore::clear(const QByteArray &typeName)
 {
+	//datasets that were not written yet are simply dropped
+	QStringList droppedKeys;
+	if(!_writeBuffer->isEmpty()) {
+		QMutexLocker _(_writeBuffer->flushMutex());
+		for(const auto &entry : _writeBuffer->pending(typeName))
+			droppedKeys.append(entry.key.id);
+		_writeBuffer->discard(typeName);
+	}
+
 	beginWriteTransaction(typeName, true);
 
 	try {
@@ -361,26 +749,38 @@ void LocalStore::clear(const QByteArray &typeName)
 		QStringList clearKeys;
 		while(clearInfoQuery.next())
 			clearKeys.append(clearInfoQuery.value(0).toString());
+		for(const auto &id : qAsConst(droppedKeys)) {
+			if(!clearKeys.contains(id))
+				clearKeys.append(id);
+		}
 
 		// clear them
 		QSqlQuery clearQuery(_database);
 		clearQuery.prepare(QStringLiteral("UPDATE DataIndex "
-										  "SET Version = Version + 1, File = NULL, Checksum = NULL, Changed = 1 "
+										  "SET Version = Version + 1, File = NULL, Checksum = NULL, Changed = 1, Data = NULL "
 										  "WHERE Type = ? AND File IS NOT NULL"));
 		clearQuery.addBindValue(typeName);
 		exec(clearQuery, typeName);
 
-		auto tableDir = typeDirectory(typeName);
-		if(!tableDir.removeRecursively()) {
-			logWarning() << "Failed to delete cleared data directory for type"
-						 << typeName;
+		if(_indexes.contains(typeName)) {
+			QSqlQuery clearIndexQuery(_database);
+			clearIndexQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ?"));
+			clearIndexQuery.addBindValue(typeName);
+			exec(clearIndexQuery, typeName);
 		}
+		if(_textIndexes.contains(typeName))
+			clearTextIndex(typeName);
+
+		_fileBackend->clear(_database, typeName);
+		_packBackend->clear(_database, typeName);
 
 		if(!_database->commit())
 			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		TrashSweepTask::schedule(_defaults);
 
-		//clear cache
+		//clear cache. The filter would still work, but only produce false positives
 		_emitter->dropCached(typeName, clearKeys);
+		_defaults.keyFilter()->invalidate(typeName);
 		//trigger change signals
 		_emitter->triggerClear(typeName, clearKeys);
 	} catch(...) {
@@ -391,6 +791,11 @@ void LocalStore::clear(const QByteArray &typeName)
 
 void LocalStore::reset(bool keepData)
 {
+	if(!keepData && !_writeBuffer->isEmpty()) {
+		QMutexLocker _(_writeBuffer->flushMutex());
+		_writeBuffer->discard();
+	}
+
 	beginWriteTransaction(ObjectKey{"any"}, true);
 
 	try {
@@ -401,18 +806,41 @@ void LocalStore::reset(bool keepData)
 
 			//also: delete all not done device changes
 			QSqlQuery clearDevicesQuery(_database);
-			clearDevicesQuery.prepare(QStringLiteral("DELETE FROM DeviceUploads"));
+			clearDevicesQuery.prepare(QStringLiteral("DELETE FROM DeviceCursors"));
 			exec(clearDevicesQuery);
 		} else { //delete everything
 			QSqlQuery resetQuery(_database);
 			resetQuery.prepare(QStringLiteral("DELETE FROM DataIndex"));
 			exec(resetQuery);
 
+			QSqlQuery clearDevicesQuery(_database);
+			clearDevicesQuery.prepare(QStringLiteral("DELETE FROM DeviceCursors"));
+			exec(clearDevicesQuery);
+
+			//the index definitions stay, only the values are dropped
+			QSqlQuery resetIndexQuery(_database);
+			resetIndexQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex"));
+			exec(resetIndexQuery);
+			if(_database->tables().contains(QStringLiteral("TextIndexKeys"))) {
+				QSqlQuery resetTextQuery(_database);
+				resetTextQuery.prepare(QStringLiteral("DELETE FROM TextIndex"));
+				exec(resetTextQuery);
+
+				QSqlQuery resetTextKeysQuery(_database);
+				resetTextKeysQuery.prepare(QStringLiteral("DELETE FROM TextIndexKeys"));
+				exec(resetTextKeysQuery);
+			}
+
+			_fileBackend->reset(_database);
+			_packBackend->reset(_database);
+
 			//note: resets are local only, so they dont trigger any changecontroller stuff
 
+			//the files are removed in the background, the rename is enough to be gone from the store
 			auto tableDir = _defaults.storageDir();
 			if(tableDir.cd(QStringLiteral("store"))) {
-				if(!tableDir.removeRecursively()) //no rollback, as partially removed is possible, better keep junk data...
+				if(!StorageBackend::moveToTrash(_defaults, tableDir.absolutePath()) &&
+				   !tableDir.removeRecursively()) //no rollback, as partially removed is possible, better keep junk data...
 					logWarning() << "Failed to delete store directory" << tableDir.absolutePath();
 			}
 		}
@@ -422,8 +850,10 @@ void LocalStore::reset(bool keepData)
 
 		//only if data was actually deleted
 		if(!keepData) {
+			TrashSweepTask::schedule(_defaults);
 			//clear cache
 			_emitter->dropCached();
+			_defaults.keyFilter()->invalidate();
 			//trigger change signals
 			_emitter->triggerReset();
 		}
@@ -433,18 +863,146 @@ void LocalStore::reset(bool keepData)
 	}
 }
 
+void LocalStore::compactStorage()
+{
+	//one transaction per round, as the file layout migration works in batches
+	do {
+		beginWriteTransaction();
+
+		function<void()> fileFn;
+		function<void()> packFn;
+		try {
+			//only moves data around, so neither the cache nor the change state are affected
+			fileFn = _fileBackend->compact(_database);
+			packFn = _packBackend->compact(_database);
+
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			_database->rollback();
+			throw;
+		}
+
+		if(fileFn)
+			fileFn();
+		if(packFn)
+			packFn();
+	} while(_fileBackend->takeCompactionRequest());
+}
+
+void LocalStore::flush()
+{
+	writeBuffered([this](){
+		return _writeBuffer->pending();
+	});
+}
+
+void LocalStore::flushAccessHints()
+{
+	auto accesses = _defaults.accessTracker()->take();
+	if(accesses.isEmpty())
+		return;
+
+	beginWriteTransaction();
+	try {
+		//removed datasets have no row to reference
+		QSqlQuery hintQuery(_database);
+		hintQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO AccessHints (Type, Id, LastAccess) "
+										 "SELECT Type, Id, ? FROM DataIndex "
+										 "WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+		for(auto it = accesses.constBegin(); it != accesses.constEnd(); it++) {
+			hintQuery.bindValue(0, it.value());
+			hintQuery.bindValue(1, it.key().typeName);
+			hintQuery.bindValue(2, it.key().id);
+			exec(hintQuery, it.key());
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArrayLiteral("any"), _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		//the taken hints are lost, AccessHintTask::failed logs the error
+		_database->rollback();
+		throw;
+	}
+}
+
+bool LocalStore::convertLegacyRecords(int limit)
+{
+	beginWriteTransaction();
+
+	QList<function<void()>> afterCommitFns;
+	auto converted = 0;
+	try {
+		QSqlQuery legacyQuery(_database);
+		legacyQuery.prepare(QStringLiteral("SELECT Type, Id, File, Data FROM DataIndex "
+										   "WHERE File IS NOT NULL AND Format IS NULL "
+										   "LIMIT ?"));
+		legacyQuery.addBindValue(limit);
+		exec(legacyQuery);
+
+		//only the encoding changes, so neither the cache, the checksums nor the indexes are affected
+		while(legacyQuery.next()) {
+			ObjectKey key {legacyQuery.value(0).toByteArray(), legacyQuery.value(1).toString()};
+			auto fileName = legacyQuery.value(2).toString();
+			auto data = readJson(key, fileName, legacyQuery.value(3).toByteArray(), nullptr);
+			auto storeData = encodeData(key, RecordCodec::encodeBody(data));
+
+			//datasets stay where they are, even if the inline threshold or the engine changed
+			StorageBackend::PendingWrite pending;
+			if(fileName == inlineFileMarker)
+				pending.location = inlineFileMarker;
+			else
+				pending = backend(fileName)->write(_database, key, fileName, storeData);
+
+			QSqlQuery updateQuery(_database);
+			updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = ?, Data = ?, Format = ? WHERE Type = ? AND Id = ?"));
+			updateQuery.addBindValue(pending.location);
+			updateQuery.addBindValue(fileName == inlineFileMarker ? QVariant{storeData} : QVariant{QVariant::ByteArray});
+			updateQuery.addBindValue(static_cast<int>(RecordCodec::FormatVersion));
+			updateQuery.addBindValue(key.typeName);
+			updateQuery.addBindValue(key.id);
+			exec(updateQuery, key);
+
+			if(pending.complete)
+				pending.complete();
+			if(pending.afterCommit)
+				afterCommitFns.append(pending.afterCommit);
+			converted++;
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArrayLiteral("any"), _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+
+	for(const auto &fn : qAsConst(afterCommitFns))
+		fn();
+	//rewritten pack records leave dead ones behind
+	checkCompaction();
+	if(converted > 0)
+		logDebug() << "Converted" << converted << "datasets from binary json to the record format";
+	//a full batch -> there might be more
+	return converted == limit;
+}
+
+void LocalStore::flushDue()
+{
+	writeBuffered([this](){
+		return _writeBuffer->pending(true);
+	});
+}
+
 quint32 LocalStore::changeCount() const
 {
 	QSqlQuery countQuery(_database);
-	countQuery.prepare(QStringLiteral("SELECT Sum(rows) FROM ( "
-									  "		SELECT Count(*) AS rows FROM DataIndex "
-									  "		WHERE Changed = 1"
-									  "		UNION ALL"
-									  "		SELECT Count(*) AS rows FROM DataIndex "
-									  "		INNER JOIN DeviceUploads "
-									  "		ON DataIndex.Type = DeviceUploads.Type "
-									  "		AND DataIndex.Id = DeviceUploads.Id "
-									  "		WHERE NOT (DataIndex.Changed = 1 AND File IS NULL)"
+	//device uploads are everything after the device cursors, so the scan shrinks as the uploads proceed
+	//both are counters kept in step by triggers, so this never scans the datasets
+	countQuery.prepare(QStringLiteral("SELECT ("
+									  "		SELECT IFNULL(Sum(Changes), 0) FROM TypeStats"
+									  ") + ("
+									  "		SELECT IFNULL(Sum(Pending), 0) FROM DeviceCursors"
 									  ")"));
 	exec(countQuery);
 
@@ -455,12 +1013,23 @@ quint32 LocalStore::changeCount() const
 }
 
 void LocalStore::loadChanges(int limit, const function<bool(ObjectKey, quint64, QString, QUuid)> &visitor) const
+{
+	quint64 changeCursor = 0;
+	loadChanges(limit, changeCursor, visitor);
+}
+
+void LocalStore::loadChanges(int limit, quint64 &changeCursor, const function<bool(ObjectKey, quint64, QString, QUuid)> &visitor) const
 {
 	beginReadTransaction();
 
 	try {
+		//continue after the last change passed to the visitor, in the order the changes were made
 		QSqlQuery readChangesQuery(_database);
-		readChangesQuery.prepare(QStringLiteral("SELECT Type, Id, Version, File FROM DataIndex WHERE Changed = 1 LIMIT ?"));
+		readChangesQuery.prepare(QStringLiteral("SELECT Type, Id, Version, File, ChangeSeq FROM DataIndex "
+												"WHERE Changed = 1 AND ChangeSeq > ? "
+												"ORDER BY ChangeSeq "
+												"LIMIT ?"));
+		readChangesQuery.addBindValue(changeCursor);
 		readChangesQuery.addBindValue(limit);
 		exec(readChangesQuery);
 
@@ -468,6 +1037,7 @@ void LocalStore::loadChanges(int limit, const function<bool(ObjectKey, quint64,
 		auto skip = false;
 		while(readChangesQuery.next()) {
 			cnt++;
+			changeCursor = readChangesQuery.value(4).toULongLong();
 			if(!visitor({readChangesQuery.value(0).toByteArray(), readChangesQuery.value(1).toString()},
 						readChangesQuery.value(2).toULongLong(),
 						readChangesQuery.value(3).toString(),
@@ -479,11 +1049,13 @@ void LocalStore::loadChanges(int limit, const function<bool(ObjectKey, quint64,
 
 		if(!skip && cnt < limit) {
 			QSqlQuery readDeviceChangesQuery(_database);
-			readDeviceChangesQuery.prepare(QStringLiteral("SELECT DeviceUploads.Type, DeviceUploads.Id, DataIndex.Version, DataIndex.File, DeviceUploads.Device "
-														  "FROM DeviceUploads "
+			readDeviceChangesQuery.prepare(QStringLiteral("SELECT DataIndex.Type, DataIndex.Id, DataIndex.Version, DataIndex.File, DeviceCursors.Device "
+														  "FROM DeviceCursors "
 														  "INNER JOIN DataIndex "
-														  "ON (DeviceUploads.Type = DataIndex.Type AND DeviceUploads.Id = DataIndex.Id) "
+														  "ON (DataIndex.Type, DataIndex.Id) > (DeviceCursors.Type, DeviceCursors.Id) "
 														  "WHERE NOT (DataIndex.Changed = 1 AND File IS NULL) " //only those that haven't been operated on before
+														  "AND (DeviceCursors.Bound IS NULL OR IFNULL(DataIndex.ChangeSeq, 0) <= DeviceCursors.Bound) " //later changes are normal uploads
+														  "ORDER BY DeviceCursors.Device, DataIndex.Type, DataIndex.Id "
 														  "LIMIT ?"));
 			readDeviceChangesQuery.addBindValue(limit - cnt);
 			exec(readDeviceChangesQuery);
@@ -512,18 +1084,49 @@ void LocalStore::markUnchanged(const ObjectKey &key, quint64 version, bool isDel
 	markUnchangedImpl(_database, key, version, isDelete);
 }
 
-void LocalStore::removeDeviceChange(const ObjectKey &key, QUuid deviceId)
+void LocalStore::completeDeviceChanges(const ObjectKey &lastKey, QUuid deviceId)
 {
-	QSqlQuery rmDeviceQuery(_database);
-	rmDeviceQuery.prepare(QStringLiteral("DELETE FROM DeviceUploads WHERE Type = ? AND Id = ? AND Device = ?"));
-	rmDeviceQuery.addBindValue(key.typeName);
-	rmDeviceQuery.addBindValue(key.id);
-	rmDeviceQuery.addBindValue(deviceId);
-	exec(rmDeviceQuery);
+	beginWriteTransaction(lastKey);
+
+	try {
+		//only the datasets the cursor moves over are counted
+		QSqlQuery advanceQuery(_database);
+		advanceQuery.prepare(QStringLiteral("UPDATE DeviceCursors "
+											"SET Pending = Pending - ( "
+											"	SELECT Count(*) FROM DataIndex "
+											"	WHERE (DataIndex.Type, DataIndex.Id) > (DeviceCursors.Type, DeviceCursors.Id) "
+											"	AND (DataIndex.Type, DataIndex.Id) <= (?, ?) "
+											"	AND NOT (DataIndex.Changed = 1 AND DataIndex.File IS NULL) "
+											"	AND (DeviceCursors.Bound IS NULL OR IFNULL(DataIndex.ChangeSeq, 0) <= DeviceCursors.Bound) "
+											"), Type = ?, Id = ? "
+											"WHERE Device = ? AND (Type, Id) < (?, ?)"));
+		advanceQuery.addBindValue(lastKey.typeName);
+		advanceQuery.addBindValue(lastKey.id);
+		advanceQuery.addBindValue(lastKey.typeName);
+		advanceQuery.addBindValue(lastKey.id);
+		advanceQuery.addBindValue(deviceId);
+		advanceQuery.addBindValue(lastKey.typeName);
+		advanceQuery.addBindValue(lastKey.id);
+		exec(advanceQuery, lastKey);
+
+		//nothing left for the device -> drop the cursor
+		QSqlQuery doneQuery(_database);
+		doneQuery.prepare(QStringLiteral("DELETE FROM DeviceCursors WHERE Device = ? AND Pending <= 0"));
+		doneQuery.addBindValue(deviceId);
+		exec(doneQuery, lastKey);
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, lastKey, _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
 }
 
 LocalStore::SyncScope LocalStore::startSync(const ObjectKey &key) const
 {
+	//local changes must be known before remote ones are applied
+	flushKey(key);
 	return SyncScope(_defaults, key, const_cast<LocalStore*>(this));
 }
 
@@ -543,8 +1146,11 @@ tuple<LocalStore::ChangeType, quint64, QString, QByteArray> LocalStore::loadChan
 		auto checksum = loadChangeQuery.value(2).toByteArray();
 		if(file.isNull())
 			return make_tuple(ExistsDeleted, version, QString(), QByteArray());
-		else
+		else {
+			if(checksum.isNull()) //deferred -> calculate it now
+				checksum = SyncHelper::jsonHash(readJson(scope.d->key, file), _checksumAlgorithm);
 			return make_tuple(Exists, version, file, checksum);
+		}
 	} else
 		return make_tuple(NoExists, 0, QString(), QByteArray());
 }
@@ -571,18 +1177,18 @@ void LocalStore::updateVersion(SyncScope &scope, quint64 oldVersion, quint64 new
 	}
 }
 
-void LocalStore::storeChanged(SyncScope &scope, quint64 version, const QString &fileName, const QJsonObject &data, bool changed, LocalStore::ChangeType localState)
+void LocalStore::storeChanged(SyncScope &scope, quint64 version, const QString &fileName, const QJsonObject &data, bool changed, LocalStore::ChangeType localState, const QByteArray &checksum)
 {
 	SCOPE_ASSERT();
 	Q_ASSERT_X(!scope.d->afterCommit, Q_FUNC_INFO, "Only 1 after commit action can be defined");
-	scope.d->afterCommit = storeChangedImpl(scope.d->database, scope.d->key, version, fileName, data, changed, localState != NoExists);
+	scope.d->afterCommit = storeChangedImpl(scope.d->database, scope.d->key, version, fileName, data, checksum, changed, localState != NoExists);
 }
 
 void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, ChangeType localState)
 {
 	SCOPE_ASSERT();
 
-	QString fileName;
+	function<void()> removeFn;
 	bool existing;
 	switch (localState) {
 	case Exists:
@@ -593,8 +1199,10 @@ void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, C
 		loadQuery.addBindValue(scope.d->key.id);
 		exec(loadQuery, scope.d->key);
 
-		if(loadQuery.first())
-			fileName = filePath(scope.d->key, loadQuery.value(0).toString());
+		if(loadQuery.first() && loadQuery.value(0).toString() != inlineFileMarker) {
+			auto fileName = loadQuery.value(0).toString();
+			removeFn = backend(fileName)->remove(scope.d->database, scope.d->key, fileName);
+		}
 		Q_FALLTHROUGH();
 	}
 	case ExistsDeleted:
@@ -610,12 +1218,14 @@ void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, C
 
 	if(existing) {
 		QSqlQuery updateQuery(scope.d->database);
-		updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Changed = ? WHERE Type = ? AND Id = ?"));
+		updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Changed = ?, Data = NULL WHERE Type = ? AND Id = ?"));
 		updateQuery.addBindValue(version);
 		updateQuery.addBindValue(changed);
 		updateQuery.addBindValue(scope.d->key.typeName);
 		updateQuery.addBindValue(scope.d->key.id);
 		exec(updateQuery, scope.d->key);
+		removeIndexes(scope.d->database, scope.d->key);
+		removeTextIndex(scope.d->database, scope.d->key);
 	} else {
 		QSqlQuery insertQuery(scope.d->database);
 		insertQuery.prepare(QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Changed) VALUES(?, ?, ?, NULL, NULL, ?)"));
@@ -626,13 +1236,6 @@ void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, C
 		exec(insertQuery, scope.d->key);
 	}
 
-	//delete the file, if one exists
-	if(!fileName.isNull()) {
-		QFile rmFile(fileName);
-		if(!rmFile.remove())
-			throw LocalStoreException(_defaults, scope.d->key, rmFile.fileName(), rmFile.errorString());
-	}
-
 	Q_ASSERT_X(!scope.d->afterCommit, Q_FUNC_INFO, "Only 1 after commit action can be defined");
 	if(localState == Exists) {
 		auto key = scope.d->key;
@@ -648,6 +1251,16 @@ void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, C
 			_emitter->triggerUpload();
 		};
 	}
+
+	//delete the stored data, if it exists
+	if(removeFn) {
+		auto afterCommit = scope.d->afterCommit;
+		scope.d->afterCommit = [removeFn, afterCommit]() {
+			removeFn();
+			if(afterCommit)
+				afterCommit();
+		};
+	}
 }
 
 void LocalStore::markUnchanged(SyncScope &scope, quint64 oldVersion, bool isDelete)
@@ -667,58 +1280,195 @@ void LocalStore::commitSync(SyncScope &scope) const
 		scope.d->afterCommit();
 
 	scope.d->database = DatabaseRef(); //clear the ref, so it won't rollback
+	checkCompaction();
 }
 
 void LocalStore::prepareAccountAdded(QUuid deviceId)
 {
 	try {
+		//the device gets everything after its cursor, which starts before the first dataset. Datasets changed
+		//after the grant get a higher change number and reach the device as normal uploads, so they are bound here
 		QSqlQuery insertQuery(_database);
-		insertQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO DeviceUploads (Type, Id, Device) "
-										   "SELECT Type, Id, ? FROM DataIndex"));
+		insertQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO DeviceCursors (Device, Type, Id, Bound, Pending) "
+										   "SELECT ?, '', '', Seq, ( "
+										   "	SELECT Count(*) FROM DataIndex "
+										   "	WHERE NOT (Changed = 1 AND File IS NULL) "
+										   ") FROM ChangeSequence"));
 		insertQuery.addBindValue(deviceId);
 		exec(insertQuery);
 
-		if(insertQuery.numRowsAffected() != 0) //in case of -1 (unknown), simply assue changed
+		QSqlQuery existsQuery(_database);
+		existsQuery.prepare(QStringLiteral("SELECT 1 FROM DataIndex LIMIT 1"));
+		exec(existsQuery);
+		if(existsQuery.first())
 			_emitter->triggerUpload();
 	} catch(Exception &e) {
 		logCritical() << "Failed to prepare added account with error:" << e.what();
 	}
 }
 
-QDir LocalStore::typeDirectory(const ObjectKey &key) const
+StorageBackend *LocalStore::backend(const QString &location) const
 {
-	auto encName = QUrl::toPercentEncoding(QString::fromUtf8(key.typeName))
-				   .replace('%', '_');
-	auto tName = QStringLiteral("store/data_%1").arg(QString::fromUtf8(encName));
-	auto tableDir = _defaults.storageDir();
-	if(!tableDir.mkpath(tName) || !tableDir.cd(tName)) {
-		throw LocalStoreException(_defaults, key, tName, QStringLiteral("Failed to create directory"));
-	} else
-		return tableDir;
+	if(PackStorageBackend::isPackLocation(location))
+		return _packBackend.data();
+	else
+		return _fileBackend.data();
 }
 
-QString LocalStore::filePath(const QDir &typeDir, const QString &baseName) const
+void LocalStore::checkCompaction() const
 {
-	return typeDir.absoluteFilePath(baseName + QStringLiteral(".dat"));
+	//both must be taken, so no short circuit
+	auto packRequest = _packBackend->takeCompactionRequest();
+	auto fileRequest = _fileBackend->takeCompactionRequest();
+	if(packRequest || fileRequest)
+		CompactionTask::schedule(_defaults);
 }
 
-QString LocalStore::filePath(const ObjectKey &key, const QString &baseName) const
+void LocalStore::flushType(const QByteArray &typeName) const
 {
-	return filePath(typeDirectory(key), baseName);
+	if(_writeBuffer->isEmpty())
+		return;
+	const_cast<LocalStore*>(this)->writeBuffered([this, typeName](){
+		return _writeBuffer->pending(typeName);
+	});
 }
 
-void LocalStore::beginReadTransaction(const ObjectKey &key) const
+void LocalStore::flushKey(const ObjectKey &key) const
 {
-	if(!_database->transaction())
-		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+	if(_writeBuffer->isEmpty())
+		return;
+	const_cast<LocalStore*>(this)->writeBuffered([this, key](){
+		return _writeBuffer->pending(key);
+	});
 }
 
-void LocalStore::beginWriteTransaction(const ObjectKey &key, bool exclusive)
+void LocalStore::writeBuffered(const function<QList<WriteBuffer::Entry>()> &fetchEntries)
 {
-	QSqlQuery transactQuery(_database);
-	if(!transactQuery.exec(QStringLiteral("BEGIN %1 TRANSACTION")
-						   .arg(exclusive ? QStringLiteral("EXCLUSIVE") : QStringLiteral("IMMEDIATE")))) {
-		throw LocalStoreException(_defaults,
+	if(_writeBuffer->isEmpty())
+		return;
+
+	//the lock must be taken before any transaction, and entries are fetched after it, so no other store writes them in between
+	QMutexLocker _(_writeBuffer->flushMutex());
+	QHash<QByteArray, QList<WriteBuffer::Entry>> typeEntries;
+	for(const auto &entry : fetchEntries())
+		typeEntries[entry.key.typeName].append(entry);
+	if(typeEntries.isEmpty())
+		return;
+
+	//one transaction per type, just like a batch save
+	for(auto it = typeEntries.constBegin(); it != typeEntries.constEnd(); it++) {
+		beginWriteTransaction(it.key());
+
+		QStringList ids;
+		QList<function<void()>> resFns;
+		try {
+			for(const auto &entry : it.value()) {
+				ids.append(entry.key.id);
+				resFns.append(saveImpl(entry.key, entry.data, false));
+			}
+
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, it.key(), _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			//entries stay in the buffer and are written with the next flush
+			_database->rollback();
+			throw;
+		}
+
+		for(const auto &resFn : resFns)
+			resFn();
+		_writeBuffer->release(it.value());
+		//trigger change signals, now with the upload
+		_emitter->triggerChanges(it.key(), ids, true);
+	}
+	checkCompaction();
+}
+
+bool LocalStore::mayContain(const ObjectKey &key) const
+{
+	auto keyFilter = _defaults.keyFilter();
+	if(keyFilter->mayContain(key) && keyFilter->isReady(key.typeName))
+		return true;
+
+	//a miss is only trusted if the filter knows every key stored by other connections and processes
+	try {
+		QSqlQuery versionQuery(_database);
+		versionQuery.prepare(QStringLiteral("PRAGMA data_version"));
+		exec(versionQuery, key);
+		const auto dataVersion = versionQuery.first() ? versionQuery.value(0).toLongLong() : -1;
+
+		//nothing was committed by other connections since the filter was confirmed, if the data version did not change
+		quint64 generation;
+		auto filterEpoch = keyFilter->epoch(key.typeName, &generation);
+		if(filterEpoch >= 0 && _confirmedFilters.value(key.typeName) == qMakePair(dataVersion, generation))
+			return keyFilter->mayContain(key);
+
+		QSqlQuery epochQuery(_database);
+		epochQuery.prepare(QStringLiteral("SELECT Epoch FROM KeyEpochs WHERE Type = ?"));
+		epochQuery.addBindValue(key.typeName);
+		exec(epochQuery, key);
+		auto storeEpoch = epochQuery.first() ? epochQuery.value(0).toLongLong() : 0;
+
+		if(filterEpoch < storeEpoch) {
+			//a read snapshot is enough, keys stored after it have a higher epoch
+			beginReadTransaction(key);
+			try {
+				QSqlQuery snapshotEpochQuery(_database);
+				snapshotEpochQuery.prepare(QStringLiteral("SELECT Epoch FROM KeyEpochs WHERE Type = ?"));
+				snapshotEpochQuery.addBindValue(key.typeName);
+				exec(snapshotEpochQuery, key);
+				storeEpoch = snapshotEpochQuery.first() ? snapshotEpochQuery.value(0).toLongLong() : 0;
+
+				QSqlQuery keysQuery(_database);
+				keysQuery.prepare(QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+				keysQuery.addBindValue(key.typeName);
+				exec(keysQuery, key);
+
+				QStringList ids;
+				while(keysQuery.next())
+					ids.append(keysQuery.value(0).toString());
+
+				if(!_database->commit())
+					throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+				keyFilter->build(key.typeName, ids, storeEpoch);
+			} catch(...) {
+				_database->rollback();
+				throw;
+			}
+
+			filterEpoch = keyFilter->epoch(key.typeName, &generation);
+			if(filterEpoch < storeEpoch) //replaced or invalidated concurrently
+				return true;
+		}
+
+		_confirmedFilters.insert(key.typeName, qMakePair(dataVersion, generation));
+	} catch(QException &e) {
+		//only an optimization, the store can still be asked directly
+		logWarning() << "Failed to check key filter for type" << key.typeName
+					 << "with error:" << e.what();
+		return true;
+	}
+	return keyFilter->mayContain(key);
+}
+
+void LocalStore::recordAccess(const ObjectKey &key) const
+{
+	if(_defaults.accessTracker()->record(key))
+		AccessHintTask::schedule(_defaults);
+}
+
+void LocalStore::beginReadTransaction(const ObjectKey &key) const
+{
+	if(!_database->transaction())
+		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+}
+
+void LocalStore::beginWriteTransaction(const ObjectKey &key, bool exclusive) const
+{
+	QSqlQuery transactQuery(_database);
+	if(!transactQuery.exec(QStringLiteral("BEGIN %1 TRANSACTION")
+						   .arg(exclusive ? QStringLiteral("EXCLUSIVE") : QStringLiteral("IMMEDIATE")))) {
+		throw LocalStoreException(_defaults,
 								  key,
 								  transactQuery.executedQuery().simplified(),
 								  transactQuery.lastError().text());
@@ -735,77 +1485,191 @@ void LocalStore::exec(QSqlQuery &query, const ObjectKey &key) const
 	}
 }
 
-function<void()> LocalStore::storeChangedImpl(const DatabaseRef &db, const ObjectKey &key, quint64 version, const QString &fileName, const QJsonObject &data, bool changed, bool existing)
+function<void()> LocalStore::saveDirect(const ObjectKey &key, const QJsonObject &data)
 {
-	auto tableDir = typeDirectory(key);
-	QScopedPointer<QFileDevice> device;
-	function<bool(QFileDevice*)> fileCommitFn;
+	beginWriteTransaction(key);
 
-	if(existing && !fileName.isNull()) {
-		auto file = new QSaveFile(filePath(tableDir, fileName));
-		device.reset(file);
-		if(!file->open(QIODevice::WriteOnly))
-			throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
-		fileCommitFn = [](QFileDevice *d){
-			return static_cast<QSaveFile*>(d)->commit();
-		};
-	} else {
-		auto newFileName = QStringLiteral("%1XXXXXX")
-						   .arg(QString::fromUtf8(QUuid::createUuid().toRfc4122().toHex()));
-		auto file = new QTemporaryFile(filePath(tableDir, newFileName));
-		device.reset(file);
-		if(!file->open())
-			throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
-		fileCommitFn = [](QFileDevice *d){
-			auto f = static_cast<QTemporaryFile*>(d);
-			f->close();
-			if(f->error() == QFile::NoError) {
-				f->setAutoRemove(false);
-				return true;
-			} else
-				return false;
-		};
+	try {
+		auto resFn = saveImpl(key, data);
+
+		//commit database changes
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+
+		checkCompaction();
+		return resFn;
+	} catch(...) {
+		_emitter->dropCached(key);
+		_database->rollback();
+		throw;
+	}
+}
+
+function<void()> LocalStore::saveGroup(const QList<WriteQueue::Request*> &group)
+{
+	QList<function<void()>> resFns;
+	resFns.reserve(group.size());
+	try {
+		beginWriteTransaction(group.first()->key);
+		_fileBackend->beginGroup();
+		_packBackend->beginGroup();
+
+		try {
+			for(auto request : group)
+				resFns.append(saveImpl(request->key, request->data));
+
+			//sync the written files once, right before the commit
+			_fileBackend->endGroup(true);
+			_packBackend->endGroup(true);
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, group.first()->key, _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			_fileBackend->endGroup(false);
+			_packBackend->endGroup(false);
+			for(auto request : group)
+				_emitter->dropCached(request->key);
+			_database->rollback();
+			throw;
+		}
+		checkCompaction();
+	} catch(QException &e) {
+		if(group.size() == 1)
+			throw;
+
+		//one broken dataset must not fail the others -> retry one by one, so only the broken ones report errors
+		logWarning() << "Failed to commit a group of" << group.size()
+					 << "datasets, saving them one by one. Error:" << e.what();
+		resFns.clear();
+		for(auto request : group) {
+			try {
+				resFns.append(saveDirect(request->key, request->data));
+			} catch(QException &error) {
+				request->error.reset(error.clone());
+			}
+		}
+	}
+
+	return [resFns]() {
+		for(const auto &resFn : resFns)
+			resFn();
+	};
+}
+
+function<void()> LocalStore::saveImpl(const ObjectKey &key, const QJsonObject &data, bool notify)
+{
+	//check if the file exists
+	QSqlQuery existQuery(_database);
+	existQuery.prepare(QStringLiteral("SELECT Version, File FROM DataIndex WHERE Type = ? AND Id = ?"));
+	existQuery.addBindValue(key.typeName);
+	existQuery.addBindValue(key.id);
+	exec(existQuery, key);
+
+	//create the file device to write to
+	quint64 version = 1ull;
+	bool existing = existQuery.first();
+	if(existing)
+		version = existQuery.value(0).toULongLong() + 1ull;
+
+	//perform store operation
+	return storeChangedImpl(_database,
+							key,
+							version,
+							existing ? existQuery.value(1).toString() : QString(),
+							data,
+							QByteArray(),
+							true,
+							existing,
+							notify);
+}
+
+function<void()> LocalStore::storeChangedImpl(const DatabaseRef &db, const ObjectKey &key, quint64 version, const QString &fileName, const QJsonObject &data, QByteArray checksum, bool changed, bool existing, bool notify)
+{
+	//reuse a known checksum, if it was created with the same algorithm
+	if(checksum.isNull() || SyncHelper::checksumAlgorithm(checksum) != _checksumAlgorithm) {
+		if(_deferredChecksums.contains(key.typeName))
+			checksum = QByteArray();
+		else
+			checksum = SyncHelper::jsonHash(data, _checksumAlgorithm);
 	}
 
-	//write the data & get the hash
-	device->write(QJsonDocument(data).toBinaryData());
-	if(device->error() != QFile::NoError)
-		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+	auto body = RecordCodec::encodeBody(data);
+	auto isInline = _inlineThreshold > 0 && body.size() <= _inlineThreshold;
+	auto storeData = encodeData(key, body);
+
+	//the old location is only passed to its own backend, all others must remove it
+	auto oldBackend = existing && !fileName.isNull() && fileName != inlineFileMarker ?
+						  backend(fileName) :
+						  nullptr;
+	StorageBackend::PendingWrite pending;
+	function<void()> obsoleteFn;
+	if(isInline)
+		pending.location = inlineFileMarker;
+	else
+		pending = _writeBackend->write(db, key, oldBackend == _writeBackend ? fileName : QString(), storeData);
+	if(oldBackend && (isInline || oldBackend != _writeBackend)) //was stored elsewhere before -> remove it after the commit
+		obsoleteFn = oldBackend->remove(db, key, fileName);
 
 	//save key in database
-	QFileInfo info(device->fileName());
 	if(existing) {
 		QSqlQuery updateQuery(db);
-		updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = ?, Checksum = ?, Changed = ? WHERE Type = ? AND Id = ?"));
+		updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = ?, Checksum = ?, Changed = ?, Data = ?, Format = ? WHERE Type = ? AND Id = ?"));
 		updateQuery.addBindValue(version);
-		updateQuery.addBindValue(tableDir.relativeFilePath(info.completeBaseName())); //still update file, in case it was set to NULL
-		updateQuery.addBindValue(SyncHelper::jsonHash(data));
+		updateQuery.addBindValue(pending.location); //still update file, in case it was set to NULL
+		updateQuery.addBindValue(checksum.isNull() ? QVariant{QVariant::ByteArray} : QVariant{checksum});
 		updateQuery.addBindValue(changed);
+		updateQuery.addBindValue(isInline ? QVariant{storeData} : QVariant{QVariant::ByteArray});
+		updateQuery.addBindValue(static_cast<int>(RecordCodec::FormatVersion));
 		updateQuery.addBindValue(key.typeName);
 		updateQuery.addBindValue(key.id);
 		exec(updateQuery, key);
 	} else {
 		QSqlQuery insertQuery(db);
-		insertQuery.prepare(QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Changed) VALUES(?, ?, ?, ?, ?, ?)"));
+		insertQuery.prepare(QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Changed, Data, Format) VALUES(?, ?, ?, ?, ?, ?, ?, ?)"));
 		insertQuery.addBindValue(key.typeName);
 		insertQuery.addBindValue(key.id);
 		insertQuery.addBindValue(version);
-		insertQuery.addBindValue(tableDir.relativeFilePath(info.completeBaseName()));
-		insertQuery.addBindValue(SyncHelper::jsonHash(data));
+		insertQuery.addBindValue(pending.location);
+		insertQuery.addBindValue(checksum.isNull() ? QVariant{QVariant::ByteArray} : QVariant{checksum});
 		insertQuery.addBindValue(changed);
+		insertQuery.addBindValue(isInline ? QVariant{storeData} : QVariant{QVariant::ByteArray});
+		insertQuery.addBindValue(static_cast<int>(RecordCodec::FormatVersion));
 		exec(insertQuery, key);
 	}
+	writeIndexes(db, key, data);
+	writeTextIndex(db, key, data);
+
+	//new keys advance the stored key epoch of the type (via trigger)
+	qint64 keyEpoch = 0;
+	if(!existing || fileName.isNull()) {
+		QSqlQuery epochQuery(db);
+		epochQuery.prepare(QStringLiteral("SELECT Epoch FROM KeyEpochs WHERE Type = ?"));
+		epochQuery.addBindValue(key.typeName);
+		exec(epochQuery, key);
+		if(epochQuery.first())
+			keyEpoch = epochQuery.value(0).toLongLong();
+	}
 
-	//complete the file-save (last before commit!)
-	if(!fileCommitFn(device.data()))
-		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
-
-	//update cache
-	_emitter->putCached(key, data, static_cast<int>(info.size()));
-
-	return [this, key, changed]() {
+	//complete the write (last before commit!)
+	if(pending.complete)
+		pending.complete();
+
+	//update cache. The filter must know the key before it is committed
+	_emitter->putCached(key, data, body.size());
+	_defaults.keyFilter()->insert(key);
+
+	auto writeFn = pending.afterCommit;
+	return [this, key, changed, notify, obsoleteFn, writeFn, keyEpoch]() {
+		//the filter knows the committed epoch now, so other connections can trust it
+		if(keyEpoch > 0)
+			_defaults.keyFilter()->insert(key, keyEpoch);
+		//remove the data of a dataset that was moved to a different place
+		if(obsoleteFn)
+			obsoleteFn();
+		if(writeFn)
+			writeFn();
 		//trigger change signals
-		_emitter->triggerChange(key, false, changed);
+		if(notify)
+			_emitter->triggerChange(key, false, changed);
 	};
 }
 
@@ -822,6 +1686,824 @@ void LocalStore::markUnchangedImpl(const DatabaseRef &db, const ObjectKey &key,
 	exec(completeQuery);
 }
 
+QHash<QByteArray, QStringList> LocalStore::loadIndexInfo(const QString &infoTable) const
+{
+	QSqlQuery infoQuery(_database);
+	infoQuery.prepare(QStringLiteral("SELECT Type, Property FROM %1 ORDER BY Type, Property").arg(infoTable));
+	exec(infoQuery);
+
+	QHash<QByteArray, QStringList> indexes;
+	while(infoQuery.next())
+		indexes[infoQuery.value(0).toByteArray()].append(infoQuery.value(1).toString());
+	return indexes;
+}
+
+QHash<QByteArray, QStringList> LocalStore::configuredIndexes(Defaults::PropertyKey key) const
+{
+	QHash<QByteArray, QStringList> configured;
+	auto config = _defaults.property(key).toHash();
+	for(auto it = config.constBegin(); it != config.constEnd(); it++) {
+		auto properties = it.value().toStringList();
+		properties.removeDuplicates();
+		properties.sort();
+		if(!properties.isEmpty())
+			configured.insert(it.key().toUtf8(), properties);
+	}
+	return configured;
+}
+
+void LocalStore::migrateDeviceUploads()
+{
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		if(_database->tables().contains(QStringLiteral("DeviceUploads"))) { //might have been migrated by another thread
+			QSqlQuery migrateQuery(_database);
+			migrateQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO DeviceCursors (Device, Type, Id, Pending) "
+												"SELECT DISTINCT Device, '', '', ( "
+												"	SELECT Count(*) FROM DataIndex "
+												"	WHERE NOT (Changed = 1 AND File IS NULL) "
+												") FROM DeviceUploads"));
+			exec(migrateQuery);
+
+			QSqlQuery dropQuery(_database);
+			dropQuery.prepare(QStringLiteral("DROP TABLE DeviceUploads"));
+			exec(dropQuery);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Replaced DeviceUploads table by device cursors";
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::initDatabase()
+{
+	if(!_database->tables().contains(QStringLiteral("DataIndex"))) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS DataIndex ("
+										   "	Type		TEXT NOT NULL,"
+										   "	Id			TEXT NOT NULL,"
+										   "	Version		INTEGER NOT NULL,"
+										   "	File		TEXT,"
+										   "	Checksum	BLOB,"
+										   "	Changed		INTEGER NOT NULL DEFAULT 1,"
+										   "	Data		BLOB,"
+										   "	ChangeSeq	INTEGER,"
+										   "	PRIMARY KEY(Type, Id)"
+										   ") WITHOUT ROWID;"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  createQuery.lastError().text());
+		}
+		logDebug() << "Created DataIndex table";
+	}
+
+	//migrate stores created before inline data was supported
+	if(!_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Data"))) {
+		QSqlQuery alterQuery(_database);
+		alterQuery.prepare(QStringLiteral("ALTER TABLE DataIndex ADD COLUMN Data BLOB"));
+		if(!alterQuery.exec() &&
+		   !_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Data"))) { //might have been added by another thread
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  alterQuery.executedQuery().simplified(),
+									  alterQuery.lastError().text());
+		}
+		logDebug() << "Added Data column to DataIndex table";
+	}
+
+	if(!_database->tables().contains(QStringLiteral("DeviceCursors"))) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS DeviceCursors ( "
+										   "	Device	TEXT NOT NULL, "
+										   "	Type	TEXT NOT NULL, "
+										   "	Id		TEXT NOT NULL, "
+										   "	Bound	INTEGER, "
+										   "	Pending	INTEGER NOT NULL DEFAULT 0, "
+										   "	PRIMARY KEY(Device) "
+										   ") WITHOUT ROWID;"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  createQuery.lastError().text());
+		}
+		logDebug() << "Created DeviceCursors table";
+	}
+
+	//migrate stores that listed every dataset per device: those devices simply start over
+	if(_database->tables().contains(QStringLiteral("DeviceUploads")))
+		migrateDeviceUploads();
+
+	if(!_database->tables().contains(QStringLiteral("PropertyIndex"))) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS PropertyIndex ( "
+										   "	Type		TEXT NOT NULL, "
+										   "	Property	TEXT NOT NULL, "
+										   "	Value, "
+										   "	Id			TEXT NOT NULL, "
+										   "	PRIMARY KEY(Type, Property, Id), "
+										   "	FOREIGN KEY(Type, Id) REFERENCES DataIndex ON DELETE CASCADE "
+										   ") WITHOUT ROWID;"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  createQuery.lastError().text());
+		}
+
+		QSqlQuery createValueIndexQuery(_database);
+		createValueIndexQuery.prepare(QStringLiteral("CREATE INDEX IF NOT EXISTS PropertyIndexValues ON PropertyIndex (Type, Property, Value)"));
+		if(!createValueIndexQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createValueIndexQuery.executedQuery().simplified(),
+									  createValueIndexQuery.lastError().text());
+		}
+
+		//needed for the cascading deletes from DataIndex
+		QSqlQuery createKeyIndexQuery(_database);
+		createKeyIndexQuery.prepare(QStringLiteral("CREATE INDEX IF NOT EXISTS PropertyIndexKeys ON PropertyIndex (Type, Id)"));
+		if(!createKeyIndexQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createKeyIndexQuery.executedQuery().simplified(),
+									  createKeyIndexQuery.lastError().text());
+		}
+		logDebug() << "Created PropertyIndex table";
+	}
+
+	if(!_database->tables().contains(QStringLiteral("PropertyIndexInfo"))) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS PropertyIndexInfo ( "
+										   "	Type		TEXT NOT NULL, "
+										   "	Property	TEXT NOT NULL, "
+										   "	PRIMARY KEY(Type, Property) "
+										   ") WITHOUT ROWID;"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  createQuery.lastError().text());
+		}
+		logDebug() << "Created PropertyIndexInfo table";
+	}
+
+	if(!_database->tables().contains(QStringLiteral("TextIndexInfo"))) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS TextIndexInfo ( "
+										   "	Type		TEXT NOT NULL, "
+										   "	Property	TEXT NOT NULL, "
+										   "	PRIMARY KEY(Type, Property) "
+										   ") WITHOUT ROWID;"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  createQuery.lastError().text());
+		}
+		logDebug() << "Created TextIndexInfo table";
+	}
+
+	if(!_database->tables().contains(QStringLiteral("AccessHints"))) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS AccessHints ( "
+										   "	Type		TEXT NOT NULL, "
+										   "	Id			TEXT NOT NULL, "
+										   "	LastAccess	INTEGER NOT NULL, "
+										   "	PRIMARY KEY(Type, Id), "
+										   "	FOREIGN KEY(Type, Id) REFERENCES DataIndex ON DELETE CASCADE "
+										   ") WITHOUT ROWID;"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  createQuery.lastError().text());
+		}
+
+		QSqlQuery createRecentIndexQuery(_database);
+		createRecentIndexQuery.prepare(QStringLiteral("CREATE INDEX IF NOT EXISTS AccessHintsRecent ON AccessHints (Type, LastAccess)"));
+		if(!createRecentIndexQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createRecentIndexQuery.executedQuery().simplified(),
+									  createRecentIndexQuery.lastError().text());
+		}
+		logDebug() << "Created AccessHints table";
+	}
+
+	initChangeSequence();
+	initDeviceCursors();
+	initStatistics();
+	initKeyEpochs();
+	initRecordFormat();
+}
+
+void LocalStore::initChangeSequence()
+{
+	if(_database->tables().contains(QStringLiteral("ChangeSequence")))
+		return;
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		QStringList statements;
+		//migrate stores created before changes were numbered
+		if(!_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("ChangeSeq")))
+			statements.append(QStringLiteral("ALTER TABLE DataIndex ADD COLUMN ChangeSeq INTEGER"));
+		statements.append({
+			QStringLiteral("CREATE TABLE IF NOT EXISTS ChangeSequence ( "
+						   "	Id		INTEGER NOT NULL CHECK(Id = 0), "
+						   "	Seq		INTEGER NOT NULL, "
+						   "	PRIMARY KEY(Id) "
+						   ");"),
+			QStringLiteral("INSERT OR IGNORE INTO ChangeSequence (Id, Seq) VALUES(0, 0)"),
+			//every local change gets the next number, which never decreases, even if the highest one is uploaded
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS ChangeSeqInsert AFTER INSERT ON DataIndex "
+						   "WHEN NEW.Changed = 1 "
+						   "BEGIN "
+						   "	UPDATE ChangeSequence SET Seq = Seq + 1; "
+						   "	UPDATE DataIndex SET ChangeSeq = (SELECT Seq FROM ChangeSequence) "
+						   "	WHERE Type = NEW.Type AND Id = NEW.Id; "
+						   "END"),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS ChangeSeqUpdate AFTER UPDATE OF Version, Changed ON DataIndex "
+						   "WHEN NEW.Changed = 1 "
+						   "BEGIN "
+						   "	UPDATE ChangeSequence SET Seq = Seq + 1; "
+						   "	UPDATE DataIndex SET ChangeSeq = (SELECT Seq FROM ChangeSequence) "
+						   "	WHERE Type = NEW.Type AND Id = NEW.Id; "
+						   "END"),
+			QStringLiteral("CREATE INDEX IF NOT EXISTS DataIndexChangeSeq ON DataIndex (ChangeSeq) WHERE Changed = 1"),
+			//number changes that already exist via the update trigger
+			QStringLiteral("UPDATE DataIndex SET Changed = 1 WHERE Changed = 1 AND ChangeSeq IS NULL")
+		});
+		for(const auto &statement : qAsConst(statements)) {
+			QSqlQuery sequenceQuery(_database);
+			sequenceQuery.prepare(statement);
+			exec(sequenceQuery);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Created ChangeSequence table";
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::initDeviceCursors()
+{
+	QSqlQuery triggerQuery(_database);
+	triggerQuery.prepare(QStringLiteral("SELECT 1 FROM sqlite_master WHERE type = 'trigger' AND name = 'DevicePendingUpdate'"));
+	exec(triggerQuery);
+	if(triggerQuery.first())
+		return;
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		//a dataset is pending for a device if it follows the cursor, was not deleted locally and not changed after the grant
+		const auto pending = QStringLiteral("(NOT (%1.Changed = 1 AND %1.File IS NULL) AND "
+											"(DeviceCursors.Bound IS NULL OR IFNULL(%1.ChangeSeq, 0) <= DeviceCursors.Bound))");
+		QStringList statements;
+		//migrate cursors created before they were counted
+		if(!_database->record(QStringLiteral("DeviceCursors")).contains(QStringLiteral("Pending"))) {
+			statements.append({
+				QStringLiteral("ALTER TABLE DeviceCursors ADD COLUMN Bound INTEGER"),
+				QStringLiteral("ALTER TABLE DeviceCursors ADD COLUMN Pending INTEGER NOT NULL DEFAULT 0"),
+				QStringLiteral("UPDATE DeviceCursors SET Pending = ( "
+							   "	SELECT Count(*) FROM DataIndex "
+							   "	WHERE (DataIndex.Type, DataIndex.Id) > (DeviceCursors.Type, DeviceCursors.Id) AND %1 "
+							   ")").arg(pending.arg(QStringLiteral("DataIndex")))
+			});
+		}
+		//the counters follow every change of a dataset, the cursors only move over what was uploaded
+		statements.append({
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS DevicePendingInsert AFTER INSERT ON DataIndex "
+						   "BEGIN "
+						   "	UPDATE DeviceCursors SET Pending = Pending + %1 "
+						   "	WHERE (NEW.Type, NEW.Id) > (Type, Id); "
+						   "END").arg(pending.arg(QStringLiteral("NEW"))),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS DevicePendingUpdate AFTER UPDATE OF File, Changed, ChangeSeq ON DataIndex "
+						   "BEGIN "
+						   "	UPDATE DeviceCursors SET Pending = Pending + %1 - %2 "
+						   "	WHERE (NEW.Type, NEW.Id) > (Type, Id); "
+						   "END").arg(pending.arg(QStringLiteral("NEW")), pending.arg(QStringLiteral("OLD"))),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS DevicePendingDelete AFTER DELETE ON DataIndex "
+						   "BEGIN "
+						   "	UPDATE DeviceCursors SET Pending = Pending - %1 "
+						   "	WHERE (OLD.Type, OLD.Id) > (Type, Id); "
+						   "END").arg(pending.arg(QStringLiteral("OLD")))
+		});
+		for(const auto &statement : qAsConst(statements)) {
+			QSqlQuery cursorQuery(_database);
+			cursorQuery.prepare(statement);
+			exec(cursorQuery);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Created device cursor counters";
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::initStatistics()
+{
+	if(_database->tables().contains(QStringLiteral("TypeStats")))
+		return;
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		//the counters are kept in step with DataIndex by triggers, within the same transaction
+		const QStringList statements {
+			QStringLiteral("CREATE TABLE IF NOT EXISTS TypeStats ( "
+						   "	Type	TEXT NOT NULL, "
+						   "	Objects	INTEGER NOT NULL DEFAULT 0, "
+						   "	Changes	INTEGER NOT NULL DEFAULT 0, "
+						   "	PRIMARY KEY(Type) "
+						   ") WITHOUT ROWID;"),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS TypeStatsDataInsert AFTER INSERT ON DataIndex "
+						   "BEGIN "
+						   "	INSERT OR IGNORE INTO TypeStats (Type) VALUES(NEW.Type); "
+						   "	UPDATE TypeStats "
+						   "	SET Objects = Objects + (NEW.File IS NOT NULL), Changes = Changes + (NEW.Changed = 1) "
+						   "	WHERE Type = NEW.Type; "
+						   "END"),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS TypeStatsDataUpdate AFTER UPDATE OF File, Changed ON DataIndex "
+						   "BEGIN "
+						   "	UPDATE TypeStats "
+						   "	SET Objects = Objects + (NEW.File IS NOT NULL) - (OLD.File IS NOT NULL), "
+						   "		Changes = Changes + (NEW.Changed = 1) - (OLD.Changed = 1) "
+						   "	WHERE Type = NEW.Type; "
+						   "END"),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS TypeStatsDataDelete AFTER DELETE ON DataIndex "
+						   "BEGIN "
+						   "	UPDATE TypeStats "
+						   "	SET Objects = Objects - (OLD.File IS NOT NULL), Changes = Changes - (OLD.Changed = 1) "
+						   "	WHERE Type = OLD.Type; "
+						   "END"),
+			//partial indexes for the change scans and the stored datasets of a type
+			QStringLiteral("CREATE INDEX IF NOT EXISTS DataIndexChanges ON DataIndex (Type, Id) WHERE Changed = 1"),
+			QStringLiteral("CREATE INDEX IF NOT EXISTS DataIndexStored ON DataIndex (Type, Id) WHERE File IS NOT NULL"),
+			//existing stores: count everything once
+			QStringLiteral("DELETE FROM TypeStats"),
+			QStringLiteral("INSERT INTO TypeStats (Type, Objects, Changes) "
+						   "SELECT Type, Count(File), Sum(Changed = 1) FROM DataIndex "
+						   "GROUP BY Type")
+		};
+		for(const auto &statement : statements) {
+			QSqlQuery statsQuery(_database);
+			statsQuery.prepare(statement);
+			exec(statsQuery);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Created TypeStats table";
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::initKeyEpochs()
+{
+	if(_database->tables().contains(QStringLiteral("KeyEpochs")))
+		return;
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		//counts the keys that were added to a type, by any process. Key filters are only trusted for the epoch they were built for
+		const QStringList statements {
+			QStringLiteral("CREATE TABLE IF NOT EXISTS KeyEpochs ( "
+						   "	Type	TEXT NOT NULL, "
+						   "	Epoch	INTEGER NOT NULL DEFAULT 0, "
+						   "	PRIMARY KEY(Type) "
+						   ") WITHOUT ROWID;"),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS KeyEpochInsert AFTER INSERT ON DataIndex "
+						   "WHEN NEW.File IS NOT NULL "
+						   "BEGIN "
+						   "	INSERT OR IGNORE INTO KeyEpochs (Type) VALUES(NEW.Type); "
+						   "	UPDATE KeyEpochs SET Epoch = Epoch + 1 WHERE Type = NEW.Type; "
+						   "END"),
+			QStringLiteral("CREATE TRIGGER IF NOT EXISTS KeyEpochUpdate AFTER UPDATE OF File ON DataIndex "
+						   "WHEN OLD.File IS NULL AND NEW.File IS NOT NULL "
+						   "BEGIN "
+						   "	INSERT OR IGNORE INTO KeyEpochs (Type) VALUES(NEW.Type); "
+						   "	UPDATE KeyEpochs SET Epoch = Epoch + 1 WHERE Type = NEW.Type; "
+						   "END")
+		};
+		for(const auto &statement : statements) {
+			QSqlQuery epochQuery(_database);
+			epochQuery.prepare(statement);
+			exec(epochQuery);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Created KeyEpochs table";
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::initRecordFormat()
+{
+	if(_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Format")))
+		return;
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		QStringList statements;
+		//might have been added by another thread. NULL marks datasets written as binary json by older versions
+		if(!_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Format")))
+			statements.append(QStringLiteral("ALTER TABLE DataIndex ADD COLUMN Format INTEGER"));
+		statements.append(QStringLiteral("CREATE INDEX IF NOT EXISTS DataIndexLegacyFormat ON DataIndex (Type, Id) "
+										 "WHERE File IS NOT NULL AND Format IS NULL"));
+		for(const auto &statement : qAsConst(statements)) {
+			QSqlQuery formatQuery(_database);
+			formatQuery.prepare(statement);
+			exec(formatQuery);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Added Format column to DataIndex table";
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::detectLegacyRecords()
+{
+	{
+		QMutexLocker _(&detectMutex);
+		auto storePath = _defaults.storageDir().absolutePath();
+		if(detectedStores.contains(storePath))
+			return;
+		detectedStores.insert(storePath);
+	}
+
+	QSqlQuery detectQuery(_database);
+	detectQuery.prepare(QStringLiteral("SELECT 1 FROM DataIndex WHERE File IS NOT NULL AND Format IS NULL LIMIT 1"));
+	if(!detectQuery.exec()) {
+		logWarning() << "Failed to check for datasets stored as binary json with error:"
+					 << detectQuery.lastError().text();
+	} else if(detectQuery.first()) {
+		logDebug() << "Found datasets stored as binary json - scheduling conversion";
+		FormatConversionTask::schedule(_defaults);
+	}
+}
+
+void LocalStore::initIndexes()
+{
+	_indexes = loadIndexInfo(QStringLiteral("PropertyIndexInfo"));
+	_textIndexes = loadIndexInfo(QStringLiteral("TextIndexInfo"));
+
+	//only the primary setup knows the configured indexes, passive ones use whatever exists
+	if(!_emitter->isPrimary())
+		return;
+
+	auto configured = configuredIndexes(Defaults::PropertyIndexes);
+	if(configured != _indexes)
+		rebuildIndexes(configured);
+
+	auto configuredText = configuredIndexes(Defaults::FullTextIndexes);
+	if(configuredText != _textIndexes)
+		rebuildTextIndexes(configuredText);
+}
+
+void LocalStore::rebuildIndexes(const QHash<QByteArray, QStringList> &configured)
+{
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		//reload within the transaction, another store might have updated them already
+		auto current = loadIndexInfo(QStringLiteral("PropertyIndexInfo"));
+
+		auto types = configured.keys();
+		for(const auto &type : current.keys()) {
+			if(!types.contains(type))
+				types.append(type);
+		}
+
+		for(const auto &type : qAsConst(types)) {
+			const auto oldProperties = current.value(type);
+			const auto newProperties = configured.value(type);
+
+			//drop indexes that are not configured anymore
+			for(const auto &property : oldProperties) {
+				if(newProperties.contains(property))
+					continue;
+
+				QSqlQuery dropQuery(_database);
+				dropQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ? AND Property = ?"));
+				dropQuery.addBindValue(type);
+				dropQuery.addBindValue(property);
+				exec(dropQuery, type);
+
+				QSqlQuery dropInfoQuery(_database);
+				dropInfoQuery.prepare(QStringLiteral("DELETE FROM PropertyIndexInfo WHERE Type = ? AND Property = ?"));
+				dropInfoQuery.addBindValue(type);
+				dropInfoQuery.addBindValue(property);
+				exec(dropInfoQuery, type);
+				logDebug() << "Dropped property index" << property << "of type" << type;
+			}
+
+			//create the new indexes and fill them with the existing data
+			QStringList addedProperties;
+			for(const auto &property : newProperties) {
+				if(oldProperties.contains(property))
+					continue;
+				addedProperties.append(property);
+
+				QSqlQuery addInfoQuery(_database);
+				addInfoQuery.prepare(QStringLiteral("INSERT INTO PropertyIndexInfo (Type, Property) VALUES(?, ?)"));
+				addInfoQuery.addBindValue(type);
+				addInfoQuery.addBindValue(property);
+				exec(addInfoQuery, type);
+			}
+
+			if(!addedProperties.isEmpty()) {
+				QSqlQuery loadQuery(_database);
+				loadQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+				loadQuery.addBindValue(type);
+				exec(loadQuery, type);
+
+				while(loadQuery.next()) {
+					ObjectKey key {type, loadQuery.value(0).toString()};
+					auto json = readJson(key, loadQuery.value(1).toString(), loadQuery.value(2).toByteArray(), nullptr);
+					insertIndexes(_database, key, json, addedProperties);
+				}
+				logDebug() << "Created property indexes" << addedProperties << "of type" << type;
+			}
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+
+		_indexes = configured;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::writeIndexes(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data)
+{
+	if(!_indexes.contains(key.typeName))
+		return;
+
+	removeIndexes(db, key);
+	insertIndexes(db, key, data, _indexes.value(key.typeName));
+}
+
+void LocalStore::insertIndexes(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data, const QStringList &properties)
+{
+	for(const auto &property : properties) {
+		auto value = indexValue(data.value(property));
+		if(!value.isValid())
+			continue;
+
+		QSqlQuery insertQuery(db);
+		insertQuery.prepare(QStringLiteral("INSERT INTO PropertyIndex (Type, Property, Value, Id) VALUES(?, ?, ?, ?)"));
+		insertQuery.addBindValue(key.typeName);
+		insertQuery.addBindValue(property);
+		insertQuery.addBindValue(value);
+		insertQuery.addBindValue(key.id);
+		exec(insertQuery, key);
+	}
+}
+
+void LocalStore::removeIndexes(const DatabaseRef &db, const ObjectKey &key)
+{
+	if(!_indexes.contains(key.typeName))
+		return;
+
+	QSqlQuery removeQuery(db);
+	removeQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ? AND Id = ?"));
+	removeQuery.addBindValue(key.typeName);
+	removeQuery.addBindValue(key.id);
+	exec(removeQuery, key);
+}
+
+void LocalStore::rebuildTextIndexes(const QHash<QByteArray, QStringList> &configured)
+{
+	beginWriteTransaction(ObjectKey{"any"}, true);
+
+	try {
+		//the fts tables are only created once needed, as they require the fts5 extension
+		if(!configured.isEmpty()) {
+			QSqlQuery createQuery(_database);
+			createQuery.prepare(QStringLiteral("CREATE VIRTUAL TABLE IF NOT EXISTS TextIndex USING fts5(Content)"));
+			exec(createQuery);
+
+			QSqlQuery createKeysQuery(_database);
+			createKeysQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS TextIndexKeys ( "
+												   "	DocId	INTEGER PRIMARY KEY, "
+												   "	Type	TEXT NOT NULL, "
+												   "	Id		TEXT NOT NULL, "
+												   "	UNIQUE(Type, Id) "
+												   ");"));
+			exec(createKeysQuery);
+		}
+
+		//reload within the transaction, another store might have updated them already
+		auto current = loadIndexInfo(QStringLiteral("TextIndexInfo"));
+		_textIndexes = configured;
+
+		auto types = configured.keys();
+		for(const auto &type : current.keys()) {
+			if(!types.contains(type))
+				types.append(type);
+		}
+
+		for(const auto &type : qAsConst(types)) {
+			const auto newProperties = configured.value(type);
+			if(current.value(type) == newProperties)
+				continue;
+
+			//the properties are combined to one document, so the whole type has to be reindexed
+			if(current.contains(type))
+				clearTextIndex(type);
+
+			QSqlQuery dropInfoQuery(_database);
+			dropInfoQuery.prepare(QStringLiteral("DELETE FROM TextIndexInfo WHERE Type = ?"));
+			dropInfoQuery.addBindValue(type);
+			exec(dropInfoQuery, type);
+
+			if(newProperties.isEmpty()) {
+				logDebug() << "Dropped full text index of type" << type;
+				continue;
+			}
+
+			for(const auto &property : newProperties) {
+				QSqlQuery addInfoQuery(_database);
+				addInfoQuery.prepare(QStringLiteral("INSERT INTO TextIndexInfo (Type, Property) VALUES(?, ?)"));
+				addInfoQuery.addBindValue(type);
+				addInfoQuery.addBindValue(property);
+				exec(addInfoQuery, type);
+			}
+
+			QSqlQuery loadQuery(_database);
+			loadQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+			loadQuery.addBindValue(type);
+			exec(loadQuery, type);
+
+			while(loadQuery.next()) {
+				ObjectKey key {type, loadQuery.value(0).toString()};
+				auto json = readJson(key, loadQuery.value(1).toString(), loadQuery.value(2).toByteArray(), nullptr);
+				writeTextIndex(_database, key, json);
+			}
+			logDebug() << "Created full text index of type" << type << "for the properties" << newProperties;
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		_textIndexes = loadIndexInfo(QStringLiteral("TextIndexInfo"));
+		throw;
+	}
+}
+
+void LocalStore::writeTextIndex(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data)
+{
+	if(!_textIndexes.contains(key.typeName))
+		return;
+
+	removeTextIndex(db, key);
+
+	QStringList texts;
+	for(const auto &property : _textIndexes.value(key.typeName)) {
+		auto value = data.value(property);
+		if(value.isString())
+			texts.append(value.toString());
+	}
+	if(texts.isEmpty())
+		return;
+
+	QSqlQuery insertKeyQuery(db);
+	insertKeyQuery.prepare(QStringLiteral("INSERT INTO TextIndexKeys (Type, Id) VALUES(?, ?)"));
+	insertKeyQuery.addBindValue(key.typeName);
+	insertKeyQuery.addBindValue(key.id);
+	exec(insertKeyQuery, key);
+
+	QSqlQuery insertQuery(db);
+	insertQuery.prepare(QStringLiteral("INSERT INTO TextIndex (rowid, Content) VALUES(?, ?)"));
+	insertQuery.addBindValue(insertKeyQuery.lastInsertId());
+	insertQuery.addBindValue(texts.join(QLatin1Char('\n')));
+	exec(insertQuery, key);
+}
+
+void LocalStore::removeTextIndex(const DatabaseRef &db, const ObjectKey &key)
+{
+	if(!_textIndexes.contains(key.typeName))
+		return;
+
+	QSqlQuery removeQuery(db);
+	removeQuery.prepare(QStringLiteral("DELETE FROM TextIndex WHERE rowid IN (SELECT DocId FROM TextIndexKeys WHERE Type = ? AND Id = ?)"));
+	removeQuery.addBindValue(key.typeName);
+	removeQuery.addBindValue(key.id);
+	exec(removeQuery, key);
+
+	QSqlQuery removeKeyQuery(db);
+	removeKeyQuery.prepare(QStringLiteral("DELETE FROM TextIndexKeys WHERE Type = ? AND Id = ?"));
+	removeKeyQuery.addBindValue(key.typeName);
+	removeKeyQuery.addBindValue(key.id);
+	exec(removeKeyQuery, key);
+}
+
+void LocalStore::clearTextIndex(const QByteArray &typeName)
+{
+	QSqlQuery clearQuery(_database);
+	clearQuery.prepare(QStringLiteral("DELETE FROM TextIndex WHERE rowid IN (SELECT DocId FROM TextIndexKeys WHERE Type = ?)"));
+	clearQuery.addBindValue(typeName);
+	exec(clearQuery, typeName);
+
+	QSqlQuery clearKeysQuery(_database);
+	clearKeysQuery.prepare(QStringLiteral("DELETE FROM TextIndexKeys WHERE Type = ?"));
+	clearKeysQuery.addBindValue(typeName);
+	exec(clearKeysQuery, typeName);
+}
+
+QList<QJsonObject> LocalStore::findText(const QByteArray &typeName, const QString &query) const
+{
+	if(!_textIndexes.contains(typeName)) {
+		throw InvalidDataException(_defaults,
+								   typeName,
+								   QStringLiteral("Type has no full text index. Use Setup::addFullTextIndex to create one"));
+	}
+
+	beginReadTransaction(typeName);
+
+	try {
+		QSqlQuery findQuery(_database);
+		findQuery.prepare(QStringLiteral("SELECT DataIndex.Id, DataIndex.File, DataIndex.Data "
+										 "FROM TextIndex "
+										 "INNER JOIN TextIndexKeys ON TextIndexKeys.DocId = TextIndex.rowid "
+										 "INNER JOIN DataIndex "
+										 "ON (TextIndexKeys.Type = DataIndex.Type AND TextIndexKeys.Id = DataIndex.Id) "
+										 "WHERE TextIndex MATCH ? AND TextIndexKeys.Type = ? AND DataIndex.File IS NOT NULL "
+										 "ORDER BY TextIndex.rank"));
+		findQuery.addBindValue(query);
+		findQuery.addBindValue(typeName);
+		exec(findQuery, typeName);
+
+		QList<ObjectKey> keys;
+		QList<QJsonObject> array;
+		QList<int> sizes;
+		while(findQuery.next()) {
+			int size;
+			ObjectKey key {typeName, findQuery.value(0).toString()};
+			auto json = readJson(key, findQuery.value(1).toString(), findQuery.value(2).toByteArray(), &size);
+			keys.append(key);
+			array.append(json);
+			sizes.append(size);
+		}
+
+		_emitter->putCached(keys, array, sizes);
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+
+		return array;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+QVariant LocalStore::indexValue(const QJsonValue &value)
+{
+	//only scalar values can be indexed
+	switch(value.type()) {
+	case QJsonValue::Bool: //stored as real as well, to be comparable with numbers
+		return value.toBool() ? 1.0 : 0.0;
+	case QJsonValue::Double:
+		return value.toDouble();
+	case QJsonValue::String:
+		return value.toString();
+	default:
+		return QVariant{};
+	}
+}
+
 // ------------- SyncScope -------------
 
 LocalStore::SyncScope::SyncScope(const Defaults &defaults, const ObjectKey &key, LocalStore *owner) :
@@ -854,3 +2536,165 @@ LocalStore::SyncScope::Private::Private(const Defaults &defaults, ObjectKey key,
 	key{std::move(key)},
 	database{defaults.aquireDatabase(owner)}
 {}
+
+
+
+CompactionTask::CompactionTask(Defaults defaults) :
+	StoreTask{std::move(defaults)}
+{}
+
+void CompactionTask::execute()
+{
+	store().compactStorage();
+}
+
+void CompactionTask::failed(const QException &e)
+{
+	logWarning() << "Failed to compact the storage with error:" << e.what();
+}
+
+
+
+WriteFlushTask::WriteFlushTask(Defaults defaults) :
+	StoreTask{std::move(defaults)}
+{}
+
+void WriteFlushTask::execute()
+{
+	store().flushDue();
+}
+
+void WriteFlushTask::failed(const QException &e)
+{
+	logWarning() << "Failed to write coalesced datasets with error:" << e.what();
+	_defaults.writeBuffer()->retryDue();
+}
+
+
+
+TrashSweepTask::TrashSweepTask(Defaults defaults) :
+	StoreTask{std::move(defaults)}
+{}
+
+void TrashSweepTask::execute()
+{
+	auto trashDir = StorageBackend::trashDirectory(_defaults);
+	if(!trashDir.exists())
+		return;
+
+	//remove a limited number of files per run, then give other tasks a chance
+	auto budget = SweepBatchSize;
+	auto removed = 0;
+	for(const auto &entry : trashDir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System)) {
+		QDir entryDir{trashDir.absoluteFilePath(entry)};
+		QDirIterator iterator{entryDir.absolutePath(), QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories};
+		while(budget > 0 && iterator.hasNext()) {
+			auto file = iterator.next();
+			if(QFile::remove(file))
+				removed++;
+			else
+				logWarning() << "Failed to remove trashed file" << file;
+			budget--;
+		}
+		if(iterator.hasNext()) {
+			_more = true;
+			break;
+		}
+
+		//only empty directories are left
+		if(!entryDir.removeRecursively())
+			logWarning() << "Failed to remove trashed directory" << entryDir.absolutePath();
+	}
+
+	if(!_more)
+		QDir{}.rmdir(trashDir.absolutePath());
+	else if(removed == 0) {
+		logWarning() << "Stopped sweeping the trash, no files could be removed";
+		_more = false;
+	}
+}
+
+void TrashSweepTask::failed(const QException &e)
+{
+	logWarning() << "Failed to sweep the trash with error:" << e.what();
+}
+
+void TrashSweepTask::finished()
+{
+	if(_more)
+		schedule(_defaults);
+}
+
+
+
+AccessHintTask::AccessHintTask(Defaults defaults) :
+	StoreTask{std::move(defaults)}
+{}
+
+void AccessHintTask::execute()
+{
+	store().flushAccessHints();
+}
+
+void AccessHintTask::failed(const QException &e)
+{
+	logWarning() << "Failed to write access hints with error:" << e.what();
+}
+
+
+
+FormatConversionTask::FormatConversionTask(Defaults defaults) :
+	StoreTask{std::move(defaults)}
+{}
+
+void FormatConversionTask::execute()
+{
+	_more = store().convertLegacyRecords(ConversionBatchSize);
+}
+
+void FormatConversionTask::failed(const QException &e)
+{
+	logWarning() << "Failed to convert datasets to the record format with error:" << e.what();
+}
+
+void FormatConversionTask::finished()
+{
+	//one batch per run, so the conversion never blocks other writers for long
+	if(_more)
+		schedule(_defaults);
+}
+
+
+
+void PreloadTask::schedule(const Defaults &defaults)
+{
+	if(defaults.property(Defaults::PreloadedTypes).toHash().isEmpty() ||
+	   defaults.property(Defaults::CacheSize).toInt() <= 0)
+		return;
+	StoreTask::schedule(defaults);
+}
+
+PreloadTask::PreloadTask(Defaults defaults) :
+	StoreTask{std::move(defaults)}
+{}
+
+void PreloadTask::execute()
+{
+	auto &localStore = store();
+	auto policies = _defaults.property(Defaults::PreloadedTypes).toHash();
+	for(auto it = policies.constBegin(); it != policies.constEnd(); it++) {
+		//a failing type does not prevent the others from being preloaded
+		try {
+			auto loaded = localStore.preload(it.key().toUtf8(), it.value().toInt());
+			logDebug() << "Preloaded" << loaded << "datasets of type" << it.key();
+		} catch(QException &e) {
+			logWarning() << "Failed to preload datasets of type" << it.key()
+						 << "with error:" << e.what();
+		}
+	}
+}
+
+void PreloadTask::failed(const QException &e)
+{
+	logWarning() << "Failed to preload datasets with error:" << e.what();
+}
@@ -5,9 +5,14 @@
 #include <tuple>
 
 #include <QtCore/QObject>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QThreadPool>
 #include <QtCore/QPointer>
 #include <QtCore/QJsonObject>
 #include <QtCore/QUuid>
+#include <QtCore/QRunnable>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
 
 #include <QtSql/QSqlDatabase>
 
@@ -17,9 +22,15 @@
 #include "logger.h"
 #include "exception.h"
 #include "datastore.h"
+#include "writebuffer_p.h"
+#include "writequeue_p.h"
 
 namespace QtDataSync {
 
+class StorageBackend;
+class FileStorageBackend;
+class PackStorageBackend;
+
 class Q_DATASYNC_EXPORT LocalStore : public QObject
 {
 	Q_OBJECT
@@ -63,20 +74,39 @@ public:
 	quint64 count(const QByteArray &typeName) const;
 	QStringList keys(const QByteArray &typeName) const;
 	QList<QJsonObject> loadAll(const QByteArray &typeName) const;
+	void iterate(const QByteArray &typeName,
+				 int pageSize,
+				 bool useCache,
+				 const std::function<bool(QString, QJsonObject)> &visitor) const; //(key, data)
 
-	QJsonObject load(const ObjectKey &key) const;
+	QJsonObject load(const ObjectKey &key, quint64 *generation = nullptr) const; //generation of the cached data, 0 if not cached
+	bool tryLoad(const ObjectKey &key, QJsonObject &data, quint64 *generation = nullptr) const;
+	bool contains(const ObjectKey &key) const;
+	bool loadTyped(const ObjectKey &key, int metaTypeId, QVariant &value) const;
+	void cacheTyped(const ObjectKey &key, quint64 generation, int metaTypeId, const QVariant &value) const;
 	void save(const ObjectKey &key, const QJsonObject &data);
+	void saveBatch(const QByteArray &typeName, const QList<QPair<QString, QJsonObject>> &data);
 	bool remove(const ObjectKey &key);
 
 	QList<QJsonObject> find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode) const;
+	QList<QJsonObject> query(const QByteArray &typeName, const QString &property, DataStore::QueryOperator op, const QVariant &value) const;
 	void clear(const QByteArray &typeName);
 	void reset(bool keepData);
+	void compactStorage();
+	void flush();
+	void flushDue();
+	//returns the number of datasets read into the cache. 0 preloads all datasets of the type
+	int preload(const QByteArray &typeName, int recentCount) const;
+	void flushAccessHints();
+	//rewrites datasets stored as binary json in the record format. Returns true if there might be more
+	bool convertLegacyRecords(int limit);
 
 	// change access
 	quint32 changeCount() const;
 	void loadChanges(int limit, const std::function<bool(ObjectKey, quint64, QString, QUuid)> &visitor) const; //(key, version, file, device)
+	void loadChanges(int limit, quint64 &changeCursor, const std::function<bool(ObjectKey, quint64, QString, QUuid)> &visitor) const; //(key, version, file, device)
 	void markUnchanged(const ObjectKey &key, quint64 version, bool isDelete);
-	void removeDeviceChange(const ObjectKey &key, QUuid deviceId);
+	void completeDeviceChanges(const ObjectKey &lastKey, QUuid deviceId); //everything up to lastKey was uploaded to the device
 
 	// sync access
 	SyncScope startSync(const ObjectKey &key) const;
@@ -90,7 +120,8 @@ public:
 					  const QString &filePath,
 					  const QJsonObject &data,
 					  bool changed,
-					  ChangeType localState);
+					  ChangeType localState,
+					  const QByteArray &checksum = {}); //checksum of data, if already known
 	void storeDeleted(SyncScope &scope,
 					  quint64 version,
 					  bool changed,
@@ -107,32 +138,268 @@ Q_SIGNALS:
 	void dataResetted();
 
 private:
+	template <typename TTask>
+	friend class StoreTask;
+
+	enum InitMode {
+		FullInit,
+		TaskInit //skips the database setup and maintenance checks
+	};
+
+	static const QString inlineFileMarker;
+	static const QByteArray compressionMagic;
+	static const int PreloadPageSize;
+	static QMutex detectMutex;
+	static QSet<QString> detectedStores;
+
 	Defaults _defaults;
 	Logger *_logger;
 	EmitterAdapter *_emitter;
 	DatabaseRef _database;
+	int _inlineThreshold;
+	int _compressionLevel;
+	int _compressionThreshold;
+	Setup::ChecksumAlgorithm _checksumAlgorithm;
+	Setup::Durability _durability;
+	QSet<QByteArray> _deferredChecksums;
+	WriteBuffer *_writeBuffer;
+	int _coalescingWindow;
+	QHash<QByteArray, int> _coalescedTypes;
+	QHash<QByteArray, QStringList> _indexes;
+	QHash<QByteArray, QStringList> _textIndexes;
+	QScopedPointer<FileStorageBackend> _fileBackend;
+	QScopedPointer<PackStorageBackend> _packBackend;
+	StorageBackend *_writeBackend;
+	//data version of the connection and generation of the filter, for every type whose filter epoch was confirmed
+	mutable QHash<QByteArray, QPair<qint64, quint64>> _confirmedFilters;
+
+	LocalStore(Defaults defaults, InitMode mode, QObject *parent = nullptr);
+
+	QHash<QByteArray, QStringList> loadIndexInfo(const QString &infoTable) const;
+	QHash<QByteArray, QStringList> configuredIndexes(Defaults::PropertyKey key) const;
+	void migrateDeviceUploads();
+	void initDatabase();
+	void initChangeSequence();
+	void initDeviceCursors();
+	void initStatistics();
+	void initKeyEpochs();
+	void initRecordFormat();
+	void detectLegacyRecords();
+	void initIndexes();
+	void rebuildIndexes(const QHash<QByteArray, QStringList> &configured);
+	void rebuildTextIndexes(const QHash<QByteArray, QStringList> &configured);
+	void writeIndexes(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data);
+	void insertIndexes(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data, const QStringList &properties);
+	void removeIndexes(const DatabaseRef &db, const ObjectKey &key);
+	static QVariant indexValue(const QJsonValue &value);
+	void writeTextIndex(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data);
+	void removeTextIndex(const DatabaseRef &db, const ObjectKey &key);
+	void clearTextIndex(const QByteArray &typeName);
+	QList<QJsonObject> findText(const QByteArray &typeName, const QString &query) const;
+
+	QJsonObject readJson(const ObjectKey &key, const QString &fileName, const QByteArray &data, int *costs) const;
+	QJsonObject decodeJson(const ObjectKey &key, const QString &context, const QByteArray &data, int *costs) const;
+	QByteArray encodeData(const ObjectKey &key, const QByteArray &body) const;
+
+	StorageBackend *backend(const QString &location) const;
+	void checkCompaction() const;
 
-	QDir typeDirectory(const ObjectKey &key) const;
-	QString filePath(const QDir &typeDir, const QString &baseName) const;
-	QString filePath(const ObjectKey &key, const QString &baseName) const;
+	void flushType(const QByteArray &typeName) const;
+	void flushKey(const ObjectKey &key) const;
+	void writeBuffered(const std::function<QList<WriteBuffer::Entry>()> &fetchEntries);
+	bool mayContain(const ObjectKey &key) const;
+	void recordAccess(const ObjectKey &key) const;
 
 	void beginReadTransaction(const ObjectKey &key = ObjectKey{"any"}) const;
-	void beginWriteTransaction(const ObjectKey &key = ObjectKey{"any"}, bool exclusive = false);
+	void beginWriteTransaction(const ObjectKey &key = ObjectKey{"any"}, bool exclusive = false) const;
 	void exec(QSqlQuery &query, const ObjectKey &key = ObjectKey{"any"}) const;
 
+	Q_REQUIRED_RESULT std::function<void()> saveDirect(const ObjectKey &key, const QJsonObject &data);
+	Q_REQUIRED_RESULT std::function<void()> saveGroup(const QList<WriteQueue::Request*> &group);
+	std::function<void()> saveImpl(const ObjectKey &key, const QJsonObject &data, bool notify = true);
+
 	Q_REQUIRED_RESULT std::function<void ()> storeChangedImpl(const DatabaseRef &db,
 																 const ObjectKey &key,
 																 quint64 version,
 																 const QString &filePath,
 																 const QJsonObject &data,
+																 QByteArray checksum,
 																 bool changed,
-																 bool existing);
+																 bool existing,
+																 bool notify = true);
 	void markUnchangedImpl(const DatabaseRef &db,
 						   const ObjectKey &key,
 						   quint64 version,
 						   bool isDelete);
 };
 
+//no export needed
+//background work of a setup, run on its async pool. Only one task of a kind is pending per setup,
+//further requests are handled by it. TTask implements execute() and failed(const QException &)
+template <typename TTask>
+class StoreTask : public QRunnable
+{
+public:
+	static void schedule(const Defaults &defaults);
+
+	void run() override;
+
+protected:
+	Defaults _defaults;
+	QScopedPointer<Logger> _logger;
+
+	StoreTask(Defaults defaults);
+
+	//created on first use, skipping the database setup already done by the store that scheduled the task
+	LocalStore &store();
+	//called after the store was destroyed
+	void finished() {}
+
+private:
+	static QMutex pendingMutex;
+	static QSet<QString> pendingSetups;
+
+	QScopedPointer<LocalStore> _store;
+};
+
+//no export needed
+class CompactionTask : public StoreTask<CompactionTask>
+{
+	friend class StoreTask<CompactionTask>;
+
+	CompactionTask(Defaults defaults);
+
+	void execute();
+	void failed(const QException &e);
+};
+
+//no export needed
+class WriteFlushTask : public StoreTask<WriteFlushTask>
+{
+	friend class StoreTask<WriteFlushTask>;
+
+	WriteFlushTask(Defaults defaults);
+
+	void execute();
+	void failed(const QException &e);
+};
+
+//no export needed
+class TrashSweepTask : public StoreTask<TrashSweepTask>
+{
+	friend class StoreTask<TrashSweepTask>;
+
+public:
+	static const int SweepBatchSize;
+
+private:
+	bool _more = false;
+
+	TrashSweepTask(Defaults defaults);
+
+	void execute();
+	void failed(const QException &e);
+	void finished();
+};
+
+//no export needed
+class AccessHintTask : public StoreTask<AccessHintTask>
+{
+	friend class StoreTask<AccessHintTask>;
+
+	AccessHintTask(Defaults defaults);
+
+	void execute();
+	void failed(const QException &e);
+};
+
+//no export needed
+class FormatConversionTask : public StoreTask<FormatConversionTask>
+{
+	friend class StoreTask<FormatConversionTask>;
+
+public:
+	static const int ConversionBatchSize;
+
+private:
+	bool _more = false;
+
+	FormatConversionTask(Defaults defaults);
+
+	void execute();
+	void failed(const QException &e);
+	void finished();
+};
+
+//no export needed
+class PreloadTask : public StoreTask<PreloadTask>
+{
+	friend class StoreTask<PreloadTask>;
+
+public:
+	//does nothing if no types are to be preloaded
+	static void schedule(const Defaults &defaults);
+
+private:
+	PreloadTask(Defaults defaults);
+
+	void execute();
+	void failed(const QException &e);
+};
+
+// ------------- Generic Implementation -------------
+
+template <typename TTask>
+QMutex StoreTask<TTask>::pendingMutex;
+
+template <typename TTask>
+QSet<QString> StoreTask<TTask>::pendingSetups;
+
+template <typename TTask>
+void StoreTask<TTask>::schedule(const Defaults &defaults)
+{
+	QMutexLocker _(&pendingMutex);
+	if(pendingSetups.contains(defaults.setupName()))
+		return;
+	pendingSetups.insert(defaults.setupName());
+	defaults.asyncPool()->start(new TTask{defaults});
+}
+
+template <typename TTask>
+void StoreTask<TTask>::run()
+{
+	{
+		QMutexLocker _(&pendingMutex);
+		pendingSetups.remove(_defaults.setupName());
+	}
+
+	auto task = static_cast<TTask*>(this);
+	_logger.reset(_defaults.createLogger("store"));
+	try {
+		task->execute();
+	} catch(QException &e) {
+		task->failed(e);
+	}
+	_store.reset();
+
+	//workers have no event loop, so events posted by the store must be processed here
+	QCoreApplication::sendPostedEvents();
+	task->finished();
+}
+
+template <typename TTask>
+StoreTask<TTask>::StoreTask(Defaults defaults) :
+	_defaults{std::move(defaults)}
+{}
+
+template <typename TTask>
+LocalStore &StoreTask<TTask>::store()
+{
+	if(!_store)
+		_store.reset(new LocalStore{_defaults, LocalStore::TaskInit});
+	return *_store;
+}
+
 }
 
 #endif // QTDATASYNC_LOCALSTORE_P_H
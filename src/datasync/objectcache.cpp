@@ -0,0 +1,537 @@
+#include "objectcache_p.h"
+
+#include <QtCore/QtMath>
+#include <QtCore/QJsonArray>
+
+using namespace QtDataSync;
+
+const int ObjectCache::MaxShards = 16;
+const int ObjectCache::MinShardCost = 1024 * 1024; //1 MiB
+
+namespace {
+
+//average entry size assumed to size the frequency sketch
+const int EstimatedEntryCost = 1024;
+const int MinSketchWidth = 64;
+const int MaxSketchWidth = 1 << 16;
+
+//sizes of the binary json that backs decoded objects: a header per container, a value header per element,
+//and an offset plus the key for object entries
+const int ContainerCost = 12;
+const int ElementCost = 4;
+const int EntryCost = 8;
+
+int jsonCost(const QJsonValue &value);
+
+int jsonCost(const QJsonObject &object)
+{
+	auto cost = ContainerCost;
+	for(auto it = object.constBegin(); it != object.constEnd(); it++)
+		cost += EntryCost + it.key().size() * static_cast<int>(sizeof(QChar)) + jsonCost(it.value());
+	return cost;
+}
+
+int jsonCost(const QJsonValue &value)
+{
+	switch(value.type()) {
+	case QJsonValue::Double:
+		return static_cast<int>(sizeof(double));
+	case QJsonValue::String:
+		return static_cast<int>(sizeof(int)) + value.toString().size() * static_cast<int>(sizeof(QChar));
+	case QJsonValue::Array:
+	{
+		auto cost = ContainerCost;
+		for(const auto &element : value.toArray())
+			cost += ElementCost + jsonCost(element);
+		return cost;
+	}
+	case QJsonValue::Object:
+		return jsonCost(value.toObject());
+	default: //stored within the value header
+		return 0;
+	}
+}
+
+}
+
+ObjectCache::ObjectCache(int maxCost, Setup::CacheCostModel costModel) :
+	_maxCost{maxCost},
+	_costModel{costModel}
+{
+	//small caches use less shards, so a single large entry still fits into one
+	auto shardCount = 1;
+	while(shardCount < MaxShards && maxCost / (shardCount * 2) >= MinShardCost)
+		shardCount *= 2;
+
+	const qint64 shardCapacity = maxCost / shardCount;
+	auto sketchWidth = static_cast<int>(qNextPowerOfTwo(static_cast<quint32>(qBound<qint64>(MinSketchWidth, shardCapacity / EstimatedEntryCost, MaxSketchWidth) - 1)));
+	_shards.reserve(shardCount);
+	for(auto i = 0; i < shardCount; i++)
+		_shards.append(new Shard{shardCapacity, sketchWidth});
+}
+
+ObjectCache::~ObjectCache()
+{
+	qDeleteAll(_shards);
+}
+
+int ObjectCache::maxCost() const
+{
+	return _maxCost;
+}
+
+int ObjectCache::totalCost() const
+{
+	qint64 cost = 0;
+	for(auto shard : _shards) {
+		QMutexLocker _(&shard->mutex);
+		cost += shard->window.cost + shard->probation.cost + shard->protectedList.cost;
+	}
+	return static_cast<int>(cost);
+}
+
+Setup::CacheCostModel ObjectCache::costModel() const
+{
+	return _costModel;
+}
+
+QHash<QByteArray, CacheStatistics> ObjectCache::statistics() const
+{
+	QHash<QByteArray, CacheStatistics> statistics;
+	for(auto shard : _shards) {
+		QMutexLocker _(&shard->mutex);
+		for(auto it = shard->counters.constBegin(); it != shard->counters.constEnd(); it++) {
+			auto &typeStats = statistics[it.key()];
+			typeStats.hits += it.value()->hits;
+			typeStats.misses += it.value()->misses;
+			typeStats.inserts += it.value()->inserts;
+			typeStats.evictions += it.value()->evictions;
+			typeStats.bytes += it.value()->bytes;
+			typeStats.costModel = _costModel;
+		}
+	}
+	return statistics;
+}
+
+bool ObjectCache::get(const ObjectKey &key, QJsonObject &data, quint64 *generation)
+{
+	auto hash = hashKey(key);
+	auto keyShard = shard(hash);
+	QMutexLocker _(&keyShard->mutex);
+	//misses count as well, so entries that are loaded often get admitted
+	keyShard->sketch.increment(hash);
+	auto node = keyShard->nodes.value(key);
+	if(!node) {
+		keyShard->typeCounters(key.typeName)->misses++;
+		return false;
+	}
+	node->counters->hits++;
+	keyShard->touch(node);
+	data = node->data;
+	if(generation)
+		*generation = node->generation;
+	return true;
+}
+
+quint64 ObjectCache::put(const ObjectKey &key, const QJsonObject &data, int cost)
+{
+	auto hash = hashKey(key);
+	auto keyShard = shard(hash);
+	if(_costModel == Setup::MemorySizeCost)
+		cost = memoryCost(key, data);
+	QMutexLocker _(&keyShard->mutex);
+	return keyShard->insert(key, hash, data, cost);
+}
+
+void ObjectCache::put(const QList<ObjectKey> &keys, const QList<QJsonObject> &data, const QList<int> &costs)
+{
+	Q_ASSERT(keys.size() == data.size());
+	Q_ASSERT(keys.size() == costs.size());
+
+	QVector<QVector<int>> shardIndexes(_shards.size());
+	QVector<uint> hashes;
+	hashes.reserve(keys.size());
+	for(auto i = 0; i < keys.size(); i++) {
+		auto hash = hashKey(keys[i]);
+		hashes.append(hash);
+		shardIndexes[shardIndex(hash)].append(i);
+	}
+
+	//estimated outside of the locks
+	auto memoryCosts = costs;
+	if(_costModel == Setup::MemorySizeCost) {
+		for(auto i = 0; i < keys.size(); i++)
+			memoryCosts[i] = memoryCost(keys[i], data[i]);
+	}
+
+	for(auto s = 0; s < _shards.size(); s++) {
+		if(shardIndexes[s].isEmpty())
+			continue;
+		QMutexLocker _(&_shards[s]->mutex);
+		for(auto i : qAsConst(shardIndexes[s]))
+			_shards[s]->insert(keys[i], hashes[i], data[i], memoryCosts[i]);
+	}
+}
+
+bool ObjectCache::getTyped(const ObjectKey &key, int metaTypeId, QVariant &value)
+{
+	auto hash = hashKey(key);
+	auto keyShard = shard(hash);
+	QMutexLocker _(&keyShard->mutex);
+	keyShard->sketch.increment(hash);
+	auto node = keyShard->nodes.value(key);
+	//misses are counted by the json lookup that follows
+	if(!node || node->typedId != metaTypeId)
+		return false;
+	node->counters->hits++;
+	keyShard->touch(node);
+	value = node->typed;
+	return true;
+}
+
+void ObjectCache::putTyped(const ObjectKey &key, quint64 generation, int metaTypeId, const QVariant &value)
+{
+	auto keyShard = shard(hashKey(key));
+	QMutexLocker _(&keyShard->mutex);
+	//replaced since the value was created from it -> the value is outdated
+	auto node = keyShard->nodes.value(key);
+	if(!node || node->generation != generation)
+		return;
+	auto oldTypedCost = node->typedId == QMetaType::UnknownType ? 0 : QMetaType::sizeOf(node->typedId);
+	node->typedId = metaTypeId;
+	node->typed = value;
+	if(_costModel == Setup::MemorySizeCost)
+		keyShard->resize(node, node->cost - oldTypedCost + QMetaType::sizeOf(metaTypeId));
+}
+
+bool ObjectCache::remove(const ObjectKey &key)
+{
+	auto keyShard = shard(hashKey(key));
+	QMutexLocker _(&keyShard->mutex);
+	auto node = keyShard->nodes.value(key);
+	if(!node)
+		return false;
+	keyShard->erase(node);
+	return true;
+}
+
+void ObjectCache::remove(const QByteArray &typeName, const QStringList &ids)
+{
+	for(const auto &id : ids)
+		remove({typeName, id});
+}
+
+void ObjectCache::clear()
+{
+	for(auto shard : qAsConst(_shards)) {
+		QMutexLocker _(&shard->mutex);
+		shard->clear();
+	}
+}
+
+uint ObjectCache::hashKey(const ObjectKey &key)
+{
+	return qHash(key);
+}
+
+int ObjectCache::memoryCost(const ObjectKey &key, const QJsonObject &data)
+{
+	//the decoded object keeps the binary json in memory. It is estimated, as creating it would copy the data
+	return jsonCost(data) +
+			key.typeName.size() +
+			key.id.size() * static_cast<int>(sizeof(QChar)) +
+			static_cast<int>(sizeof(Node));
+}
+
+int ObjectCache::shardIndex(uint hash) const
+{
+	//the lower bits select the hash bucket, so use the upper ones of the mixed hash for the shard
+	return static_cast<int>(((hash * 0x9E3779B1u) >> 24) & static_cast<uint>(_shards.size() - 1));
+}
+
+ObjectCache::Shard *ObjectCache::shard(uint hash) const
+{
+	return _shards[shardIndex(hash)];
+}
+
+
+
+void ObjectCache::List::pushFront(Node *node)
+{
+	node->prev = nullptr;
+	node->next = head;
+	if(head)
+		head->prev = node;
+	else
+		tail = node;
+	head = node;
+	cost += node->cost;
+}
+
+void ObjectCache::List::unlink(Node *node)
+{
+	if(node->prev)
+		node->prev->next = node->next;
+	else
+		head = node->next;
+	if(node->next)
+		node->next->prev = node->prev;
+	else
+		tail = node->prev;
+	node->prev = nullptr;
+	node->next = nullptr;
+	cost -= node->cost;
+}
+
+
+
+ObjectCache::FrequencySketch::FrequencySketch(int width) :
+	_counters(width * 4, 0),
+	_mask{static_cast<uint>(width - 1)},
+	_sampleSize{width * 10}
+{
+	Q_ASSERT_X((width & (width - 1)) == 0, Q_FUNC_INFO, "width must be a power of 2");
+}
+
+void ObjectCache::FrequencySketch::increment(uint hash)
+{
+	auto added = false;
+	for(auto row = 0; row < 4; row++) {
+		auto &counter = _counters[index(hash, row)];
+		if(counter < 15) {
+			counter++;
+			added = true;
+		}
+	}
+
+	//aging: halve all counters once enough accesses were recorded
+	if(added && ++_additions >= _sampleSize) {
+		for(auto &counter : _counters)
+			counter >>= 1;
+		_additions /= 2;
+	}
+}
+
+int ObjectCache::FrequencySketch::frequency(uint hash) const
+{
+	auto freq = 15;
+	for(auto row = 0; row < 4; row++)
+		freq = qMin<int>(freq, _counters[index(hash, row)]);
+	return freq;
+}
+
+void ObjectCache::FrequencySketch::reset()
+{
+	_counters.fill(0);
+	_additions = 0;
+}
+
+int ObjectCache::FrequencySketch::index(uint hash, int row) const
+{
+	static const uint seeds[] = {0x97CB3127u, 0xB5AD4ECEu, 0x3C6EF372u, 0xA54FF53Au};
+	auto h = (hash ^ seeds[row]) * 0x9E3779B1u;
+	h ^= h >> 15;
+	return static_cast<int>(row * (_mask + 1) + (h & _mask));
+}
+
+
+
+ObjectCache::Shard::Shard(qint64 capacity, int sketchWidth) :
+	windowCapacity{qMax<qint64>(capacity / 100, 1)},
+	protectedCapacity{(capacity - windowCapacity) * 4 / 5},
+	capacity{capacity},
+	sketch{sketchWidth}
+{}
+
+ObjectCache::Shard::~Shard()
+{
+	clear();
+	qDeleteAll(counters);
+}
+
+qint64 ObjectCache::Shard::mainCapacity() const
+{
+	return capacity - windowCapacity;
+}
+
+ObjectCache::List &ObjectCache::Shard::list(Segment segment)
+{
+	switch(segment) {
+	case Window:
+		return window;
+	case Probation:
+		return probation;
+	case Protected:
+		return protectedList;
+	default:
+		Q_UNREACHABLE();
+		return window;
+	}
+}
+
+ObjectCache::Counters *ObjectCache::Shard::typeCounters(const QByteArray &typeName)
+{
+	auto &typeCounters = counters[typeName];
+	if(!typeCounters)
+		typeCounters = new Counters{};
+	return typeCounters;
+}
+
+void ObjectCache::Shard::touch(Node *node)
+{
+	switch(node->segment) {
+	case Window:
+	case Protected:
+		list(node->segment).unlink(node);
+		list(node->segment).pushFront(node);
+		break;
+	case Probation: //used again -> worth protecting
+		probation.unlink(node);
+		node->segment = Protected;
+		protectedList.pushFront(node);
+		demoteProtected();
+		break;
+	default:
+		Q_UNREACHABLE();
+		break;
+	}
+}
+
+quint64 ObjectCache::Shard::insert(const ObjectKey &key, uint hash, const QJsonObject &data, int cost)
+{
+	auto node = nodes.value(key);
+	//entries pass the window, so they must fit into the main segments. Otherwise they can never be cached, like QCache
+	if(cost > mainCapacity()) {
+		if(node)
+			evict(node);
+		else
+			typeCounters(key.typeName)->evictions++;
+		return 0;
+	}
+
+	sketch.increment(hash);
+	auto generation = ++lastGeneration;
+	if(node) {
+		auto &nodeList = list(node->segment);
+		nodeList.unlink(node);
+		node->counters->inserts++;
+		node->counters->bytes += cost - node->cost;
+		node->data = data;
+		node->cost = cost;
+		node->generation = generation;
+		node->typedId = QMetaType::UnknownType;
+		node->typed.clear();
+		nodeList.pushFront(node);
+		touch(node);
+		trimMain();
+	} else {
+		auto nodeCounters = typeCounters(key.typeName);
+		nodeCounters->inserts++;
+		nodeCounters->bytes += cost;
+		node = new Node{key, nodeCounters, data, cost, generation, QMetaType::UnknownType, {}, Window, nullptr, nullptr};
+		nodes.insert(key, node);
+		window.pushFront(node);
+	}
+	evictWindow();
+
+	//might have been rejected by the admission
+	return nodes.contains(key) ? generation : 0;
+}
+
+void ObjectCache::Shard::resize(Node *node, int cost)
+{
+	if(cost > mainCapacity()) {
+		evict(node);
+		return;
+	}
+
+	auto &nodeList = list(node->segment);
+	nodeList.unlink(node);
+	node->counters->bytes += cost - node->cost;
+	node->cost = cost;
+	nodeList.pushFront(node);
+	if(node->segment == Window)
+		evictWindow();
+	else {
+		demoteProtected();
+		trimMain();
+	}
+}
+
+void ObjectCache::Shard::erase(Node *node)
+{
+	list(node->segment).unlink(node);
+	node->counters->bytes -= node->cost;
+	nodes.remove(node->key);
+	delete node;
+}
+
+void ObjectCache::Shard::evict(Node *node)
+{
+	node->counters->evictions++;
+	erase(node);
+}
+
+void ObjectCache::Shard::evictWindow()
+{
+	while(window.cost > windowCapacity && window.tail) {
+		auto candidate = window.tail;
+		window.unlink(candidate);
+		admit(candidate);
+	}
+}
+
+void ObjectCache::Shard::admit(Node *candidate)
+{
+	auto candidateFreq = sketch.frequency(hashKey(candidate->key));
+	while(probation.cost + protectedList.cost + candidate->cost > mainCapacity()) {
+		auto victim = probation.tail ? probation.tail : protectedList.tail;
+		//only replace entries that are used less often. Without any left, the candidate does not fit at all
+		if(!victim || candidateFreq <= sketch.frequency(hashKey(victim->key))) {
+			//already unlinked from the window
+			candidate->counters->evictions++;
+			candidate->counters->bytes -= candidate->cost;
+			nodes.remove(candidate->key);
+			delete candidate;
+			return;
+		}
+		evict(victim);
+	}
+
+	candidate->segment = Probation;
+	probation.pushFront(candidate);
+}
+
+void ObjectCache::Shard::trimMain()
+{
+	//replaced entries might have grown
+	while(probation.cost + protectedList.cost > mainCapacity()) {
+		auto victim = probation.tail ? probation.tail : protectedList.tail;
+		if(!victim)
+			break;
+		evict(victim);
+	}
+}
+
+void ObjectCache::Shard::demoteProtected()
+{
+	while(protectedList.cost > protectedCapacity && protectedList.tail) {
+		auto node = protectedList.tail;
+		protectedList.unlink(node);
+		node->segment = Probation;
+		probation.pushFront(node);
+	}
+}
+
+void ObjectCache::Shard::clear()
+{
+	qDeleteAll(nodes);
+	nodes.clear();
+	//the other counters are kept, they describe the whole lifetime of the cache
+	for(auto typeCounters : qAsConst(counters))
+		typeCounters->bytes = 0;
+	window = List{};
+	probation = List{};
+	protectedList = List{};
+	sketch.reset();
+}
@@ -0,0 +1,152 @@
+#ifndef QTDATASYNC_OBJECTCACHE_P_H
+#define QTDATASYNC_OBJECTCACHE_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QJsonObject>
+#include <QtCore/QVariant>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+#include "setup.h"
+#include "defaults.h"
+
+namespace QtDataSync {
+
+//export needed for tests
+class Q_DATASYNC_EXPORT ObjectCache
+{
+	Q_DISABLE_COPY(ObjectCache)
+
+public:
+	static const int MaxShards;
+	static const int MinShardCost;
+
+	explicit ObjectCache(int maxCost, Setup::CacheCostModel costModel = Setup::StoredSizeCost);
+	~ObjectCache();
+
+	int maxCost() const;
+	int totalCost() const;
+	Setup::CacheCostModel costModel() const;
+	//locks one shard at a time to collect the counters
+	QHash<QByteArray, CacheStatistics> statistics() const;
+
+	//the generation identifies the cached data, it changes whenever the data is replaced. 0 if not cached
+	bool get(const ObjectKey &key, QJsonObject &data, quint64 *generation = nullptr);
+	quint64 put(const ObjectKey &key, const QJsonObject &data, int cost);
+	//locks one shard at a time, so readers of the other shards are never blocked
+	void put(const QList<ObjectKey> &keys, const QList<QJsonObject> &data, const QList<int> &costs);
+	//with the memory cost model, the passed cost is ignored and estimated from the data instead
+	//second level: a deserialized value attached to the json data it was created from, dropped together with it
+	bool getTyped(const ObjectKey &key, int metaTypeId, QVariant &value);
+	void putTyped(const ObjectKey &key, quint64 generation, int metaTypeId, const QVariant &value);
+	bool remove(const ObjectKey &key);
+	void remove(const QByteArray &typeName, const QStringList &ids);
+	void clear();
+
+private:
+	//W-TinyLFU: new entries start in a small LRU window. Entries pushed out of the window are only
+	//admitted to the main SLRU if they are used more often than the entry they would evict
+	enum Segment {
+		Window,
+		Probation,
+		Protected
+	};
+
+	//only modified while the shard is locked anyways, so counting needs no extra synchronization
+	struct Counters {
+		quint64 hits = 0;
+		quint64 misses = 0;
+		quint64 inserts = 0;
+		quint64 evictions = 0;
+		qint64 bytes = 0;
+	};
+
+	struct Node {
+		ObjectKey key;
+		Counters *counters;
+		QJsonObject data;
+		int cost;
+		quint64 generation;
+		int typedId;
+		QVariant typed;
+		Segment segment;
+		Node *prev;
+		Node *next;
+	};
+
+	struct List {
+		Node *head = nullptr;
+		Node *tail = nullptr;
+		qint64 cost = 0;
+
+		void pushFront(Node *node);
+		void unlink(Node *node);
+	};
+
+	//count-min sketch with 4 rows of saturating 4 bit counters, halved periodically to forget old accesses
+	class FrequencySketch {
+	public:
+		explicit FrequencySketch(int width);
+
+		void increment(uint hash);
+		int frequency(uint hash) const;
+		void reset();
+
+	private:
+		QVector<quint8> _counters;
+		uint _mask;
+		int _additions = 0;
+		int _sampleSize;
+
+		int index(uint hash, int row) const;
+	};
+
+	struct Shard {
+		QMutex mutex;
+		QHash<ObjectKey, Node*> nodes;
+		List window;
+		List probation;
+		List protectedList;
+		qint64 windowCapacity;
+		qint64 protectedCapacity;
+		qint64 capacity;
+		FrequencySketch sketch;
+		quint64 lastGeneration = 0;
+		QHash<QByteArray, Counters*> counters;
+
+		Shard(qint64 capacity, int sketchWidth);
+		~Shard();
+
+		qint64 mainCapacity() const;
+		List &list(Segment segment);
+		Counters *typeCounters(const QByteArray &typeName);
+		void touch(Node *node);
+		quint64 insert(const ObjectKey &key, uint hash, const QJsonObject &data, int cost);
+		void resize(Node *node, int cost);
+		void erase(Node *node);
+		void evict(Node *node);
+		void evictWindow();
+		void admit(Node *candidate);
+		void trimMain();
+		void demoteProtected();
+		void clear();
+	};
+
+	const int _maxCost;
+	const Setup::CacheCostModel _costModel;
+	QVector<Shard*> _shards;
+
+	static uint hashKey(const ObjectKey &key);
+	static int memoryCost(const ObjectKey &key, const QJsonObject &data);
+	int shardIndex(uint hash) const;
+	Shard *shard(uint hash) const;
+};
+
+}
+
+Q_DECLARE_METATYPE(QSharedPointer<QtDataSync::ObjectCache>)
+
+#endif // QTDATASYNC_OBJECTCACHE_P_H
@@ -0,0 +1,410 @@
+#include "packstoragebackend_p.h"
+#include "datastore.h"
+
+#include <cstring>
+
+#include <QtCore/QtEndian>
+#include <QtCore/QFileInfo>
+
+#include <QtSql/QSqlError>
+
+using namespace QtDataSync;
+using std::function;
+
+#define QTDATASYNC_LOG _logger
+
+namespace {
+
+//every record starts with the magic and the little endian size of the data
+const char RecordMagic[] = "QDSR";
+const int MagicSize = 4;
+const int HeaderSize = MagicSize + static_cast<int>(sizeof(quint32));
+
+}
+
+const QString PackStorageBackend::LocationPrefix(QStringLiteral("pack:"));
+const qint64 PackStorageBackend::SegmentLimit = 16 * 1024 * 1024; //16 MiB
+const int PackStorageBackend::MaxMappedSegments = 16;
+
+PackStorageBackend::PackStorageBackend(Defaults defaults, Logger *logger, const DatabaseRef &db) :
+	StorageBackend{std::move(defaults), logger}
+{
+	if(!db->tables().contains(QStringLiteral("PackSegments"))) {
+		//autoincrement, so segment numbers are never reused, even after a reset
+		QSqlQuery createQuery(db);
+		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS PackSegments ( "
+										   "	Segment		INTEGER PRIMARY KEY AUTOINCREMENT, "
+										   "	Type		TEXT NOT NULL, "
+										   "	Size		INTEGER NOT NULL DEFAULT 0, "
+										   "	Dead		INTEGER NOT NULL DEFAULT 0, "
+										   "	Obsolete	INTEGER NOT NULL DEFAULT 0 "
+										   ");"));
+		exec(createQuery);
+		logDebug() << "Created PackSegments table";
+	}
+}
+
+PackStorageBackend::~PackStorageBackend()
+{
+	for(const auto &mapped : qAsConst(_mappedSegments))
+		mapped.file->unmap(mapped.data);
+}
+
+bool PackStorageBackend::isPackLocation(const QString &location)
+{
+	return location.startsWith(LocationPrefix);
+}
+
+QByteArray PackStorageBackend::read(const ObjectKey &key, const QString &location)
+{
+	auto record = parseLocation(key, location);
+	auto data = mapRecord(key, record);
+	if(std::memcmp(data, RecordMagic, MagicSize) != 0 ||
+	   qFromLittleEndian<quint32>(data + MagicSize) != static_cast<quint32>(record.size)) {
+		throw LocalStoreException(_defaults, key, segmentPath(key, record.segment),
+								  QStringLiteral("Segment does not contain a valid record at offset %1")
+								  .arg(record.offset));
+	}
+
+	//no copy - the data stays valid as long as the segment is mapped
+	return QByteArray::fromRawData(reinterpret_cast<const char*>(data + HeaderSize), record.size);
+}
+
+StorageBackend::PendingWrite PackStorageBackend::write(const DatabaseRef &db, const ObjectKey &key, const QString &oldLocation, const QByteArray &data)
+{
+	Record record {-1, 0, data.size()};
+	const qint64 recordSize = HeaderSize + data.size();
+
+	//append to the newest segment of the type, as long as it has space left
+	QSqlQuery segmentQuery(db);
+	segmentQuery.prepare(QStringLiteral("SELECT Segment, Size, Dead FROM PackSegments "
+										"WHERE Type = ? AND Obsolete = 0 "
+										"ORDER BY Segment DESC "
+										"LIMIT 1"));
+	segmentQuery.addBindValue(key.typeName);
+	exec(segmentQuery, key);
+	auto hasSegment = segmentQuery.first();
+	if(hasSegment) {
+		auto segmentSize = segmentQuery.value(1).toLongLong();
+		if(segmentSize == 0 || segmentSize + recordSize <= SegmentLimit) {
+			record.segment = segmentQuery.value(0).toLongLong();
+			record.offset = segmentSize;
+		} else if(segmentQuery.value(2).toLongLong() * 2 >= segmentSize) //the full segment can be compacted now
+			_compactionNeeded = true;
+	}
+
+	if(record.segment < 0) {
+		QSqlQuery insertQuery(db);
+		insertQuery.prepare(QStringLiteral("INSERT INTO PackSegments (Type) VALUES(?)"));
+		insertQuery.addBindValue(key.typeName);
+		exec(insertQuery, key);
+		record.segment = insertQuery.lastInsertId().toLongLong();
+	}
+
+	//write the record behind the last committed one. Anything after that is left over from a rollback
+	auto file = QSharedPointer<QFile>::create(segmentPath(key, record.segment, true));
+	openFile(key, QStringLiteral("pack"), QFileInfo(file->fileName()).absolutePath(), file.data(), [file](){
+		return file->open(QIODevice::ReadWrite);
+	});
+	if(!file->seek(record.offset))
+		throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
+
+	char header[HeaderSize];
+	std::memcpy(header, RecordMagic, MagicSize);
+	qToLittleEndian<quint32>(static_cast<quint32>(data.size()), header + MagicSize);
+	if(file->write(header, HeaderSize) != HeaderSize ||
+	   file->write(data) != data.size() ||
+	   !file->flush())
+		throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
+
+	QSqlQuery sizeQuery(db);
+	sizeQuery.prepare(QStringLiteral("UPDATE PackSegments SET Size = ? WHERE Segment = ?"));
+	sizeQuery.addBindValue(record.offset + recordSize);
+	sizeQuery.addBindValue(record.segment);
+	exec(sizeQuery, key);
+
+	if(!oldLocation.isNull())
+		markDead(db, key, parseLocation(key, oldLocation));
+
+	return {
+		locationString(record),
+		[this, key, record, file]() {
+			if(_grouped)
+				_groupSegments.insert(record.segment, {key, file});
+			else {
+				if(_durability != Setup::DurabilityRelaxed && !syncToDisk(file.data()))
+					throw LocalStoreException(_defaults, key, file->fileName(), QStringLiteral("Failed to sync segment to disk"));
+				file->close();
+			}
+		}
+	};
+}
+
+function<void()> PackStorageBackend::remove(const DatabaseRef &db, const ObjectKey &key, const QString &location)
+{
+	//the record stays in the segment until it gets compacted
+	markDead(db, key, parseLocation(key, location));
+	return {};
+}
+
+void PackStorageBackend::clear(const DatabaseRef &db, const QByteArray &typeName)
+{
+	QSqlQuery segmentsQuery(db);
+	segmentsQuery.prepare(QStringLiteral("SELECT Segment FROM PackSegments WHERE Type = ?"));
+	segmentsQuery.addBindValue(typeName);
+	exec(segmentsQuery, typeName);
+	while(segmentsQuery.next())
+		unmapSegment(segmentsQuery.value(0).toLongLong());
+
+	QSqlQuery clearQuery(db);
+	clearQuery.prepare(QStringLiteral("DELETE FROM PackSegments WHERE Type = ?"));
+	clearQuery.addBindValue(typeName);
+	exec(clearQuery, typeName);
+
+	auto typeDir = typeDirectory(QStringLiteral("pack"), typeName);
+	if(!moveToTrash(_defaults, typeDir.absolutePath()) &&
+	   !typeDir.removeRecursively()) {
+		logWarning() << "Failed to delete cleared pack directory for type"
+					 << typeName;
+	}
+}
+
+void PackStorageBackend::reset(const DatabaseRef &db)
+{
+	StorageBackend::reset(db);
+
+	//the files are removed together with the rest of the store
+	QSqlQuery resetQuery(db);
+	resetQuery.prepare(QStringLiteral("DELETE FROM PackSegments"));
+	exec(resetQuery);
+
+	for(const auto &mapped : qAsConst(_mappedSegments))
+		mapped.file->unmap(mapped.data);
+	_mappedSegments.clear();
+	_compactionNeeded = false;
+}
+
+void PackStorageBackend::beginGroup()
+{
+	_grouped = true;
+}
+
+void PackStorageBackend::endGroup(bool commit)
+{
+	auto segments = _groupSegments;
+	_groupSegments.clear();
+	_grouped = false;
+	if(!commit || _durability == Setup::DurabilityRelaxed)
+		return;
+
+	//a sync of any handle flushes the whole segment, so one per segment is enough
+	for(const auto &segment : segments) {
+		if(!syncToDisk(segment.second.data()))
+			throw LocalStoreException(_defaults, segment.first, segment.second->fileName(), QStringLiteral("Failed to sync segment to disk"));
+	}
+}
+
+bool PackStorageBackend::prefersOrderedReads() const
+{
+	return true;
+}
+
+bool PackStorageBackend::takeCompactionRequest()
+{
+	auto needed = _compactionNeeded;
+	_compactionNeeded = false;
+	return needed;
+}
+
+function<void()> PackStorageBackend::compact(const DatabaseRef &db)
+{
+	//delete segments obsoleted by the previous compaction. They are kept for one round, as readers in WAL mode might still use them
+	QSqlQuery obsoleteQuery(db);
+	obsoleteQuery.prepare(QStringLiteral("SELECT Segment, Type FROM PackSegments WHERE Obsolete = 1"));
+	exec(obsoleteQuery);
+	while(obsoleteQuery.next()) {
+		auto segment = obsoleteQuery.value(0).toLongLong();
+		ObjectKey key {obsoleteQuery.value(1).toByteArray()};
+		unmapSegment(segment);
+
+		QFile segmentFile(segmentPath(key, segment));
+		if(segmentFile.exists() && !segmentFile.remove()) {
+			logWarning() << "Failed to remove obsolete segment" << segmentFile.fileName()
+						 << "with error:" << segmentFile.errorString();
+			continue;
+		}
+
+		QSqlQuery deleteQuery(db);
+		deleteQuery.prepare(QStringLiteral("DELETE FROM PackSegments WHERE Segment = ?"));
+		deleteQuery.addBindValue(segment);
+		exec(deleteQuery, key);
+	}
+
+	//find all mostly dead segments, except the ones currently written to
+	QSqlQuery deadQuery(db);
+	deadQuery.prepare(QStringLiteral("SELECT Segment, Type FROM PackSegments AS Seg "
+									 "WHERE Obsolete = 0 AND Dead * 2 >= Size "
+									 "AND Segment < (SELECT MAX(Segment) FROM PackSegments WHERE Type = Seg.Type)"));
+	exec(deadQuery);
+	QList<QPair<qint64, QByteArray>> deadSegments;
+	while(deadQuery.next())
+		deadSegments.append({deadQuery.value(0).toLongLong(), deadQuery.value(1).toByteArray()});
+
+	//the moved records are synced once, before the caller commits the new locations
+	beginGroup();
+	try {
+		for(const auto &deadSegment : deadSegments) {
+			//copy all live records into the current segment
+			QSqlQuery liveQuery(db);
+			liveQuery.prepare(QStringLiteral("SELECT Id, File FROM DataIndex WHERE Type = ? AND File >= ? AND File < ?"));
+			liveQuery.addBindValue(deadSegment.second);
+			liveQuery.addBindValue(QStringLiteral("%1%2:").arg(LocationPrefix).arg(deadSegment.first, 8, 16, QLatin1Char('0')));
+			liveQuery.addBindValue(QStringLiteral("%1%2;").arg(LocationPrefix).arg(deadSegment.first, 8, 16, QLatin1Char('0')));
+			exec(liveQuery, deadSegment.second);
+			QList<QPair<QString, QString>> liveRecords;
+			while(liveQuery.next())
+				liveRecords.append({liveQuery.value(0).toString(), liveQuery.value(1).toString()});
+
+			QList<function<void()>> completeFns;
+			for(const auto &liveRecord : liveRecords) {
+				ObjectKey key {deadSegment.second, liveRecord.first};
+				auto rawData = read(key, liveRecord.second);
+				auto pending = write(db, key, QString(), QByteArray{rawData.constData(), rawData.size()});
+
+				QSqlQuery moveQuery(db);
+				moveQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = ? WHERE Type = ? AND Id = ?"));
+				moveQuery.addBindValue(pending.location);
+				moveQuery.addBindValue(key.typeName);
+				moveQuery.addBindValue(key.id);
+				exec(moveQuery, key);
+				completeFns.append(pending.complete);
+			}
+			for(const auto &completeFn : completeFns)
+				completeFn();
+
+			QSqlQuery obsoleteMarkQuery(db);
+			obsoleteMarkQuery.prepare(QStringLiteral("UPDATE PackSegments SET Obsolete = 1 WHERE Segment = ?"));
+			obsoleteMarkQuery.addBindValue(deadSegment.first);
+			exec(obsoleteMarkQuery, deadSegment.second);
+			logDebug() << "Compacted segment" << deadSegment.first
+					   << "of type" << deadSegment.second
+					   << "by moving" << liveRecords.size() << "records";
+		}
+		endGroup(true);
+	} catch(...) {
+		endGroup(false);
+		throw;
+	}
+
+	_compactionNeeded = false;
+	return {};
+}
+
+QString PackStorageBackend::locationString(const Record &record)
+{
+	//fixed width hex numbers, so the lexical order of locations is the physical one
+	return QStringLiteral("%1%2:%3:%4")
+			.arg(LocationPrefix)
+			.arg(record.segment, 8, 16, QLatin1Char('0'))
+			.arg(record.offset, 12, 16, QLatin1Char('0'))
+			.arg(record.size, 0, 16);
+}
+
+PackStorageBackend::Record PackStorageBackend::parseLocation(const ObjectKey &key, const QString &location) const
+{
+	auto parts = location.midRef(LocationPrefix.size()).split(QLatin1Char(':'));
+	if(!isPackLocation(location) || parts.size() != 3)
+		throw LocalStoreException(_defaults, key, location, QStringLiteral("Invalid pack storage location"));
+
+	auto ok1 = false, ok2 = false, ok3 = false;
+	Record record {
+		parts[0].toLongLong(&ok1, 16),
+		parts[1].toLongLong(&ok2, 16),
+		parts[2].toInt(&ok3, 16)
+	};
+	if(!ok1 || !ok2 || !ok3)
+		throw LocalStoreException(_defaults, key, location, QStringLiteral("Invalid pack storage location"));
+	return record;
+}
+
+QString PackStorageBackend::segmentPath(const ObjectKey &key, qint64 segment, bool create) const
+{
+	return typeDirectory(QStringLiteral("pack"), key, create)
+			.absoluteFilePath(QStringLiteral("%1.seg").arg(segment, 8, 16, QLatin1Char('0')));
+}
+
+const uchar *PackStorageBackend::mapRecord(const ObjectKey &key, const Record &record)
+{
+	const auto recordEnd = record.offset + HeaderSize + record.size;
+	for(auto i = 0; i < _mappedSegments.size(); i++) {
+		if(_mappedSegments[i].segment != record.segment)
+			continue;
+
+		if(recordEnd <= _mappedSegments[i].size) {
+			_mappedSegments.move(i, 0);
+			return _mappedSegments.first().data + record.offset;
+		} else { //segment has grown since it was mapped -> map again
+			unmapSegment(record.segment);
+			break;
+		}
+	}
+
+	auto file = QSharedPointer<QFile>::create(segmentPath(key, record.segment));
+	if(!file->open(QIODevice::ReadOnly))
+		throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
+	auto size = file->size();
+	if(recordEnd > size) {
+		throw LocalStoreException(_defaults, key, file->fileName(),
+								  QStringLiteral("Record at offset %1 exceeds the segment size").arg(record.offset));
+	}
+	auto data = file->map(0, size);
+	if(!data)
+		throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
+
+	_mappedSegments.prepend({record.segment, file, data, size});
+	while(_mappedSegments.size() > MaxMappedSegments) {
+		auto mapped = _mappedSegments.takeLast();
+		mapped.file->unmap(mapped.data);
+	}
+	return data + record.offset;
+}
+
+void PackStorageBackend::unmapSegment(qint64 segment)
+{
+	for(auto i = 0; i < _mappedSegments.size(); i++) {
+		if(_mappedSegments[i].segment == segment) {
+			auto mapped = _mappedSegments.takeAt(i);
+			mapped.file->unmap(mapped.data);
+			return;
+		}
+	}
+}
+
+void PackStorageBackend::markDead(const DatabaseRef &db, const ObjectKey &key, const Record &record)
+{
+	QSqlQuery deadQuery(db);
+	deadQuery.prepare(QStringLiteral("UPDATE PackSegments SET Dead = Dead + ? WHERE Segment = ?"));
+	deadQuery.addBindValue(HeaderSize + record.size);
+	deadQuery.addBindValue(record.segment);
+	exec(deadQuery, key);
+
+	//only segments that are not written to anymore can be compacted
+	QSqlQuery checkQuery(db);
+	checkQuery.prepare(QStringLiteral("SELECT Dead * 2 >= Size FROM PackSegments AS Seg "
+									  "WHERE Segment = ? AND Obsolete = 0 "
+									  "AND Segment < (SELECT MAX(Segment) FROM PackSegments WHERE Type = Seg.Type)"));
+	checkQuery.addBindValue(record.segment);
+	exec(checkQuery, key);
+	if(checkQuery.first() && checkQuery.value(0).toBool())
+		_compactionNeeded = true;
+}
+
+void PackStorageBackend::exec(QSqlQuery &query, const ObjectKey &key) const
+{
+	if(!query.exec()) {
+		throw LocalStoreException(_defaults,
+								  key,
+								  query.executedQuery().simplified(),
+								  query.lastError().text());
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef QTDATASYNC_PACKSTORAGEBACKEND_P_H
+#define QTDATASYNC_PACKSTORAGEBACKEND_P_H
+
+#include <QtCore/QFile>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QList>
+#include <QtCore/QHash>
+
+#include <QtSql/QSqlQuery>
+
+#include "qtdatasync_global.h"
+#include "storagebackend_p.h"
+
+namespace QtDataSync {
+
+//no export needed
+class PackStorageBackend : public StorageBackend
+{
+public:
+	static const QString LocationPrefix;
+	static const qint64 SegmentLimit;
+	static const int MaxMappedSegments;
+
+	PackStorageBackend(Defaults defaults, Logger *logger, const DatabaseRef &db);
+	~PackStorageBackend() override;
+
+	static bool isPackLocation(const QString &location);
+
+	QByteArray read(const ObjectKey &key, const QString &location) override;
+	PendingWrite write(const DatabaseRef &db, const ObjectKey &key, const QString &oldLocation, const QByteArray &data) override;
+	std::function<void()> remove(const DatabaseRef &db, const ObjectKey &key, const QString &location) override;
+	void clear(const DatabaseRef &db, const QByteArray &typeName) override;
+	void reset(const DatabaseRef &db) override;
+
+	void beginGroup() override;
+	void endGroup(bool commit) override;
+
+	bool prefersOrderedReads() const override;
+	bool takeCompactionRequest() override;
+	std::function<void()> compact(const DatabaseRef &db) override;
+
+private:
+	struct Record {
+		qint64 segment;
+		qint64 offset;
+		int size;
+	};
+
+	struct MappedSegment {
+		qint64 segment;
+		QSharedPointer<QFile> file;
+		uchar *data;
+		qint64 size;
+	};
+
+	QList<MappedSegment> _mappedSegments; //most recently used first
+	bool _compactionNeeded = false;
+	bool _grouped = false;
+	QHash<qint64, QPair<ObjectKey, QSharedPointer<QFile>>> _groupSegments; //segments written while grouped, to be synced once
+
+	static QString locationString(const Record &record);
+	Record parseLocation(const ObjectKey &key, const QString &location) const;
+	QString segmentPath(const ObjectKey &key, qint64 segment, bool create = false) const;
+
+	const uchar *mapRecord(const ObjectKey &key, const Record &record);
+	void unmapSegment(qint64 segment);
+	void markDead(const DatabaseRef &db, const ObjectKey &key, const Record &record);
+
+	void exec(QSqlQuery &query, const ObjectKey &key = ObjectKey{"any"}) const;
+};
+
+}
+
+#endif // QTDATASYNC_PACKSTORAGEBACKEND_P_H
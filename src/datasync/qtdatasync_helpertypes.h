@@ -28,6 +28,15 @@ struct is_storable : public is_gadget<T> {};
 template <typename T>
 struct is_storable<T*> : public std::is_base_of<QObject, T> {};
 
+template <typename T>
+inline void move_to_thread(const T &, QThread *) {}
+
+template <typename T>
+inline std::enable_if_t<std::is_base_of<QObject, T>::value> move_to_thread(T *object, QThread *thread) {
+	if(object)
+		object->moveToThread(thread);
+}
+
 }
 }
 
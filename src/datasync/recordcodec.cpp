@@ -0,0 +1,362 @@
+#include "recordcodec_p.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QtEndian>
+
+using namespace QtDataSync;
+
+namespace {
+
+const char Magic[] = {'Q', 'D', 'S', 'C'};
+const int MagicSize = sizeof(Magic);
+const int MaxDepth = 512;
+
+//every value starts with a tag byte: the type in the lower 3 bits, a small length or integer in the upper 5.
+//If the upper bits are all set, the length or integer follows as varint instead
+enum Tag : quint8 {
+	NullTag = 0,
+	FalseTag = 1,
+	TrueTag = 2,
+	IntTag = 3, //zigzag encoded
+	DoubleTag = 4, //8 bytes, little endian
+	StringTag = 5, //utf8
+	ArrayTag = 6,
+	ObjectTag = 7 //keys are stored as varint length + utf8, without a tag
+};
+const int TagBits = 3;
+const quint8 TagMask = 0x07;
+const quint64 InlineLimit = 0x1F;
+//integral doubles within this range are exact as integers
+const double MaxExactInt = 9007199254740992.0;
+
+void writeVarint(QByteArray &buffer, quint64 value)
+{
+	while(value >= 0x80) {
+		buffer.append(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	buffer.append(static_cast<char>(value));
+}
+
+void writeTag(QByteArray &buffer, Tag tag, quint64 value)
+{
+	if(value < InlineLimit)
+		buffer.append(static_cast<char>(tag | (value << TagBits)));
+	else {
+		buffer.append(static_cast<char>(tag | (InlineLimit << TagBits)));
+		writeVarint(buffer, value - InlineLimit);
+	}
+}
+
+void writeString(QByteArray &buffer, Tag tag, const QString &string)
+{
+	auto utf8 = string.toUtf8();
+	writeTag(buffer, tag, static_cast<quint64>(utf8.size()));
+	buffer.append(utf8);
+}
+
+void writeValue(QByteArray &buffer, const QJsonValue &value)
+{
+	switch(value.type()) {
+	case QJsonValue::Null:
+	case QJsonValue::Undefined:
+		buffer.append(static_cast<char>(NullTag));
+		break;
+	case QJsonValue::Bool:
+		buffer.append(static_cast<char>(value.toBool() ? TrueTag : FalseTag));
+		break;
+	case QJsonValue::Double:
+	{
+		auto number = value.toDouble();
+		if(std::abs(number) <= MaxExactInt &&
+		   std::trunc(number) == number &&
+		   !(number == 0.0 && std::signbit(number))) {
+			auto integer = static_cast<qint64>(number);
+			writeTag(buffer, IntTag, (static_cast<quint64>(integer) << 1) ^ static_cast<quint64>(integer >> 63));
+		} else {
+			quint64 bits;
+			std::memcpy(&bits, &number, sizeof(bits));
+			buffer.append(static_cast<char>(DoubleTag));
+			char raw[sizeof(bits)];
+			qToLittleEndian(bits, raw);
+			buffer.append(raw, sizeof(raw));
+		}
+		break;
+	}
+	case QJsonValue::String:
+		writeString(buffer, StringTag, value.toString());
+		break;
+	case QJsonValue::Array:
+	{
+		const auto array = value.toArray();
+		writeTag(buffer, ArrayTag, static_cast<quint64>(array.size()));
+		for(const auto &element : array)
+			writeValue(buffer, element);
+		break;
+	}
+	case QJsonValue::Object:
+	{
+		const auto object = value.toObject();
+		writeTag(buffer, ObjectTag, static_cast<quint64>(object.size()));
+		for(auto it = object.constBegin(); it != object.constEnd(); it++) {
+			auto key = it.key().toUtf8();
+			writeVarint(buffer, static_cast<quint64>(key.size()));
+			buffer.append(key);
+			writeValue(buffer, it.value());
+		}
+		break;
+	}
+	default:
+		Q_UNREACHABLE();
+		break;
+	}
+}
+
+//reads from the passed range without copying it. Every length is checked against the remaining data
+class Reader
+{
+public:
+	Reader(const char *begin, const char *end) :
+		_pos{begin},
+		_end{end}
+	{}
+
+	bool atEnd() const {
+		return _pos == _end;
+	}
+
+	bool readValue(QJsonValue &value, int depth) {
+		if(depth > MaxDepth)
+			return fail(QStringLiteral("Data is nested too deeply"));
+		if(_pos == _end)
+			return fail(QStringLiteral("Unexpected end of data"));
+
+		auto tagByte = static_cast<quint8>(*_pos++);
+		auto tag = static_cast<Tag>(tagByte & TagMask);
+		quint64 inlineValue = tagByte >> TagBits;
+		switch(tag) {
+		case NullTag:
+			value = QJsonValue::Null;
+			return true;
+		case FalseTag:
+			value = false;
+			return true;
+		case TrueTag:
+			value = true;
+			return true;
+		case IntTag:
+		{
+			quint64 zigzag;
+			if(!readInline(inlineValue, zigzag))
+				return false;
+			auto integer = static_cast<qint64>(zigzag >> 1) ^ -static_cast<qint64>(zigzag & 1);
+			value = static_cast<double>(integer);
+			return true;
+		}
+		case DoubleTag:
+		{
+			if(_end - _pos < static_cast<qptrdiff>(sizeof(quint64)))
+				return fail(QStringLiteral("Unexpected end of data"));
+			auto bits = qFromLittleEndian<quint64>(_pos);
+			_pos += sizeof(bits);
+			double number;
+			std::memcpy(&number, &bits, sizeof(number));
+			value = number;
+			return true;
+		}
+		case StringTag:
+		{
+			QString string;
+			quint64 size;
+			if(!readInline(inlineValue, size) || !readString(size, string))
+				return false;
+			value = string;
+			return true;
+		}
+		case ArrayTag:
+		{
+			quint64 size;
+			if(!readInline(inlineValue, size))
+				return false;
+			//every element needs at least one byte
+			if(size > static_cast<quint64>(_end - _pos))
+				return fail(QStringLiteral("Invalid array size"));
+			QJsonArray array;
+			for(quint64 i = 0; i < size; i++) {
+				QJsonValue element;
+				if(!readValue(element, depth + 1))
+					return false;
+				array.append(element);
+			}
+			value = array;
+			return true;
+		}
+		case ObjectTag:
+		{
+			QJsonObject object;
+			if(!readObject(inlineValue, object, depth))
+				return false;
+			value = object;
+			return true;
+		}
+		default:
+			Q_UNREACHABLE();
+			return false;
+		}
+	}
+
+	bool readObject(QJsonObject &object, int depth) {
+		if(_pos == _end)
+			return fail(QStringLiteral("Unexpected end of data"));
+		auto tagByte = static_cast<quint8>(*_pos++);
+		if((tagByte & TagMask) != ObjectTag)
+			return fail(QStringLiteral("Data is not an object"));
+		return readObject(tagByte >> TagBits, object, depth);
+	}
+
+	QString error() const {
+		return _error;
+	}
+
+private:
+	const char *_pos;
+	const char *_end;
+	QString _error;
+
+	bool fail(const QString &error) {
+		_error = error;
+		return false;
+	}
+
+	bool readVarint(quint64 &value) {
+		value = 0;
+		for(auto shift = 0; shift < 64; shift += 7) {
+			if(_pos == _end)
+				return fail(QStringLiteral("Unexpected end of data"));
+			auto byte = static_cast<quint8>(*_pos++);
+			value |= static_cast<quint64>(byte & 0x7F) << shift;
+			if((byte & 0x80) == 0)
+				return true;
+		}
+		return fail(QStringLiteral("Invalid varint"));
+	}
+
+	bool readInline(quint64 inlineValue, quint64 &value) {
+		if(inlineValue < InlineLimit) {
+			value = inlineValue;
+			return true;
+		} else if(readVarint(value)) {
+			value += InlineLimit;
+			return true;
+		} else
+			return false;
+	}
+
+	bool readString(quint64 size, QString &string) {
+		if(size > static_cast<quint64>(_end - _pos))
+			return fail(QStringLiteral("Invalid string size"));
+		string = QString::fromUtf8(_pos, static_cast<int>(size));
+		_pos += size;
+		return true;
+	}
+
+	bool readObject(quint64 inlineValue, QJsonObject &object, int depth) {
+		quint64 size;
+		if(!readInline(inlineValue, size))
+			return false;
+		//every entry needs at least two bytes
+		if(size > static_cast<quint64>(_end - _pos) / 2)
+			return fail(QStringLiteral("Invalid object size"));
+		for(quint64 i = 0; i < size; i++) {
+			quint64 keySize;
+			QString key;
+			QJsonValue element;
+			if(!readVarint(keySize) ||
+			   !readString(keySize, key) ||
+			   !readValue(element, depth + 1))
+				return false;
+			//keys are written sorted, so this always appends
+			object.insert(key, element);
+		}
+		return true;
+	}
+};
+
+}
+
+bool RecordCodec::isRecord(const QByteArray &data)
+{
+	return data.size() >= HeaderSize &&
+			std::memcmp(data.constData(), Magic, MagicSize) == 0;
+}
+
+QByteArray RecordCodec::encodeBody(const QJsonObject &data)
+{
+	QByteArray buffer;
+	buffer.reserve(256);
+	writeValue(buffer, data);
+	return buffer;
+}
+
+QByteArray RecordCodec::createRecord(const QByteArray &payload, quint8 flags)
+{
+	QByteArray record(HeaderSize, Qt::Uninitialized);
+	std::memcpy(record.data(), Magic, MagicSize);
+	record[MagicSize] = static_cast<char>(FormatVersion);
+	record[MagicSize + 1] = static_cast<char>(flags);
+	qToLittleEndian(qChecksum(payload.constData(), static_cast<uint>(payload.size())),
+					record.data() + MagicSize + 2);
+	record.reserve(HeaderSize + payload.size());
+	record.append(payload);
+	return record;
+}
+
+bool RecordCodec::readRecord(const QByteArray &record, QJsonObject &data, QString &error, int *bodySize)
+{
+	if(!isRecord(record)) {
+		error = QStringLiteral("Data is not a record");
+		return false;
+	}
+
+	auto version = static_cast<quint8>(record[MagicSize]);
+	if(version > FormatVersion) {
+		error = QStringLiteral("Unsupported record format version %1").arg(version);
+		return false;
+	}
+	auto flags = static_cast<quint8>(record[MagicSize + 1]);
+	auto checksum = qFromLittleEndian<quint16>(record.constData() + MagicSize + 2);
+
+	auto payload = record.constData() + HeaderSize;
+	auto payloadSize = record.size() - HeaderSize;
+	if(qChecksum(payload, static_cast<uint>(payloadSize)) != checksum) {
+		error = QStringLiteral("Record checksum mismatch");
+		return false;
+	}
+
+	QByteArray body;
+	if(flags & Compressed) {
+		body = qUncompress(reinterpret_cast<const uchar*>(payload), payloadSize);
+		if(body.isEmpty()) {
+			error = QStringLiteral("Failed to decompress stored data");
+			return false;
+		}
+		payload = body.constData();
+		payloadSize = body.size();
+	}
+
+	Reader reader{payload, payload + payloadSize};
+	if(!reader.readObject(data, 0)) {
+		error = reader.error();
+		return false;
+	}
+	if(!reader.atEnd()) {
+		error = QStringLiteral("Unexpected data after the record body");
+		return false;
+	}
+	if(bodySize)
+		*bodySize = payloadSize;
+	return true;
+}
@@ -0,0 +1,33 @@
+#ifndef QTDATASYNC_RECORDCODEC_P_H
+#define QTDATASYNC_RECORDCODEC_P_H
+
+#include <QtCore/QJsonObject>
+
+#include "qtdatasync_global.h"
+
+namespace QtDataSync {
+
+//on disk format of a dataset: "QDSC", format version, flags, crc16 of the payload, followed by the payload.
+//The payload is the encoded body, compressed with qCompress if the Compressed flag is set
+namespace RecordCodec {
+
+enum Flag : quint8 {
+	NoFlags = 0x00,
+	Compressed = 0x01
+};
+
+const quint8 FormatVersion = 1;
+const int HeaderSize = 8;
+
+//exports are needed for tests
+Q_DATASYNC_EXPORT bool isRecord(const QByteArray &data);
+Q_DATASYNC_EXPORT QByteArray encodeBody(const QJsonObject &data);
+Q_DATASYNC_EXPORT QByteArray createRecord(const QByteArray &payload, quint8 flags = NoFlags);
+//decodes straight from the passed data, only compressed payloads are copied. bodySize is the size of the uncompressed body
+Q_DATASYNC_EXPORT bool readRecord(const QByteArray &record, QJsonObject &data, QString &error, int *bodySize = nullptr);
+
+}
+
+}
+
+#endif // QTDATASYNC_RECORDCODEC_P_H
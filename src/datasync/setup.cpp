@@ -8,6 +8,7 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore/QLockFile>
 #include <QtCore/QStandardPaths>
+#include <QtCore/QThread>
 #include <QtCore/QThreadStorage>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QEventLoop>
@@ -187,6 +188,76 @@ qint32 Setup::cipherKeySize() const
 	return d->properties.value(Defaults::SymKeyParam).toInt();
 }
 
+int Setup::inlineDataThreshold() const
+{
+	return d->properties.value(Defaults::InlineThreshold).toInt();
+}
+
+Setup::JournalMode Setup::journalMode() const
+{
+	return static_cast<JournalMode>(d->properties.value(Defaults::DbJournalMode).toInt());
+}
+
+Setup::SynchronousMode Setup::synchronousMode() const
+{
+	return static_cast<SynchronousMode>(d->properties.value(Defaults::DbSynchronous).toInt());
+}
+
+qint64 Setup::mmapSize() const
+{
+	return d->properties.value(Defaults::DbMmapSize).toLongLong();
+}
+
+int Setup::databaseCacheSize() const
+{
+	return d->properties.value(Defaults::DbCacheSize).toInt();
+}
+
+int Setup::walAutoCheckpoint() const
+{
+	return d->properties.value(Defaults::DbWalCheckpoint).toInt();
+}
+
+int Setup::asyncThreadCount() const
+{
+	return d->properties.value(Defaults::AsyncThreadCount).toInt();
+}
+
+Setup::StorageEngine Setup::storageEngine() const
+{
+	return static_cast<StorageEngine>(d->properties.value(Defaults::StorageEngine).toInt());
+}
+
+int Setup::compressionLevel() const
+{
+	return d->properties.value(Defaults::CompressionLevel).toInt();
+}
+
+int Setup::compressionThreshold() const
+{
+	return d->properties.value(Defaults::CompressionThreshold).toInt();
+}
+
+Setup::ChecksumAlgorithm Setup::checksumAlgorithm() const
+{
+	return static_cast<ChecksumAlgorithm>(d->properties.value(Defaults::ChecksumAlgorithm).toInt());
+}
+
+int Setup::coalescingWindow() const
+{
+	return d->properties.value(Defaults::CoalescingWindow).toInt();
+}
+
+Setup::Durability Setup::durability() const
+{
+	return static_cast<Durability>(d->properties.value(Defaults::Durability).toInt());
+}
+
+Setup::CacheCostModel Setup::cacheCostModel() const
+{
+	return static_cast<CacheCostModel>(d->properties.value(Defaults::CacheCostModel).toInt());
+}
+
 Setup &Setup::setLocalDir(QString localDir)
 {
 	d->localDir = std::move(localDir);
@@ -290,6 +361,90 @@ Setup &Setup::setCipherKeySize(qint32 cipherKeySize)
 	return *this;
 }
 
+Setup &Setup::setInlineDataThreshold(int inlineDataThreshold)
+{
+	d->properties.insert(Defaults::InlineThreshold, inlineDataThreshold);
+	return *this;
+}
+
+Setup &Setup::setJournalMode(JournalMode journalMode)
+{
+	d->properties.insert(Defaults::DbJournalMode, journalMode);
+	return *this;
+}
+
+Setup &Setup::setSynchronousMode(SynchronousMode synchronousMode)
+{
+	d->properties.insert(Defaults::DbSynchronous, synchronousMode);
+	return *this;
+}
+
+Setup &Setup::setMmapSize(qint64 mmapSize)
+{
+	d->properties.insert(Defaults::DbMmapSize, mmapSize);
+	return *this;
+}
+
+Setup &Setup::setDatabaseCacheSize(int databaseCacheSize)
+{
+	d->properties.insert(Defaults::DbCacheSize, databaseCacheSize);
+	return *this;
+}
+
+Setup &Setup::setWalAutoCheckpoint(int walAutoCheckpoint)
+{
+	d->properties.insert(Defaults::DbWalCheckpoint, walAutoCheckpoint);
+	return *this;
+}
+
+Setup &Setup::setAsyncThreadCount(int asyncThreadCount)
+{
+	d->properties.insert(Defaults::AsyncThreadCount, asyncThreadCount);
+	return *this;
+}
+
+Setup &Setup::setStorageEngine(StorageEngine storageEngine)
+{
+	d->properties.insert(Defaults::StorageEngine, storageEngine);
+	return *this;
+}
+
+Setup &Setup::setCompressionLevel(int compressionLevel)
+{
+	d->properties.insert(Defaults::CompressionLevel, compressionLevel);
+	return *this;
+}
+
+Setup &Setup::setCompressionThreshold(int compressionThreshold)
+{
+	d->properties.insert(Defaults::CompressionThreshold, compressionThreshold);
+	return *this;
+}
+
+Setup &Setup::setChecksumAlgorithm(ChecksumAlgorithm checksumAlgorithm)
+{
+	d->properties.insert(Defaults::ChecksumAlgorithm, checksumAlgorithm);
+	return *this;
+}
+
+Setup &Setup::setCoalescingWindow(int coalescingWindow)
+{
+	d->properties.insert(Defaults::CoalescingWindow, coalescingWindow);
+	return *this;
+}
+
+Setup &Setup::setDurability(Durability durability)
+{
+	d->properties.insert(Defaults::Durability, durability);
+	return *this;
+}
+
+Setup &Setup::setCacheCostModel(CacheCostModel cacheCostModel)
+{
+	d->properties.insert(Defaults::CacheCostModel, cacheCostModel);
+	return *this;
+}
+
 Setup &Setup::resetLocalDir()
 {
 	d->localDir = SetupPrivate::DefaultLocalDir;
@@ -390,6 +545,90 @@ Setup &Setup::resetCipherKeySize()
 	return *this;
 }
 
+Setup &Setup::resetInlineDataThreshold()
+{
+	d->properties.insert(Defaults::InlineThreshold, 0);
+	return *this;
+}
+
+Setup &Setup::resetJournalMode()
+{
+	d->properties.insert(Defaults::DbJournalMode, Setup::RollbackJournal);
+	return *this;
+}
+
+Setup &Setup::resetSynchronousMode()
+{
+	d->properties.insert(Defaults::DbSynchronous, Setup::SynchronousFull);
+	return *this;
+}
+
+Setup &Setup::resetMmapSize()
+{
+	d->properties.insert(Defaults::DbMmapSize, 0);
+	return *this;
+}
+
+Setup &Setup::resetDatabaseCacheSize()
+{
+	d->properties.insert(Defaults::DbCacheSize, 0);
+	return *this;
+}
+
+Setup &Setup::resetWalAutoCheckpoint()
+{
+	d->properties.insert(Defaults::DbWalCheckpoint, 1000);
+	return *this;
+}
+
+Setup &Setup::resetAsyncThreadCount()
+{
+	d->properties.insert(Defaults::AsyncThreadCount, QThread::idealThreadCount());
+	return *this;
+}
+
+Setup &Setup::resetStorageEngine()
+{
+	d->properties.insert(Defaults::StorageEngine, Setup::FileStorage);
+	return *this;
+}
+
+Setup &Setup::resetCompressionLevel()
+{
+	d->properties.insert(Defaults::CompressionLevel, 0);
+	return *this;
+}
+
+Setup &Setup::resetCompressionThreshold()
+{
+	d->properties.insert(Defaults::CompressionThreshold, 256);
+	return *this;
+}
+
+Setup &Setup::resetChecksumAlgorithm()
+{
+	d->properties.insert(Defaults::ChecksumAlgorithm, Setup::Sha3Checksum);
+	return *this;
+}
+
+Setup &Setup::resetCoalescingWindow()
+{
+	d->properties.insert(Defaults::CoalescingWindow, 0);
+	return *this;
+}
+
+Setup &Setup::resetDurability()
+{
+	d->properties.insert(Defaults::Durability, Setup::DurabilityFull);
+	return *this;
+}
+
+Setup &Setup::resetCacheCostModel()
+{
+	d->properties.insert(Defaults::CacheCostModel, Setup::StoredSizeCost);
+	return *this;
+}
+
 Setup &Setup::setAccount(const QJsonObject &importData, bool keepData, bool allowFailure)
 {
 	d->initialImport = ExchangeEngine::ImportData {
@@ -433,6 +672,102 @@ Setup &Setup::setAccountTrusted(const QByteArray &importData, const QString &pas
 	}
 }
 
+Setup &Setup::addPropertyIndex(int metaTypeId, const QString &property)
+{
+	auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName) {
+		qCWarning(qdssetup) << "Cannot add property index for invalid type id" << metaTypeId;
+		return *this;
+	}
+
+	auto indexes = d->properties.value(Defaults::PropertyIndexes).toHash();
+	auto typeIndexes = indexes.value(QString::fromUtf8(typeName)).toStringList();
+	if(!typeIndexes.contains(property)) {
+		typeIndexes.append(property);
+		indexes.insert(QString::fromUtf8(typeName), typeIndexes);
+		d->properties.insert(Defaults::PropertyIndexes, indexes);
+	}
+	return *this;
+}
+
+Setup &Setup::addFullTextIndex(int metaTypeId, const QString &property)
+{
+	auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName) {
+		qCWarning(qdssetup) << "Cannot add full text index for invalid type id" << metaTypeId;
+		return *this;
+	}
+
+	auto indexes = d->properties.value(Defaults::FullTextIndexes).toHash();
+	auto typeIndexes = indexes.value(QString::fromUtf8(typeName)).toStringList();
+	if(!typeIndexes.contains(property)) {
+		typeIndexes.append(property);
+		indexes.insert(QString::fromUtf8(typeName), typeIndexes);
+		d->properties.insert(Defaults::FullTextIndexes, indexes);
+	}
+	return *this;
+}
+
+Setup &Setup::deferChecksums(int metaTypeId)
+{
+	auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName) {
+		qCWarning(qdssetup) << "Cannot defer checksums for invalid type id" << metaTypeId;
+		return *this;
+	}
+
+	auto types = d->properties.value(Defaults::DeferredChecksums).toStringList();
+	if(!types.contains(QString::fromUtf8(typeName))) {
+		types.append(QString::fromUtf8(typeName));
+		d->properties.insert(Defaults::DeferredChecksums, types);
+	}
+	return *this;
+}
+
+Setup &Setup::coalesceWrites(int metaTypeId, int window)
+{
+	auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName) {
+		qCWarning(qdssetup) << "Cannot coalesce writes for invalid type id" << metaTypeId;
+		return *this;
+	}
+
+	auto types = d->properties.value(Defaults::CoalescedTypes).toHash();
+	types.insert(QString::fromUtf8(typeName), window);
+	d->properties.insert(Defaults::CoalescedTypes, types);
+	return *this;
+}
+
+Setup &Setup::preload(int metaTypeId, int recentCount)
+{
+	auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName) {
+		qCWarning(qdssetup) << "Cannot preload invalid type id" << metaTypeId;
+		return *this;
+	}
+
+	auto types = d->properties.value(Defaults::PreloadedTypes).toHash();
+	types.insert(QString::fromUtf8(typeName), qMax(recentCount, 0));
+	d->properties.insert(Defaults::PreloadedTypes, types);
+	return *this;
+}
+
+Setup &Setup::serializeDirectly(int metaTypeId)
+{
+	auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName) {
+		qCWarning(qdssetup) << "Cannot serialize invalid type id directly" << metaTypeId;
+		return *this;
+	}
+
+	auto types = d->properties.value(Defaults::DirectSerializedTypes).toStringList();
+	if(!types.contains(QString::fromUtf8(typeName))) {
+		types.append(QString::fromUtf8(typeName));
+		d->properties.insert(Defaults::DirectSerializedTypes, types);
+	}
+	return *this;
+}
+
 void Setup::create(const QString &name)
 {
 	QMutexLocker _(&SetupPrivate::setupMutex);
@@ -602,7 +937,21 @@ SetupPrivate::SetupPrivate() :
 		{Defaults::SslConfiguration, QVariant::fromValue(QSslConfiguration::defaultConfiguration())},
 		{Defaults::SignScheme, Setup::ECDSA_ECP_SHA3_512},
 		{Defaults::CryptScheme, Setup::ECIES_ECP_SHA3_512},
-		{Defaults::SymScheme, Setup::AES_EAX}
+		{Defaults::SymScheme, Setup::AES_EAX},
+		{Defaults::InlineThreshold, 0},
+		{Defaults::DbJournalMode, Setup::RollbackJournal},
+		{Defaults::DbSynchronous, Setup::SynchronousFull},
+		{Defaults::DbMmapSize, 0},
+		{Defaults::DbCacheSize, 0},
+		{Defaults::DbWalCheckpoint, 1000},
+		{Defaults::AsyncThreadCount, QThread::idealThreadCount()},
+		{Defaults::StorageEngine, Setup::FileStorage},
+		{Defaults::CompressionLevel, 0},
+		{Defaults::CompressionThreshold, 256},
+		{Defaults::ChecksumAlgorithm, Setup::Sha3Checksum},
+		{Defaults::CoalescingWindow, 0},
+		{Defaults::Durability, Setup::DurabilityFull},
+		{Defaults::CacheCostModel, Setup::StoredSizeCost}
 		}
 {}
 
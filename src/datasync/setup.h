@@ -95,6 +95,34 @@ class Q_DATASYNC_EXPORT Setup
 	Q_PROPERTY(CipherScheme cipherScheme READ cipherScheme WRITE setCipherScheme RESET resetCipherScheme)
 	//! The size in bytes for the secret exchange key (which is symmetric)
 	Q_PROPERTY(qint32 cipherKeySize READ cipherKeySize WRITE setCipherKeySize RESET resetCipherKeySize) //MAJOR make uint
+	//! The size in bytes up to which datasets are stored inside the database instead of separate files
+	Q_PROPERTY(int inlineDataThreshold READ inlineDataThreshold WRITE setInlineDataThreshold RESET resetInlineDataThreshold)
+	//! The journal mode the local database operates in
+	Q_PROPERTY(JournalMode journalMode READ journalMode WRITE setJournalMode RESET resetJournalMode)
+	//! The level of disk synchronization the local database uses for commits
+	Q_PROPERTY(SynchronousMode synchronousMode READ synchronousMode WRITE setSynchronousMode RESET resetSynchronousMode)
+	//! The maximum number of bytes of the local database that are memory mapped
+	Q_PROPERTY(qint64 mmapSize READ mmapSize WRITE setMmapSize RESET resetMmapSize)
+	//! The size of the page cache of each database connection, in bytes
+	Q_PROPERTY(int databaseCacheSize READ databaseCacheSize WRITE setDatabaseCacheSize RESET resetDatabaseCacheSize)
+	//! The number of pages after which the write ahead log gets checkpointed automatically
+	Q_PROPERTY(int walAutoCheckpoint READ walAutoCheckpoint WRITE setWalAutoCheckpoint RESET resetWalAutoCheckpoint)
+	//! The maximum number of threads used to run the asynchronous store operations
+	Q_PROPERTY(int asyncThreadCount READ asyncThreadCount WRITE setAsyncThreadCount RESET resetAsyncThreadCount)
+	//! The engine used to store the data of datasets that are not kept inline
+	Q_PROPERTY(StorageEngine storageEngine READ storageEngine WRITE setStorageEngine RESET resetStorageEngine)
+	//! The zlib compression level used for stored datasets, or 0 to store them uncompressed
+	Q_PROPERTY(int compressionLevel READ compressionLevel WRITE setCompressionLevel RESET resetCompressionLevel)
+	//! The minimal size of a dataset in bytes to be compressed
+	Q_PROPERTY(int compressionThreshold READ compressionThreshold WRITE setCompressionThreshold RESET resetCompressionThreshold)
+	//! The hash algorithm used to calculate the checksums of stored datasets
+	Q_PROPERTY(ChecksumAlgorithm checksumAlgorithm READ checksumAlgorithm WRITE setChecksumAlgorithm RESET resetChecksumAlgorithm)
+	//! The time in milliseconds in which repeated saves of the same dataset are merged
+	Q_PROPERTY(int coalescingWindow READ coalescingWindow WRITE setCoalescingWindow RESET resetCoalescingWindow)
+	//! Specifies how local writes are synchronized to disk, and if concurrent saves are committed together
+	Q_PROPERTY(Durability durability READ durability WRITE setDurability RESET resetDurability)
+	//! Specifies how the size of cached datasets is calculated for the Setup::cacheSize limit
+	Q_PROPERTY(CacheCostModel cacheCostModel READ cacheCostModel WRITE setCacheCostModel RESET resetCacheCostModel)
 
 public:
 	//! Typedef of an error handler function. See Setup::fatalErrorHandler
@@ -134,6 +162,51 @@ public:
 	};
 	Q_ENUM(CipherScheme)
 
+	//! The journal modes of the local database, see Setup::journalMode
+	enum JournalMode {
+		RollbackJournal, //!< Classic rollback journal. Writers block all readers while committing
+		WriteAheadLog //!< Write ahead log. Readers continue to read the last committed state while a writer is active
+	};
+	Q_ENUM(JournalMode)
+
+	//! The disk synchronization levels of the local database, see Setup::synchronousMode
+	enum SynchronousMode {
+		SynchronousOff, //!< Never wait for data to reach the disk
+		SynchronousNormal, //!< Wait for the disk at the most critical moments only
+		SynchronousFull, //!< Wait for the disk on every commit
+		SynchronousExtra //!< Like SynchronousFull, but also syncs the directory of a removed rollback journal
+	};
+	Q_ENUM(SynchronousMode)
+
+	//! The engines that can be used to store the data of datasets, see Setup::storageEngine
+	enum StorageEngine {
+		FileStorage, //!< One file per dataset
+		PackStorage //!< Datasets are appended to a few large segment files per type
+	};
+	Q_ENUM(StorageEngine)
+
+	//! The algorithms that can be used to calculate checksums of datasets, see Setup::checksumAlgorithm
+	enum ChecksumAlgorithm {
+		Sha3Checksum, //!< SHA3-256, as used by all previous versions
+		Blake2bChecksum //!< BLAKE2b with a 256 bit digest
+	};
+	Q_ENUM(ChecksumAlgorithm)
+
+	//! The durability levels of local writes, see Setup::durability
+	enum Durability {
+		DurabilityFull, //!< Every save is committed on its own, replaced data files are synced to disk
+		DurabilityNormal, //!< Concurrent saves are committed together, syncing the database once per group
+		DurabilityRelaxed //!< Like DurabilityNormal, but data files are never explicitly synced to disk
+	};
+	Q_ENUM(Durability)
+
+	//! The ways to calculate the size of cached datasets, see Setup::cacheCostModel
+	enum CacheCostModel {
+		StoredSizeCost, //!< The size of the encoded data, before compression
+		MemorySizeCost //!< The estimated memory used by the decoded data, including deserialized gadgets
+	};
+	Q_ENUM(CacheCostModel)
+
 	//! Elliptic curves supported as key parameter for Setup::signatureKeyParam and Setup::encryptionKeyParam in case an ECC scheme is used
 	enum EllipticCurve {
 		secp112r1,
@@ -219,6 +292,34 @@ public:
 	CipherScheme cipherScheme() const;
 	//! @readAcFn{Setup::cipherKeySize}
 	qint32 cipherKeySize() const;
+	//! @readAcFn{Setup::inlineDataThreshold}
+	int inlineDataThreshold() const;
+	//! @readAcFn{Setup::journalMode}
+	JournalMode journalMode() const;
+	//! @readAcFn{Setup::synchronousMode}
+	SynchronousMode synchronousMode() const;
+	//! @readAcFn{Setup::mmapSize}
+	qint64 mmapSize() const;
+	//! @readAcFn{Setup::databaseCacheSize}
+	int databaseCacheSize() const;
+	//! @readAcFn{Setup::walAutoCheckpoint}
+	int walAutoCheckpoint() const;
+	//! @readAcFn{Setup::asyncThreadCount}
+	int asyncThreadCount() const;
+	//! @readAcFn{Setup::storageEngine}
+	StorageEngine storageEngine() const;
+	//! @readAcFn{Setup::compressionLevel}
+	int compressionLevel() const;
+	//! @readAcFn{Setup::compressionThreshold}
+	int compressionThreshold() const;
+	//! @readAcFn{Setup::checksumAlgorithm}
+	ChecksumAlgorithm checksumAlgorithm() const;
+	//! @readAcFn{Setup::coalescingWindow}
+	int coalescingWindow() const;
+	//! @readAcFn{Setup::durability}
+	Durability durability() const;
+	//! @readAcFn{Setup::cacheCostModel}
+	CacheCostModel cacheCostModel() const;
 
 	//! @writeAcFn{Setup::localDir}
 	Setup &setLocalDir(QString localDir);
@@ -254,6 +355,34 @@ public:
 	Setup &setCipherScheme(CipherScheme cipherScheme);
 	//! @writeAcFn{Setup::cipherKeySize}
 	Setup &setCipherKeySize(qint32 cipherKeySize);
+	//! @writeAcFn{Setup::inlineDataThreshold}
+	Setup &setInlineDataThreshold(int inlineDataThreshold);
+	//! @writeAcFn{Setup::journalMode}
+	Setup &setJournalMode(JournalMode journalMode);
+	//! @writeAcFn{Setup::synchronousMode}
+	Setup &setSynchronousMode(SynchronousMode synchronousMode);
+	//! @writeAcFn{Setup::mmapSize}
+	Setup &setMmapSize(qint64 mmapSize);
+	//! @writeAcFn{Setup::databaseCacheSize}
+	Setup &setDatabaseCacheSize(int databaseCacheSize);
+	//! @writeAcFn{Setup::walAutoCheckpoint}
+	Setup &setWalAutoCheckpoint(int walAutoCheckpoint);
+	//! @writeAcFn{Setup::asyncThreadCount}
+	Setup &setAsyncThreadCount(int asyncThreadCount);
+	//! @writeAcFn{Setup::storageEngine}
+	Setup &setStorageEngine(StorageEngine storageEngine);
+	//! @writeAcFn{Setup::compressionLevel}
+	Setup &setCompressionLevel(int compressionLevel);
+	//! @writeAcFn{Setup::compressionThreshold}
+	Setup &setCompressionThreshold(int compressionThreshold);
+	//! @writeAcFn{Setup::checksumAlgorithm}
+	Setup &setChecksumAlgorithm(ChecksumAlgorithm checksumAlgorithm);
+	//! @writeAcFn{Setup::coalescingWindow}
+	Setup &setCoalescingWindow(int coalescingWindow);
+	//! @writeAcFn{Setup::durability}
+	Setup &setDurability(Durability durability);
+	//! @writeAcFn{Setup::cacheCostModel}
+	Setup &setCacheCostModel(CacheCostModel cacheCostModel);
 
 	//! @resetAcFn{Setup::localDir}
 	Setup &resetLocalDir();
@@ -289,6 +418,34 @@ public:
 	Setup &resetCipherScheme();
 	//! @resetAcFn{Setup::cipherKeySize}
 	Setup &resetCipherKeySize();
+	//! @resetAcFn{Setup::inlineDataThreshold}
+	Setup &resetInlineDataThreshold();
+	//! @resetAcFn{Setup::journalMode}
+	Setup &resetJournalMode();
+	//! @resetAcFn{Setup::synchronousMode}
+	Setup &resetSynchronousMode();
+	//! @resetAcFn{Setup::mmapSize}
+	Setup &resetMmapSize();
+	//! @resetAcFn{Setup::databaseCacheSize}
+	Setup &resetDatabaseCacheSize();
+	//! @resetAcFn{Setup::walAutoCheckpoint}
+	Setup &resetWalAutoCheckpoint();
+	//! @resetAcFn{Setup::asyncThreadCount}
+	Setup &resetAsyncThreadCount();
+	//! @resetAcFn{Setup::storageEngine}
+	Setup &resetStorageEngine();
+	//! @resetAcFn{Setup::compressionLevel}
+	Setup &resetCompressionLevel();
+	//! @resetAcFn{Setup::compressionThreshold}
+	Setup &resetCompressionThreshold();
+	//! @resetAcFn{Setup::checksumAlgorithm}
+	Setup &resetChecksumAlgorithm();
+	//! @resetAcFn{Setup::coalescingWindow}
+	Setup &resetCoalescingWindow();
+	//! @resetAcFn{Setup::durability}
+	Setup &resetDurability();
+	//! @resetAcFn{Setup::cacheCostModel}
+	Setup &resetCacheCostModel();
 
 	//! Sets an account to be imported on creation of the instance
 	Setup &setAccount(const QJsonObject &importData, bool keepData = false, bool allowFailure = false);
@@ -299,6 +456,37 @@ public:
 	//! @copydoc Setup::setAccountTrusted(const QJsonObject &, const QString &, bool, bool)
 	Setup &setAccountTrusted(const QByteArray &importData, const QString &password, bool keepData = false, bool allowFailure = false);
 
+	//! Adds an index for the given property of the given type, to be used by DataStore::query
+	Setup &addPropertyIndex(int metaTypeId, const QString &property);
+	//! @copybrief Setup::addPropertyIndex(int, const QString &)
+	template <typename T>
+	Setup &addPropertyIndex(const QString &property);
+	//! Adds the given string property of the given type to the full text index of that type
+	Setup &addFullTextIndex(int metaTypeId, const QString &property);
+	//! @copybrief Setup::addFullTextIndex(int, const QString &)
+	template <typename T>
+	Setup &addFullTextIndex(const QString &property);
+	//! Defers the calculation of dataset checksums of the given type until they are needed
+	Setup &deferChecksums(int metaTypeId);
+	//! @copybrief Setup::deferChecksums(int)
+	template <typename T>
+	Setup &deferChecksums();
+	//! Sets the time in which repeated saves of datasets of the given type are merged
+	Setup &coalesceWrites(int metaTypeId, int window);
+	//! @copybrief Setup::coalesceWrites(int, int)
+	template <typename T>
+	Setup &coalesceWrites(int window);
+	//! Loads datasets of the given type into the cache in the background, once the setup was created
+	Setup &preload(int metaTypeId, int recentCount = 0);
+	//! @copybrief Setup::preload(int, int)
+	template <typename T>
+	Setup &preload(int recentCount = 0);
+	//! Converts datasets of the given gadget type directly, without the serializer
+	Setup &serializeDirectly(int metaTypeId);
+	//! @copybrief Setup::serializeDirectly(int)
+	template <typename T>
+	Setup &serializeDirectly();
+
 	//! Creates a datasync instance from this setup with the given name
 	void create(const QString &name = DefaultSetup);
 	//! Creates a passive setup with the given name that connects to the primary datasync instance
@@ -367,6 +555,42 @@ protected:
 
 // ------------- Generic Implementation -------------
 
+template <typename T>
+Setup &Setup::addPropertyIndex(const QString &property)
+{
+	return addPropertyIndex(qMetaTypeId<T>(), property);
+}
+
+template <typename T>
+Setup &Setup::addFullTextIndex(const QString &property)
+{
+	return addFullTextIndex(qMetaTypeId<T>(), property);
+}
+
+template <typename T>
+Setup &Setup::deferChecksums()
+{
+	return deferChecksums(qMetaTypeId<T>());
+}
+
+template <typename T>
+Setup &Setup::coalesceWrites(int window)
+{
+	return coalesceWrites(qMetaTypeId<T>(), window);
+}
+
+template <typename T>
+Setup &Setup::preload(int recentCount)
+{
+	return preload(qMetaTypeId<T>(), recentCount);
+}
+
+template <typename T>
+Setup &Setup::serializeDirectly()
+{
+	return serializeDirectly(qMetaTypeId<T>());
+}
+
 template<typename TRatio>
 Q_DECL_CONSTEXPR inline int ratioBytes(intmax_t value)
 {
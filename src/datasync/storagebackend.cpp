@@ -0,0 +1,129 @@
+#include "storagebackend_p.h"
+#include "datastore.h"
+
+#include <QtCore/QUrl>
+#include <QtCore/QUuid>
+#include <QtCore/QFileInfo>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace QtDataSync;
+using std::function;
+
+#define QTDATASYNC_LOG _logger
+
+QMutex StorageBackend::directoryMutex;
+QSet<QString> StorageBackend::knownDirectories;
+
+StorageBackend::StorageBackend(Defaults defaults, Logger *logger) :
+	_defaults{std::move(defaults)},
+	_logger{logger},
+	_durability{static_cast<Setup::Durability>(_defaults.property(Defaults::Durability).toInt())}
+{}
+
+StorageBackend::~StorageBackend() = default;
+
+QDir StorageBackend::trashDirectory(const Defaults &defaults)
+{
+	return QDir{defaults.storageDir().absoluteFilePath(QStringLiteral("trash"))};
+}
+
+bool StorageBackend::moveToTrash(const Defaults &defaults, const QString &path)
+{
+	forgetDirectories(path);
+	if(!QFileInfo::exists(path))
+		return true;
+
+	auto trashDir = trashDirectory(defaults);
+	if(!trashDir.mkpath(QStringLiteral(".")))
+		return false;
+	auto trashPath = trashDir.absoluteFilePath(QString::fromUtf8(QUuid::createUuid().toRfc4122().toHex()));
+	return QDir{}.rename(path, trashPath);
+}
+
+void StorageBackend::reset(const DatabaseRef &db)
+{
+	Q_UNUSED(db)
+	//the whole store directory gets removed
+	forgetDirectories(_defaults.storageDir().absoluteFilePath(QStringLiteral("store")));
+}
+
+bool StorageBackend::syncToDisk(QFileDevice *file)
+{
+#ifdef Q_OS_WIN
+	return ::_commit(file->handle()) == 0;
+#else
+	return ::fsync(file->handle()) == 0;
+#endif
+}
+
+void StorageBackend::beginGroup() {}
+
+void StorageBackend::endGroup(bool commit)
+{
+	Q_UNUSED(commit)
+}
+
+bool StorageBackend::prefersOrderedReads() const
+{
+	return false;
+}
+
+bool StorageBackend::takeCompactionRequest()
+{
+	return false;
+}
+
+function<void()> StorageBackend::compact(const DatabaseRef &db)
+{
+	Q_UNUSED(db)
+	return {};
+}
+
+QDir StorageBackend::typeDirectory(const QString &prefix, const ObjectKey &key, bool create) const
+{
+	auto encName = QUrl::toPercentEncoding(QString::fromUtf8(key.typeName))
+				   .replace('%', '_');
+	auto tName = QStringLiteral("store/%1_%2").arg(prefix, QString::fromUtf8(encName));
+	QDir tableDir {_defaults.storageDir().absoluteFilePath(tName)};
+	if(create)
+		ensureDirectory(key, tableDir.absolutePath());
+	return tableDir;
+}
+
+void StorageBackend::ensureDirectory(const ObjectKey &key, const QString &path) const
+{
+	QMutexLocker _(&directoryMutex);
+	if(knownDirectories.contains(path))
+		return;
+	if(!QDir().mkpath(path))
+		throw LocalStoreException(_defaults, key, path, QStringLiteral("Failed to create directory"));
+	knownDirectories.insert(path);
+}
+
+void StorageBackend::openFile(const ObjectKey &key, const QString &prefix, const QString &directory, QFileDevice *device, const function<bool()> &openFn) const
+{
+	if(openFn())
+		return;
+
+	forgetDirectories(typeDirectory(prefix, key).absolutePath());
+	ensureDirectory(key, directory);
+	if(!openFn())
+		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+	logDebug() << "Created directory" << directory << "again, after it was removed by another process";
+}
+
+void StorageBackend::forgetDirectories(const QString &path)
+{
+	QMutexLocker _(&directoryMutex);
+	for(auto it = knownDirectories.begin(); it != knownDirectories.end();) {
+		if(*it == path || it->startsWith(path + QLatin1Char('/')))
+			it = knownDirectories.erase(it);
+		else
+			it++;
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef QTDATASYNC_STORAGEBACKEND_P_H
+#define QTDATASYNC_STORAGEBACKEND_P_H
+
+#include <functional>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QDir>
+#include <QtCore/QFileDevice>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+#include "defaults.h"
+#include "logger.h"
+
+namespace QtDataSync {
+
+//no export needed
+class StorageBackend
+{
+	Q_DISABLE_COPY(StorageBackend)
+
+public:
+	struct PendingWrite {
+		QString location;
+		std::function<void()> complete; //last step before the commit, throws on failure
+		std::function<void()> afterCommit; //called after the commit, can be empty
+	};
+
+	StorageBackend(Defaults defaults, Logger *logger);
+	virtual ~StorageBackend();
+
+	//renames the directory into the trash, to be removed by the TrashSweepTask
+	static QDir trashDirectory(const Defaults &defaults);
+	static bool moveToTrash(const Defaults &defaults, const QString &path);
+
+	//the returned data is only valid until the next call to the backend
+	virtual QByteArray read(const ObjectKey &key, const QString &location) = 0;
+	//oldLocation is only set if it belongs to this backend
+	virtual PendingWrite write(const DatabaseRef &db, const ObjectKey &key, const QString &oldLocation, const QByteArray &data) = 0;
+	//the returned function is called after the commit, can be empty
+	virtual std::function<void()> remove(const DatabaseRef &db, const ObjectKey &key, const QString &location) = 0;
+	virtual void clear(const DatabaseRef &db, const QByteArray &typeName) = 0;
+	virtual void reset(const DatabaseRef &db);
+
+	//while grouped, files are synced once per group by endGroup instead of once per write
+	virtual void beginGroup();
+	virtual void endGroup(bool commit); //throws if syncing failed
+
+	virtual bool prefersOrderedReads() const;
+	//returns true once, when compaction became necessary
+	virtual bool takeCompactionRequest();
+	//the returned function is called after the commit, can be empty
+	virtual std::function<void()> compact(const DatabaseRef &db);
+
+protected:
+	Defaults _defaults;
+	Logger *_logger;
+	Setup::Durability _durability;
+
+	static bool syncToDisk(QFileDevice *file);
+	//only creates the directory if requested. Created directories are remembered for the whole process
+	QDir typeDirectory(const QString &prefix, const ObjectKey &key, bool create = false) const;
+	void ensureDirectory(const ObjectKey &key, const QString &path) const;
+	static void forgetDirectories(const QString &path);
+	//another process might have moved the type directory to the trash since it was remembered. A failed open
+	//therefore forgets the directories of the type, creates the directory again and retries once. Throws on failure
+	void openFile(const ObjectKey &key,
+				  const QString &prefix,
+				  const QString &directory,
+				  QFileDevice *device,
+				  const std::function<bool()> &openFn) const;
+
+private:
+	static QMutex directoryMutex;
+	static QSet<QString> knownDirectories;
+};
+
+}
+
+#endif // QTDATASYNC_STORAGEBACKEND_P_H
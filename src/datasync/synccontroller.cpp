@@ -74,7 +74,9 @@ void SyncController::syncChange(quint64 key, const QByteArray &changeData)
 					_store->storeChanged(scope, remoteVersion, localFileName, remoteData, false, localState); //simply update the local data
 					syncActionRes = "remote";
 				} else if(localVersion == remoteVersion) {
-					auto remoteChecksum = SyncHelper::jsonHash(remoteData);
+					//use the algorithm of the stored checksum, so they stay comparable
+					auto checksumAlgorithm = SyncHelper::checksumAlgorithm(localChecksum);
+					auto remoteChecksum = SyncHelper::jsonHash(remoteData, checksumAlgorithm);
 					if(localChecksum != remoteChecksum) { //conflict!
 						QJsonObject resolvedData;
 						auto resolver = defaults().conflictResolver();
@@ -82,6 +84,11 @@ void SyncController::syncChange(quint64 key, const QByteArray &changeData)
 							auto localData = _store->readJson(objKey, localFileName);
 							resolvedData = resolver->resolveConflict(QMetaType::type(objKey.typeName.constData()), localData, remoteData);
 						}
+						//the other device might use a different algorithm -> always decide based on the SHA3 checksums
+						if(resolvedData.isEmpty() && checksumAlgorithm != Setup::Sha3Checksum) {
+							localChecksum = SyncHelper::jsonHash(_store->readJson(objKey, localFileName));
+							remoteChecksum = SyncHelper::jsonHash(remoteData);
+						}
 						//deterministic alg the chooses 1 dataset no matter which one is local
 						if(!resolvedData.isEmpty()) {
 							_store->storeChanged(scope, localVersion + 1ull, localFileName, resolvedData, true, localState); //store as "v2 + 1"
@@ -90,7 +97,7 @@ void SyncController::syncChange(quint64 key, const QByteArray &changeData)
 							_store->updateVersion(scope, localVersion, localVersion + 1ull, true); //keep as "v1 + 1"
 							syncActionRes = "local";
 						} else {
-							_store->storeChanged(scope, remoteVersion + 1ull, localFileName, remoteData, true, localState); //store as "v2 + 1"
+							_store->storeChanged(scope, remoteVersion + 1ull, localFileName, remoteData, true, localState, remoteChecksum); //store as "v2 + 1"
 							syncActionRes = "remote";
 						}
 					} else {//(localChecksum == remoteChecksum): mark unchanged, if it was changed, because same data does not need another upload
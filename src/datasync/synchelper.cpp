@@ -5,6 +5,9 @@
 #include <QtCore/QLocale>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonArray>
+#include <QtCore/QThreadStorage>
+
+#include <cryptopp/blake2.h>
 
 #include "message_p.h"
 
@@ -14,14 +17,50 @@ using std::tuple;
 using std::make_tuple;
 
 namespace {
-void hashNext(QCryptographicHash &hash, const QJsonValue &value);
+
+//checksums of algorithms other than SHA3 are prefixed by a version byte. SHA3 has none, to stay compatible to existing checksums
+const int DigestSize = 32;
+const char Blake2bTag = 0x01;
+
+QThreadStorage<QByteArray> hashBuffers;
+
+void writeNext(QByteArray &buffer, const QJsonValue &value);
+
+}
+
+QByteArray SyncHelper::jsonHash(const QJsonObject &object, Setup::ChecksumAlgorithm algorithm)
+{
+	//serialize into one reused buffer and hash it in one go
+	auto &buffer = hashBuffers.localData();
+	buffer.reserve(1024); //marks the capacity as reserved, so the resize keeps the memory
+	buffer.resize(0);
+	writeNext(buffer, object);
+
+	switch(algorithm) {
+	case Setup::Sha3Checksum:
+		return QCryptographicHash::hash(buffer, QCryptographicHash::Sha3_256);
+	case Setup::Blake2bChecksum:
+	{
+		QByteArray result(1 + DigestSize, Qt::Uninitialized);
+		result[0] = Blake2bTag;
+		CryptoPP::BLAKE2b hash(false, DigestSize);
+		hash.CalculateDigest(reinterpret_cast<unsigned char*>(result.data() + 1),
+							 reinterpret_cast<const unsigned char*>(buffer.constData()),
+							 static_cast<size_t>(buffer.size()));
+		return result;
+	}
+	default:
+		Q_UNREACHABLE();
+		return {};
+	}
 }
 
-QByteArray SyncHelper::jsonHash(const QJsonObject &object)
+Setup::ChecksumAlgorithm SyncHelper::checksumAlgorithm(const QByteArray &checksum)
 {
-	QCryptographicHash hash(QCryptographicHash::Sha3_256);
-	hashNext(hash, object);
-	return hash.result();
+	if(checksum.size() == 1 + DigestSize && checksum[0] == Blake2bTag)
+		return Setup::Blake2bChecksum;
+	else
+		return Setup::Sha3Checksum;
 }
 
 QByteArray SyncHelper::combine(const ObjectKey &key, quint64 version, const QJsonObject &data)
@@ -90,40 +129,60 @@ tuple<bool, ObjectKey, quint64, QJsonObject> SyncHelper::extract(const QByteArra
 
 namespace {
 
-void hashNext(QCryptographicHash &hash, const QJsonValue &value)
+void writeString(QByteArray &buffer, const QString &string)
+{
+	//fast path for plain ascii, which needs no conversion
+	auto offset = buffer.size();
+	buffer.resize(offset + string.size());
+	auto out = buffer.data() + offset;
+	for(const auto &c : string) {
+		if(c.unicode() >= 0x80) {
+			buffer.resize(offset);
+			buffer.append(string.toUtf8());
+			return;
+		}
+		*out++ = static_cast<char>(c.unicode());
+	}
+}
+
+// the written data must stay exactly as it was, as it defines the checksums
+void writeNext(QByteArray &buffer, const QJsonValue &value)
 {
 	switch (value.type()) {
 	case QJsonValue::Null:
-		hash.addData("null");
+		buffer.append("null");
 		break;
 	case QJsonValue::Bool:
-		hash.addData(value.toBool() ? "true" : "false");
+		buffer.append(value.toBool() ? "true" : "false");
 		break;
 	case QJsonValue::Double:
-		hash.addData(QByteArray::number(value.toDouble(), 'g', QLocale::FloatingPointShortest));
+		buffer.append(QByteArray::number(value.toDouble(), 'g', QLocale::FloatingPointShortest));
 		break;
 	case QJsonValue::String:
-		hash.addData(value.toString().toUtf8());
+		writeString(buffer, value.toString());
 		break;
 	case QJsonValue::Array:
-		for(auto v : value.toArray())
-			hashNext(hash, v);
+	{
+		const auto array = value.toArray();
+		for(auto it = array.constBegin(); it != array.constEnd(); it++)
+			writeNext(buffer, *it);
 		break;
+	}
 	case QJsonValue::Object:
 	{
-		auto obj = value.toObject();
+		const auto obj = value.toObject();
 		//helper code to assert the obj iterator is sorted.
 #ifndef QT_NO_DEBUG
 		QString pKey;
 #endif
-		for(auto it = obj.begin(); it != obj.end(); it++) { //if "keys" is sorted, this must be as well
+		for(auto it = obj.constBegin(); it != obj.constEnd(); it++) { //if "keys" is sorted, this must be as well
 #ifndef QT_NO_DEBUG
 			if(!pKey.isNull())
 				Q_ASSERT(pKey < it.key());
 			pKey = it.key();
 #endif
-			hash.addData(it.key().toUtf8());
-			hashNext(hash, it.value());
+			writeString(buffer, it.key());
+			writeNext(buffer, it.value());
 		}
 		break;
 	}
@@ -7,13 +7,15 @@
 
 #include "qtdatasync_global.h"
 #include "objectkey.h"
+#include "setup.h"
 
 namespace QtDataSync {
 
 namespace SyncHelper {
 
 //exports are needed for tests
-Q_DATASYNC_EXPORT QByteArray jsonHash(const QJsonObject &object);
+Q_DATASYNC_EXPORT QByteArray jsonHash(const QJsonObject &object, Setup::ChecksumAlgorithm algorithm = Setup::Sha3Checksum);
+Q_DATASYNC_EXPORT Setup::ChecksumAlgorithm checksumAlgorithm(const QByteArray &checksum);
 
 Q_DATASYNC_EXPORT QByteArray combine(const ObjectKey &key, quint64 version, const QJsonObject &data);
 Q_DATASYNC_EXPORT QByteArray combine(const ObjectKey &key, quint64 version);
@@ -0,0 +1,177 @@
+#include "writebuffer_p.h"
+#include "defaults_p.h"
+#include "localstore_p.h"
+
+#include <QtCore/QTimer>
+
+#include <limits>
+
+using namespace QtDataSync;
+
+const int WriteBuffer::MinRetryDelay = 1000;
+const int WriteBuffer::MaxRetryDelay = 60000;
+
+WriteBuffer::WriteBuffer(QString setupName, QObject *parent) :
+	QObject{parent},
+	_setupName{std::move(setupName)},
+	_size{0},
+	_timer{new QTimer{this}}
+{
+	_clock.start();
+	_timer->setSingleShot(true);
+	connect(_timer, &QTimer::timeout,
+			this, &WriteBuffer::flushDue);
+}
+
+bool WriteBuffer::isEmpty() const
+{
+	return _size.load() == 0;
+}
+
+void WriteBuffer::put(const ObjectKey &key, const QJsonObject &data, int window)
+{
+	auto added = false;
+	{
+		QMutexLocker _(&_mutex);
+		auto it = _entries.find(key);
+		if(it == _entries.end()) {
+			_entries.insert(key, {data, ++_revision, _clock.elapsed() + window});
+			_size.store(_entries.size());
+			added = true;
+		} else {
+			it->data = data;
+			it->revision = ++_revision;
+		}
+	}
+
+	//the timer lives in the thread of the buffer
+	if(added)
+		QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+}
+
+bool WriteBuffer::get(const ObjectKey &key, QJsonObject &data) const
+{
+	QMutexLocker _(&_mutex);
+	auto it = _entries.constFind(key);
+	if(it == _entries.constEnd())
+		return false;
+	data = it->data;
+	return true;
+}
+
+QList<WriteBuffer::Entry> WriteBuffer::pending(bool dueOnly) const
+{
+	QMutexLocker _(&_mutex);
+	auto now = _clock.elapsed();
+	QList<Entry> entries;
+	for(auto it = _entries.constBegin(); it != _entries.constEnd(); it++) {
+		if(!dueOnly || it->deadline <= now)
+			entries.append({it.key(), it->data, it->revision});
+	}
+	return entries;
+}
+
+QList<WriteBuffer::Entry> WriteBuffer::pending(const QByteArray &typeName) const
+{
+	QMutexLocker _(&_mutex);
+	QList<Entry> entries;
+	for(auto it = _entries.constBegin(); it != _entries.constEnd(); it++) {
+		if(it.key().typeName == typeName)
+			entries.append({it.key(), it->data, it->revision});
+	}
+	return entries;
+}
+
+QList<WriteBuffer::Entry> WriteBuffer::pending(const ObjectKey &key) const
+{
+	QMutexLocker _(&_mutex);
+	auto it = _entries.constFind(key);
+	if(it == _entries.constEnd())
+		return {};
+	else
+		return {{key, it->data, it->revision}};
+}
+
+void WriteBuffer::release(const QList<Entry> &entries)
+{
+	QMutexLocker _(&_mutex);
+	for(const auto &entry : entries) {
+		//saved again while being written -> keep the newer data
+		auto it = _entries.find(entry.key);
+		if(it != _entries.end() && it->revision == entry.revision)
+			_entries.erase(it);
+	}
+	_size.store(_entries.size());
+	_retryDelay = 0;
+}
+
+void WriteBuffer::discard(const QByteArray &typeName)
+{
+	QMutexLocker _(&_mutex);
+	if(typeName.isNull())
+		_entries.clear();
+	else {
+		for(auto it = _entries.begin(); it != _entries.end();) {
+			if(it.key().typeName == typeName)
+				it = _entries.erase(it);
+			else
+				it++;
+		}
+	}
+	_size.store(_entries.size());
+}
+
+void WriteBuffer::retryDue()
+{
+	{
+		QMutexLocker _(&_mutex);
+		_retryDelay = qBound(MinRetryDelay, _retryDelay * 2, MaxRetryDelay);
+		auto retry = _clock.elapsed() + _retryDelay;
+		for(auto &slot : _entries)
+			slot.deadline = qMax(slot.deadline, retry);
+	}
+
+	//the timer lives in the thread of the buffer
+	QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+}
+
+QMutex *WriteBuffer::flushMutex()
+{
+	return &_flushMutex;
+}
+
+void WriteBuffer::scheduleFlush()
+{
+	QMutexLocker _(&_mutex);
+	if(_entries.isEmpty())
+		return;
+
+	auto next = std::numeric_limits<qint64>::max();
+	for(const auto &slot : qAsConst(_entries))
+		next = qMin(next, slot.deadline);
+	auto delay = static_cast<int>(qMax<qint64>(0, next - _clock.elapsed()));
+	if(!_timer->isActive() || _timer->remainingTime() > delay)
+		_timer->start(delay);
+}
+
+void WriteBuffer::flushDue()
+{
+	try {
+		WriteFlushTask::schedule(Defaults{DefaultsPrivate::obtainDefaults(_setupName)});
+	} catch(SetupDoesNotExistException &) {
+		//setup is being removed, the engine writes what is left
+	}
+
+	//entries that are not due yet get their own timer
+	auto now = _clock.elapsed();
+	auto next = std::numeric_limits<qint64>::max();
+	{
+		QMutexLocker _(&_mutex);
+		for(const auto &slot : qAsConst(_entries)) {
+			if(slot.deadline > now)
+				next = qMin(next, slot.deadline);
+		}
+	}
+	if(next != std::numeric_limits<qint64>::max())
+		_timer->start(static_cast<int>(next - now));
+}
@@ -0,0 +1,76 @@
+#ifndef QTDATASYNC_WRITEBUFFER_P_H
+#define QTDATASYNC_WRITEBUFFER_P_H
+
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QJsonObject>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QAtomicInteger>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+
+class QTimer;
+
+namespace QtDataSync {
+
+//no export needed
+class WriteBuffer : public QObject
+{
+	Q_OBJECT
+
+public:
+	static const int MinRetryDelay;
+	static const int MaxRetryDelay;
+
+	struct Entry {
+		ObjectKey key;
+		QJsonObject data;
+		quint64 revision;
+	};
+
+	explicit WriteBuffer(QString setupName, QObject *parent = nullptr);
+
+	bool isEmpty() const;
+	//the window starts with the first save of a key, later saves only replace the data
+	void put(const ObjectKey &key, const QJsonObject &data, int window);
+	bool get(const ObjectKey &key, QJsonObject &data) const;
+
+	//entries stay readable until they are released after being written. Must only be called with the flush mutex locked
+	QList<Entry> pending(bool dueOnly = false) const;
+	QList<Entry> pending(const QByteArray &typeName) const;
+	QList<Entry> pending(const ObjectKey &key) const;
+	void release(const QList<Entry> &entries);
+	void discard(const QByteArray &typeName = {});
+	//called after a flush failed: due entries are tried again after a delay, which doubles with every failure in a row
+	void retryDue();
+
+	//serializes writing the entries, must be locked before any database transaction is started
+	QMutex *flushMutex();
+
+private Q_SLOTS:
+	void scheduleFlush();
+	void flushDue();
+
+private:
+	struct Slot {
+		QJsonObject data;
+		quint64 revision;
+		qint64 deadline;
+	};
+
+	const QString _setupName;
+	mutable QMutex _mutex;
+	QHash<ObjectKey, Slot> _entries;
+	QAtomicInteger<int> _size;
+	quint64 _revision = 0;
+	int _retryDelay = 0;
+	QElapsedTimer _clock;
+	QTimer *_timer;
+	QMutex _flushMutex;
+};
+
+}
+
+#endif // QTDATASYNC_WRITEBUFFER_P_H
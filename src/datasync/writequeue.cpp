@@ -0,0 +1,54 @@
+#include "writequeue_p.h"
+using namespace QtDataSync;
+using std::function;
+
+WriteQueue::WriteQueue() = default;
+
+void WriteQueue::save(const ObjectKey &key, const QJsonObject &data, const GroupWriter &writer)
+{
+	Request request;
+	request.key = key;
+	request.data = data;
+
+	QMutexLocker locker(&_mutex);
+	_pending.append(&request);
+	while(!request.done) {
+		if(_writing) {
+			_condition.wait(&_mutex);
+			continue;
+		}
+
+		//no one is writing -> this thread writes everything queued so far, including the own request
+		_writing = true;
+		auto group = _pending;
+		_pending.clear();
+		locker.unlock();
+
+		function<void()> completeFn;
+		try {
+			completeFn = writer(group);
+		} catch(QException &e) {
+			for(auto groupRequest : group)
+				groupRequest->error.reset(e.clone());
+		} catch(...) {
+			for(auto groupRequest : group)
+				groupRequest->error.reset(new QUnhandledException{});
+		}
+
+		locker.relock();
+		for(auto groupRequest : group)
+			groupRequest->done = true;
+		_writing = false;
+		_condition.wakeAll();
+
+		//signals are emitted without the queue being blocked, as receivers might save again
+		locker.unlock();
+		if(completeFn)
+			completeFn();
+		locker.relock();
+	}
+	locker.unlock();
+
+	if(request.error)
+		request.error->raise();
+}
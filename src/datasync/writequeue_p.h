@@ -0,0 +1,48 @@
+#ifndef QTDATASYNC_WRITEQUEUE_P_H
+#define QTDATASYNC_WRITEQUEUE_P_H
+
+#include <functional>
+
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QList>
+#include <QtCore/qexception.h>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+
+namespace QtDataSync {
+
+//no export needed
+class WriteQueue
+{
+	Q_DISABLE_COPY(WriteQueue)
+
+public:
+	struct Request {
+		ObjectKey key;
+		QJsonObject data;
+		QSharedPointer<QException> error; //set by the writer, if saving this request failed
+		bool done = false;
+	};
+
+	//writes the group in one transaction and returns what to do after the group was released
+	using GroupWriter = std::function<std::function<void()>(const QList<Request*> &)>;
+
+	WriteQueue();
+
+	//blocks until the data was committed, either by this thread or by the one writing the group it was added to
+	void save(const ObjectKey &key, const QJsonObject &data, const GroupWriter &writer);
+
+private:
+	QMutex _mutex;
+	QWaitCondition _condition;
+	QList<Request*> _pending;
+	bool _writing = false;
+};
+
+}
+
+#endif // QTDATASYNC_WRITEQUEUE_P_H
@@ -230,12 +230,13 @@ void TestChangeController::testDeviceChanges()
 		QCOMPARE(store->changeCount(), 3u);
 		QCOMPARE(incrementSpy.size(), 2);
 
-		change = deviceChangeSpy.takeFirst();
+		//completed out of order: the device cursor waits for the gap to close
+		change = deviceChangeSpy.takeLast();
 		keyHash = change[0].toByteArray();
 		controller->deviceUploadDone(keyHash, devId);
 		QCOMPARE(changeSpy.size(), 0);
 		QCOMPARE(deviceChangeSpy.size(), 2);
-		QCOMPARE(store->changeCount(), 2u);
+		QCOMPARE(store->changeCount(), 3u);
 		QCOMPARE(incrementSpy.size(), 3);
 
 		change = deviceChangeSpy.takeFirst();
@@ -243,7 +244,7 @@ void TestChangeController::testDeviceChanges()
 		controller->deviceUploadDone(keyHash, devId);
 		QCOMPARE(changeSpy.size(), 0);
 		QCOMPARE(deviceChangeSpy.size(), 1);
-		QCOMPARE(store->changeCount(), 1u);
+		QCOMPARE(store->changeCount(), 2u);
 		QCOMPARE(incrementSpy.size(), 4);
 
 		change = deviceChangeSpy.takeFirst();
@@ -3,8 +3,24 @@
 #include <QCoreApplication>
 #include <testlib.h>
 #include <testobject.h>
+#include <QtDataSync/private/defaults_p.h>
+#include <QtDataSync/private/gadgetserializer_p.h>
 using namespace QtDataSync;
 
+class ComplexData
+{
+	Q_GADGET
+
+	Q_PROPERTY(int id MEMBER id USER true)
+	Q_PROPERTY(QDateTime stamp MEMBER stamp)
+
+public:
+	int id = 0;
+	QDateTime stamp;
+};
+
+Q_DECLARE_METATYPE(ComplexData)
+
 class TestDataStore : public QObject
 {
 	Q_OBJECT
@@ -22,6 +38,10 @@ private Q_SLOTS:
 	void testRemove_data();
 	void testRemove();
 	void testClear();
+	void testSaveAll();
+	void testTryLoad();
+	void testGadgetSerializer();
+	void testAsync();
 
 	void testUpdate();
 	void testUpdateInvalid();
@@ -42,6 +62,7 @@ void TestDataStore::initTestCase()
 		TestLib::init();
 		Setup setup;
 		TestLib::setup(setup);
+		setup.serializeDirectly<TestData>();
 		setup.create();
 
 		store = new DataStore(this);
@@ -170,6 +191,128 @@ void TestDataStore::testClear()
 	}
 }
 
+void TestDataStore::testTryLoad()
+{
+	try {
+		store->save(TestLib::generateData(460));
+		TestData data;
+		QVERIFY(store->contains<TestData>(460));
+		QVERIFY(store->tryLoad<TestData>(460, data));
+		QCOMPARE(data, TestLib::generateData(460));
+
+		QVERIFY(!store->contains<TestData>(461));
+		QVERIFY(!store->tryLoad<TestData>(461, data));
+		QCOMPARE(data, TestLib::generateData(460));
+
+		QVERIFY(store->remove<TestData>(460));
+		QVERIFY(!store->contains<TestData>(460));
+		QVERIFY(!store->tryLoad<TestData>(460, data));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testGadgetSerializer()
+{
+	try {
+		auto direct = GadgetSerializer::forType(qMetaTypeId<TestData>());
+		QVERIFY(direct);
+		QCOMPARE(GadgetSerializer::forType(qMetaTypeId<TestData>()), direct);
+		QVERIFY(!GadgetSerializer::forType(qMetaTypeId<ComplexData>()));
+		QVERIFY(!GadgetSerializer::forType(qMetaTypeId<TestObject*>()));
+		QVERIFY(!GadgetSerializer::forType(QMetaType::QString));
+
+		//creates the same json as the serializer
+		auto serializer = Defaults{DefaultsPrivate::obtainDefaults(DefaultSetup)}.serializer();
+		auto data = TestLib::generateData(470);
+		QCOMPARE(direct->key(&data), QStringLiteral("470"));
+		auto json = direct->serialize(&data);
+		QCOMPARE(json, serializer->serialize(QVariant::fromValue(data)).toObject());
+
+		TestData result;
+		QVERIFY(direct->deserialize(json, &result));
+		QCOMPARE(result, data);
+
+		//anything else is left to the serializer
+		auto other = json;
+		other[QStringLiteral("id")] = QStringLiteral("470");
+		QVERIFY(!direct->deserialize(other, &result));
+		other = json;
+		other[QStringLiteral("id")] = 4.5;
+		QVERIFY(!direct->deserialize(other, &result));
+		other = json;
+		other.remove(QStringLiteral("text"));
+		QVERIFY(!direct->deserialize(other, &result));
+		other = json;
+		other[QStringLiteral("extra")] = true;
+		QVERIFY(!direct->deserialize(other, &result));
+
+		//both paths are used by the store, TestData was registered for direct serialization
+		store->save(data);
+		QCOMPARE(store->load<TestData>(470), data);
+		ComplexData complex;
+		complex.id = 471;
+		complex.stamp = QDateTime{QDate{2018, 6, 1}, QTime{12, 30}, Qt::UTC};
+		store->save(complex);
+		QCOMPARE(store->load<ComplexData>(471).stamp, complex.stamp);
+		store->clear<ComplexData>();
+		QVERIFY(store->remove<TestData>(470));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testSaveAll()
+{
+	const auto data = TestLib::generateData(310, 314);
+
+	try {
+		store->saveAll(data);
+		QCOMPARE(store->count<TestData>(), 5ull);
+		QCOMPAREUNORDERED(store->loadAll<TestData>(), data);
+		store->clear<TestData>();
+		QCOMPARE(store->count<TestData>(), 0ull);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testAsync()
+{
+	const auto data = TestLib::generateData(600, 609);
+
+	try {
+		//save from the pool
+		QList<QFuture<void>> saves;
+		for(const auto &value : data)
+			saves.append(store->saveAsync(value));
+		for(auto &future : saves)
+			future.waitForFinished();
+
+		//load back
+		QCOMPARE(store->loadAsync<TestData>(QStringLiteral("600")).result(), data.first());
+		QCOMPAREUNORDERED(store->searchAsync<TestData>(QStringLiteral("60?"), DataStore::WildcardMode).results(), data);
+
+		//streamed in chunks
+		auto allFuture = store->loadAllAsync<TestData>(3);
+		QCOMPAREUNORDERED(allFuture.results(), store->loadAll<TestData>());
+		QCOMPARE(allFuture.resultCount(), static_cast<int>(store->count<TestData>()));
+
+		//exceptions are passed to the future
+		auto missingFuture = store->loadAsync<TestData>(QStringLiteral("700"));
+		QVERIFY_EXCEPTION_THROWN(missingFuture.waitForFinished(), NoDataException);
+
+		//remove
+		QCOMPARE(store->removeAsync<TestData>(QStringLiteral("600")).result(), true);
+		QCOMPARE(store->removeAsync<TestData>(QStringLiteral("600")).result(), false);
+		QVERIFY_EXCEPTION_THROWN(store->load<TestData>(600), NoDataException);
+		for(const auto &value : data)
+			store->remove<TestData>(value.id);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 void TestDataStore::testUpdate()
 {
 	auto dataObj = new TestObject(this);
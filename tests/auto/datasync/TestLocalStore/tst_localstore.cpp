@@ -2,9 +2,15 @@
 #include <QtTest>
 #include <QCoreApplication>
 #include <QtConcurrent>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
 #include <testlib.h>
 #include <QtDataSync/private/localstore_p.h>
 #include <QtDataSync/private/defaults_p.h>
+#include <QtDataSync/private/synchelper_p.h>
+#include <QtDataSync/private/objectcache_p.h>
+#include <QtDataSync/private/recordcodec_p.h>
 using namespace QtDataSync;
 
 class TestLocalStore : public QObject
@@ -25,6 +31,8 @@ private Q_SLOTS:
 	void testRemove_data();
 	void testRemove();
 	void testClear();
+	void testSaveBatch();
+	void testIterate();
 
 	//change access
 	void testChangeLoading();
@@ -39,9 +47,36 @@ private Q_SLOTS:
 	void testChangeSignals();
 	void testAsync();
 	void testPassiveSetup();
+	void testInlineData();
+	void testWalMode();
+	void testPropertyIndex();
+	void testFullTextSearch();
+	void testPackStorage();
+	void testCompression();
+	void testChecksums();
+	void testShardedLayout();
+	void testStatistics();
+	void testChangeSequence();
+	void testTrashSweep();
+	void testWriteCoalescing();
+	void testGroupCommit_data();
+	void testGroupCommit();
+	void testObjectCache();
+	void testCacheStatistics();
+	void testPreload();
+	void testKeyFilter();
+	void testRecordFormat();
+	void benchmarkCacheContention_data();
+	void benchmarkCacheContention();
+	void benchmarkRecordFormat_data();
+	void benchmarkRecordFormat();
 
 private:
 	LocalStore *store;
+
+	Defaults createSetup(const QString &name, const std::function<void(Setup&)> &configure = {});
+	void removeSetup(const QString &name);
+	static QFileInfoList dataFiles(const QDir &typeDir);
 };
 
 void TestLocalStore::initTestCase()
@@ -234,6 +269,91 @@ void TestLocalStore::testClear()
 	}
 }
 
+void TestLocalStore::testSaveBatch()
+{
+	QSignalSpy changeSpy(store, &LocalStore::dataChanged);
+
+	const auto objects = TestLib::generateDataJson(310, 314);
+	QList<QPair<QString, QJsonObject>> data;
+	QStringList keys;
+	for(auto it = objects.constBegin(); it != objects.constEnd(); it++) {
+		data.append({it.key().id, it.value()});
+		keys.append(it.key().id);
+	}
+
+	try {
+		store->saveBatch(TestLib::TypeName, data);
+		QCOMPARE(store->count(TestLib::TypeName), 5ull);
+		QCOMPAREUNORDERED(store->keys(TestLib::TypeName), keys);
+		QCOMPAREUNORDERED(store->loadAll(TestLib::TypeName), objects.values());
+		QCOMPARE(changeSpy.count(), 5);
+		for(const auto &sig : changeSpy) {
+			QCOMPARE(sig[0].value<ObjectKey>().typeName, TestLib::TypeName);
+			QCOMPARE(sig[1].toBool(), false);
+		}
+
+		//overwrite one existing and add one new dataset
+		changeSpy.clear();
+		auto changed = objects.value(TestLib::generateKey(312));
+		changed.insert(QStringLiteral("baum"), 42);
+		store->saveBatch(TestLib::TypeName, {
+							 {QStringLiteral("312"), changed},
+							 {QStringLiteral("315"), TestLib::generateDataJson(315)}
+						 });
+		QCOMPARE(store->count(TestLib::TypeName), 6ull);
+		QCOMPARE(store->load(TestLib::generateKey(312)), changed);
+		QCOMPARE(store->load(TestLib::generateKey(315)), TestLib::generateDataJson(315));
+		QCOMPARE(changeSpy.count(), 2);
+
+		store->reset(false);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testIterate()
+{
+	const auto objects = TestLib::generateDataJson(100, 349);
+	QList<QPair<QString, QJsonObject>> data;
+	for(auto it = objects.constBegin(); it != objects.constEnd(); it++)
+		data.append({it.key().id, it.value()});
+
+	try {
+		store->reset(false);
+		store->saveBatch(TestLib::TypeName, data);
+
+		//iterate all, in pages
+		QStringList keys;
+		store->iterate(TestLib::TypeName, 100, false, [&](const QString &key, const QJsonObject &json) {
+			keys.append(key);
+			return json == objects.value({TestLib::TypeName, key});
+		});
+		QCOMPARE(keys.size(), objects.size());
+		auto sortedKeys = keys;
+		std::sort(sortedKeys.begin(), sortedKeys.end());
+		QCOMPARE(keys, sortedKeys);
+
+		//abort after the first page boundary
+		auto cnt = 0;
+		store->iterate(TestLib::TypeName, 20, false, [&](const QString &, const QJsonObject &) {
+			return ++cnt < 30;
+		});
+		QCOMPARE(cnt, 30);
+
+		//modifying the store while iterating
+		cnt = 0;
+		store->iterate(TestLib::TypeName, 50, false, [&](const QString &key, const QJsonObject &) {
+			store->remove({TestLib::TypeName, key});
+			cnt++;
+			return true;
+		});
+		QCOMPARE(cnt, objects.size());
+		QCOMPARE(store->count(TestLib::TypeName), 0ull);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 void TestLocalStore::testChangeLoading()
 {
 	try {
@@ -364,14 +484,30 @@ void TestLocalStore::testDeviceChanges()
 			return true;
 		});
 
-		store->removeDeviceChange(TestLib::generateKey(42), QUuid::createUuid());
+		store->completeDeviceChanges(TestLib::generateKey(42), QUuid::createUuid());
 		QCOMPARE(store->changeCount(), 2u);
-		store->removeDeviceChange(TestLib::generateKey(42), devId);
+		store->completeDeviceChanges(TestLib::generateKey(42), devId);
 		QCOMPARE(store->changeCount(), 1u);
 		store->remove(TestLib::generateKey(43));
 		QCOMPARE(store->changeCount(), 1u);
 		store->markUnchanged(TestLib::generateKey(43), 2, true);
 		QCOMPARE(store->changeCount(), 0u);
+
+		//datasets saved after the grant are only uploaded as normal changes
+		store->prepareAccountAdded(devId);
+		store->save(TestLib::generateKey(44), TestLib::generateDataJson(44));
+		QCOMPARE(store->changeCount(), 2u);
+		QList<ObjectKey> deviceKeys;
+		store->loadChanges(10, [&](ObjectKey k, quint64, QString, QUuid d) {
+			if(!d.isNull())
+				deviceKeys.append(k);
+			return true;
+		});
+		QCOMPARE(deviceKeys, QList<ObjectKey>{TestLib::generateKey(42)});
+		store->completeDeviceChanges(TestLib::generateKey(42), devId);
+		QCOMPARE(store->changeCount(), 1u);
+		store->markUnchanged(TestLib::generateKey(44), 1, false);
+		QCOMPARE(store->changeCount(), 0u);
 	} catch(QException &e) {
 		QFAIL(e.what());
 	}
@@ -709,6 +845,1130 @@ void TestLocalStore::testPassiveSetup()
 	}
 }
 
+void TestLocalStore::testInlineData()
+{
+	const auto smallKey = TestLib::generateKey(80);
+	const auto smallData = TestLib::generateDataJson(80);
+	const auto largeKey = TestLib::generateKey(81);
+	const auto largeData = TestLib::generateDataJson(81, QString(2048, QLatin1Char('x')));
+
+	try {
+		auto nName = QStringLiteral("inline");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setInlineDataThreshold(KB(1));
+			});
+			LocalStore inlineStore(defaults);
+			auto typeDir = defaults.storageDir();
+
+			//only the large dataset gets a file
+			inlineStore.save(smallKey, smallData);
+			inlineStore.save(largeKey, largeData);
+			QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+			QCOMPARE(dataFiles(typeDir).size(), 1);
+
+			QCOMPARE(inlineStore.load(smallKey), smallData);
+			QCOMPARE(inlineStore.load(largeKey), largeData);
+			QCOMPAREUNORDERED(inlineStore.loadAll(TestLib::TypeName), QList<QJsonObject>({smallData, largeData}));
+			QCOMPAREUNORDERED(inlineStore.find(TestLib::TypeName, QStringLiteral("8*"), DataStore::WildcardMode), QList<QJsonObject>({smallData, largeData}));
+
+			//swap sizes: datasets move between file and database
+			const auto grownData = TestLib::generateDataJson(80, QString(2048, QLatin1Char('y')));
+			const auto shrunkData = TestLib::generateDataJson(81);
+			inlineStore.save(smallKey, grownData);
+			QCOMPARE(dataFiles(typeDir).size(), 2);
+			inlineStore.save(largeKey, shrunkData);
+			QCOMPARE(dataFiles(typeDir).size(), 1);
+			QCOMPARE(inlineStore.load(smallKey), grownData);
+			QCOMPARE(inlineStore.load(largeKey), shrunkData);
+
+			//remove both
+			QVERIFY(inlineStore.remove(smallKey));
+			QVERIFY(inlineStore.remove(largeKey));
+			QCOMPARE(dataFiles(typeDir).size(), 0);
+			QCOMPARE(inlineStore.count(TestLib::TypeName), 0ull);
+			QVERIFY_EXCEPTION_THROWN(inlineStore.load(largeKey), NoDataException);
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testWalMode()
+{
+	const auto key = TestLib::generateKey(82);
+	const auto data = TestLib::generateDataJson(82);
+
+	try {
+		auto nName = QStringLiteral("wal");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setJournalMode(Setup::WriteAheadLog)
+						.setSynchronousMode(Setup::SynchronousNormal);
+			});
+			LocalStore walStore(defaults);
+			walStore.save(key, data);
+
+			auto database = defaults.aquireDatabase(this);
+			QSqlQuery modeQuery(database);
+			QVERIFY(modeQuery.exec(QStringLiteral("PRAGMA journal_mode")));
+			QVERIFY(modeQuery.first());
+			QCOMPARE(modeQuery.value(0).toString().toLower(), QStringLiteral("wal"));
+
+			//block the database for writers, readers must still pass
+			QSqlQuery lockQuery(database);
+			QVERIFY(lockQuery.exec(QStringLiteral("BEGIN EXCLUSIVE TRANSACTION")));
+			auto future = QtConcurrent::run([&](){
+				LocalStore readStore(defaults);
+				return readStore.load(key);
+			});
+			QCOMPARE(future.result(), data);
+			QVERIFY(database->rollback());
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testPropertyIndex()
+{
+	try {
+		auto nName = QStringLiteral("index");
+
+		//store data before the index exists
+		{
+			LocalStore plainStore(createSetup(nName));
+			plainStore.save(TestLib::generateKey(90), TestLib::generateDataJson(90, QStringLiteral("alpha")));
+			plainStore.save(TestLib::generateKey(91), TestLib::generateDataJson(91, QStringLiteral("beta")));
+			QVERIFY_EXCEPTION_THROWN(plainStore.query(TestLib::TypeName, QStringLiteral("text"), DataStore::EqualTo, QStringLiteral("alpha")),
+									 InvalidDataException);
+		}
+		removeSetup(nName);
+
+		//recreate with indexes -> existing data gets indexed
+		{
+			LocalStore indexStore(createSetup(nName, [](Setup &setup) {
+				setup.addPropertyIndex<TestData>(QStringLiteral("id"))
+						.addPropertyIndex<TestData>(QStringLiteral("text"));
+			}));
+			QCOMPARE(indexStore.query(TestLib::TypeName, QStringLiteral("text"), DataStore::EqualTo, QStringLiteral("alpha")),
+					 QList<QJsonObject>({TestLib::generateDataJson(90, QStringLiteral("alpha"))}));
+			QCOMPARE(indexStore.query(TestLib::TypeName, QStringLiteral("id"), DataStore::GreaterThan, 90),
+					 QList<QJsonObject>({TestLib::generateDataJson(91, QStringLiteral("beta"))}));
+
+			//new and updated data
+			indexStore.save(TestLib::generateKey(92), TestLib::generateDataJson(92, QStringLiteral("alpha")));
+			indexStore.save(TestLib::generateKey(90), TestLib::generateDataJson(90, QStringLiteral("gamma")));
+			QCOMPARE(indexStore.query(TestLib::TypeName, QStringLiteral("text"), DataStore::EqualTo, QStringLiteral("alpha")),
+					 QList<QJsonObject>({TestLib::generateDataJson(92, QStringLiteral("alpha"))}));
+			QCOMPAREUNORDERED(indexStore.query(TestLib::TypeName, QStringLiteral("id"), DataStore::LessOrEqual, 91),
+							  QList<QJsonObject>({
+												TestLib::generateDataJson(90, QStringLiteral("gamma")),
+												TestLib::generateDataJson(91, QStringLiteral("beta"))
+											}));
+			QCOMPAREUNORDERED(indexStore.query(TestLib::TypeName, QStringLiteral("text"), DataStore::NotEqualTo, QStringLiteral("beta")),
+							  QList<QJsonObject>({
+												TestLib::generateDataJson(90, QStringLiteral("gamma")),
+												TestLib::generateDataJson(92, QStringLiteral("alpha"))
+											}));
+			//different types never match
+			QVERIFY(indexStore.query(TestLib::TypeName, QStringLiteral("text"), DataStore::GreaterThan, 0).isEmpty());
+
+			//removed data
+			QVERIFY(indexStore.remove(TestLib::generateKey(92)));
+			QVERIFY(indexStore.query(TestLib::TypeName, QStringLiteral("text"), DataStore::EqualTo, QStringLiteral("alpha")).isEmpty());
+
+			//cleared data
+			indexStore.clear(TestLib::TypeName);
+			QVERIFY(indexStore.query(TestLib::TypeName, QStringLiteral("id"), DataStore::GreaterOrEqual, 0).isEmpty());
+
+			//reset data
+			indexStore.save(TestLib::generateKey(93), TestLib::generateDataJson(93));
+			QCOMPARE(indexStore.query(TestLib::TypeName, QStringLiteral("id"), DataStore::EqualTo, 93).size(), 1);
+			indexStore.reset(false);
+			QVERIFY(indexStore.query(TestLib::TypeName, QStringLiteral("id"), DataStore::EqualTo, 93).isEmpty());
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testFullTextSearch()
+{
+	const auto data0 = TestLib::generateDataJson(95, QStringLiteral("The quick brown fox"));
+	const auto data1 = TestLib::generateDataJson(96, QStringLiteral("jumps over the lazy dog"));
+	const auto data2 = TestLib::generateDataJson(97, QStringLiteral("a fox, a fox, a quick fox"));
+
+	try {
+		auto nName = QStringLiteral("fulltext");
+		{
+			LocalStore textStore(createSetup(nName, [](Setup &setup) {
+				setup.addFullTextIndex<TestData>(QStringLiteral("text"));
+			}));
+			textStore.save(TestLib::generateKey(95), data0);
+			textStore.save(TestLib::generateKey(96), data1);
+			textStore.save(TestLib::generateKey(97), data2);
+
+			//ranked results: more occurences first
+			QCOMPARE(textStore.find(TestLib::TypeName, QStringLiteral("fox"), DataStore::FullTextMode),
+					 QList<QJsonObject>({data2, data0}));
+			QCOMPARE(textStore.find(TestLib::TypeName, QStringLiteral("laz*"), DataStore::FullTextMode),
+					 QList<QJsonObject>({data1}));
+			QCOMPARE(textStore.find(TestLib::TypeName, QStringLiteral("quick AND brown"), DataStore::FullTextMode),
+					 QList<QJsonObject>({data0}));
+			QVERIFY(textStore.find(TestLib::TypeName, QStringLiteral("cat"), DataStore::FullTextMode).isEmpty());
+
+			//updated and removed data
+			const auto data3 = TestLib::generateDataJson(95, QStringLiteral("a lazy cat"));
+			textStore.save(TestLib::generateKey(95), data3);
+			QCOMPARE(textStore.find(TestLib::TypeName, QStringLiteral("fox"), DataStore::FullTextMode),
+					 QList<QJsonObject>({data2}));
+			QCOMPAREUNORDERED(textStore.find(TestLib::TypeName, QStringLiteral("lazy"), DataStore::FullTextMode),
+							  QList<QJsonObject>({data1, data3}));
+			QVERIFY(textStore.remove(TestLib::generateKey(96)));
+			QCOMPARE(textStore.find(TestLib::TypeName, QStringLiteral("lazy"), DataStore::FullTextMode),
+					 QList<QJsonObject>({data3}));
+
+			//cleared data
+			textStore.clear(TestLib::TypeName);
+			QVERIFY(textStore.find(TestLib::TypeName, QStringLiteral("fox OR cat"), DataStore::FullTextMode).isEmpty());
+
+			//not indexed
+			QVERIFY_EXCEPTION_THROWN(textStore.find("OtherType", QStringLiteral("fox"), DataStore::FullTextMode), InvalidDataException);
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testPackStorage()
+{
+	const auto data0 = TestLib::generateDataJson(100);
+	const auto data1 = TestLib::generateDataJson(101);
+	const auto data2 = TestLib::generateDataJson(102, QString(2048, QLatin1Char('x')));
+
+	try {
+		auto nName = QStringLiteral("pack");
+
+		//store everything in segments
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setStorageEngine(Setup::PackStorage);
+			});
+			LocalStore packStore(defaults);
+			packStore.save(TestLib::generateKey(100), data0);
+			packStore.save(TestLib::generateKey(101), data1);
+			packStore.save(TestLib::generateKey(102), data2);
+
+			auto storeDir = defaults.storageDir();
+			QVERIFY(storeDir.cd(QStringLiteral("store")));
+			QVERIFY(!storeDir.exists(QStringLiteral("data_TestData")));
+			QVERIFY(storeDir.cd(QStringLiteral("pack_TestData")));
+			QCOMPARE(storeDir.entryList(QDir::Files).size(), 1);
+
+			QCOMPARE(packStore.load(TestLib::generateKey(100)), data0);
+			QCOMPARE(packStore.load(TestLib::generateKey(102)), data2);
+			QCOMPAREUNORDERED(packStore.loadAll(TestLib::TypeName), QList<QJsonObject>({data0, data1, data2}));
+
+			//updated and removed data
+			const auto data3 = TestLib::generateDataJson(100, QStringLiteral("updated"));
+			packStore.save(TestLib::generateKey(100), data3);
+			QCOMPARE(packStore.load(TestLib::generateKey(100)), data3);
+			QVERIFY(packStore.remove(TestLib::generateKey(101)));
+			QVERIFY_EXCEPTION_THROWN(packStore.load(TestLib::generateKey(101)), NoDataException);
+
+			//compaction keeps the live data
+			packStore.compactStorage();
+			QCOMPAREUNORDERED(packStore.loadAll(TestLib::TypeName), QList<QJsonObject>({data3, data2}));
+		}
+		removeSetup(nName);
+
+		//switch back to files -> existing data stays readable and moves on save
+		{
+			auto defaults = createSetup(nName);
+			LocalStore fileStore(defaults);
+			QCOMPARE(fileStore.load(TestLib::generateKey(102)), data2);
+			fileStore.save(TestLib::generateKey(102), data1);
+			QCOMPARE(fileStore.load(TestLib::generateKey(102)), data1);
+
+			auto typeDir = defaults.storageDir();
+			QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+			QCOMPARE(dataFiles(typeDir).size(), 1);
+			QCOMPARE(fileStore.count(TestLib::TypeName), 2ull);
+
+			fileStore.clear(TestLib::TypeName);
+			QCOMPARE(fileStore.count(TestLib::TypeName), 0ull);
+			QVERIFY(!defaults.storageDir().exists(QStringLiteral("store/pack_TestData")));
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testCompression()
+{
+	const auto smallKey = TestLib::generateKey(105);
+	const auto smallData = TestLib::generateDataJson(105);
+	const auto largeKey = TestLib::generateKey(106);
+	const auto largeData = TestLib::generateDataJson(106, QString(4096, QLatin1Char('x')));
+
+	try {
+		auto nName = QStringLiteral("compression");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setCompressionLevel(9)
+						.setCompressionThreshold(1024);
+			});
+			LocalStore compressStore(defaults);
+			compressStore.save(smallKey, smallData);
+			compressStore.save(largeKey, largeData);
+
+			//only the large dataset is compressed
+			auto typeDir = defaults.storageDir();
+			QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+			auto files = dataFiles(typeDir);
+			QCOMPARE(files.size(), 2);
+			auto compressedCount = 0;
+			for(const auto &info : files) {
+				QFile file(info.absoluteFilePath());
+				QVERIFY(file.open(QIODevice::ReadOnly));
+				auto header = file.peek(RecordCodec::HeaderSize);
+				QVERIFY(RecordCodec::isRecord(header));
+				if(header[5] & RecordCodec::Compressed) {
+					compressedCount++;
+					QVERIFY(file.size() < 4096);
+				}
+			}
+			QCOMPARE(compressedCount, 1);
+
+			QCOMPARE(compressStore.load(smallKey), smallData);
+			QCOMPARE(compressStore.load(largeKey), largeData);
+			QCOMPAREUNORDERED(compressStore.loadAll(TestLib::TypeName), QList<QJsonObject>({smallData, largeData}));
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testChecksums()
+{
+	const auto key0 = TestLib::generateKey(110);
+	const auto data0 = TestLib::generateDataJson(110);
+	const auto key1 = TestLib::generateKey(111);
+	const auto data1 = TestLib::generateDataJson(111);
+
+	try {
+		auto nName = QStringLiteral("checksums");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.resetCacheSize()
+						.setChecksumAlgorithm(Setup::Blake2bChecksum)
+						.deferChecksums<TestData>();
+			});
+			LocalStore checksumStore(defaults);
+			checksumStore.save(key0, data0);
+
+			//deferred: nothing stored, but calculated on demand
+			auto database = defaults.aquireDatabase(this);
+			QSqlQuery checksumQuery(database);
+			checksumQuery.prepare(QStringLiteral("SELECT Checksum FROM DataIndex WHERE Type = ? AND Id = ?"));
+			checksumQuery.addBindValue(key0.typeName);
+			checksumQuery.addBindValue(key0.id);
+			QVERIFY(checksumQuery.exec());
+			QVERIFY(checksumQuery.first());
+			QVERIFY(checksumQuery.value(0).isNull());
+			{
+				auto scope = checksumStore.startSync(key0);
+				auto info = checksumStore.loadChangeInfo(scope);
+				QCOMPARE(std::get<3>(info), SyncHelper::jsonHash(data0, Setup::Blake2bChecksum));
+			}
+
+			//known checksums are stored as passed
+			auto checksum = SyncHelper::jsonHash(data1, Setup::Blake2bChecksum);
+			{
+				auto scope = checksumStore.startSync(key1);
+				checksumStore.storeChanged(scope, 1, QString(), data1, false, LocalStore::NoExists, checksum);
+				checksumStore.commitSync(scope);
+			}
+			{
+				auto scope = checksumStore.startSync(key1);
+				auto info = checksumStore.loadChangeInfo(scope);
+				QCOMPARE(std::get<3>(info), checksum);
+			}
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testShardedLayout()
+{
+	const auto key0 = TestLib::generateKey(115);
+	const auto data0 = TestLib::generateDataJson(115);
+	const auto key1 = TestLib::generateKey(116);
+	const auto data1 = TestLib::generateDataJson(116);
+
+	try {
+		auto nName = QStringLiteral("sharded");
+		{
+			auto defaults = createSetup(nName);
+			LocalStore shardStore(defaults);
+			shardStore.save(key0, data0);
+			shardStore.save(key1, data1);
+
+			//files are stored in two levels of shard directories
+			auto typeDir = defaults.storageDir();
+			QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+			QVERIFY(typeDir.entryList(QDir::Files).isEmpty());
+			auto files = dataFiles(typeDir);
+			QCOMPARE(files.size(), 2);
+			for(const auto &info : files) {
+				auto shard = typeDir.relativeFilePath(info.absolutePath());
+				QCOMPARE(shard, info.fileName().left(2) + QLatin1Char('/') + info.fileName().mid(2, 2));
+			}
+
+			//move the first file back to the old, flat layout
+			auto database = defaults.aquireDatabase(this);
+			QString location;
+			{
+				auto scope = shardStore.startSync(key0);
+				location = std::get<2>(shardStore.loadChangeInfo(scope));
+			}
+			auto flatName = location.mid(location.lastIndexOf(QLatin1Char('/')) + 1);
+			QVERIFY(QFile::rename(typeDir.absoluteFilePath(location + QStringLiteral(".dat")),
+								  typeDir.absoluteFilePath(flatName + QStringLiteral(".dat"))));
+			QSqlQuery flatQuery(database);
+			flatQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = ? WHERE Type = ? AND Id = ?"));
+			flatQuery.addBindValue(flatName);
+			flatQuery.addBindValue(key0.typeName);
+			flatQuery.addBindValue(key0.id);
+			QVERIFY(flatQuery.exec());
+			QCOMPARE(typeDir.entryList(QDir::Files).size(), 1);
+			QCOMPARE(shardStore.load(key0), data0);
+
+			//migration moves it into the shard again
+			shardStore.compactStorage();
+			QVERIFY(typeDir.entryList(QDir::Files).isEmpty());
+			QCOMPARE(dataFiles(typeDir).size(), 2);
+			QCOMPAREUNORDERED(shardStore.loadAll(TestLib::TypeName), QList<QJsonObject>({data0, data1}));
+
+			//removed behind the back of the store, like by a clear in another process
+			QVERIFY(QDir{typeDir.absolutePath()}.removeRecursively());
+			shardStore.save(key1, data1);
+			QCOMPARE(shardStore.load(key1), data1);
+
+			shardStore.clear(TestLib::TypeName);
+			QVERIFY(dataFiles(typeDir).isEmpty());
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testStatistics()
+{
+	try {
+		auto nName = QStringLiteral("statistics");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.resetCacheSize();
+			});
+			auto devId = QUuid::createUuid();
+			{
+				LocalStore statsStore(defaults);
+				for(auto i = 120; i < 125; i++)
+					statsStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+				statsStore.markUnchanged(TestLib::generateKey(120), 1, false);
+				statsStore.remove(TestLib::generateKey(121));
+				QCOMPARE(statsStore.count(TestLib::TypeName), 4ull);
+				QCOMPARE(statsStore.count("UnknownType"), 0ull);
+				QCOMPARE(statsStore.changeCount(), 4u);
+
+				//adding the same device twice must not count twice
+				statsStore.prepareAccountAdded(devId);
+				statsStore.prepareAccountAdded(devId);
+				QCOMPARE(statsStore.changeCount(), 8u);
+				statsStore.completeDeviceChanges(TestLib::generateKey(122), devId);
+				QCOMPARE(statsStore.changeCount(), 6u);
+			}
+
+			//stores without statistics count them once when opened
+			auto database = defaults.aquireDatabase(this);
+			QSqlQuery dropQuery(database);
+			QVERIFY(dropQuery.exec(QStringLiteral("DROP TABLE TypeStats")));
+			{
+				LocalStore statsStore(defaults);
+				QCOMPARE(statsStore.count(TestLib::TypeName), 4ull);
+				QCOMPARE(statsStore.changeCount(), 6u);
+
+				statsStore.clear(TestLib::TypeName);
+				QCOMPARE(statsStore.count(TestLib::TypeName), 0ull);
+				statsStore.reset(false);
+				QCOMPARE(statsStore.count(TestLib::TypeName), 0ull);
+				QCOMPARE(statsStore.changeCount(), 0u);
+			}
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testChangeSequence()
+{
+	try {
+		store->reset(false);
+		for(auto i = 130; i < 135; i++)
+			store->save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+		store->markUnchanged(TestLib::generateKey(131), 1, false);
+
+		//changes are returned in order, continuing after the cursor
+		quint64 cursor = 0;
+		QList<ObjectKey> keys;
+		auto collector = [&](ObjectKey k, quint64, QString, QUuid) {
+			keys.append(k);
+			return true;
+		};
+		store->loadChanges(2, cursor, collector);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(130), TestLib::generateKey(132)}));
+		keys.clear();
+		store->loadChanges(2, cursor, collector);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(133), TestLib::generateKey(134)}));
+		keys.clear();
+		store->loadChanges(2, cursor, collector);
+		QVERIFY(keys.isEmpty());
+
+		//changing again moves the key behind the cursor
+		const auto lastCursor = cursor;
+		store->save(TestLib::generateKey(130), TestLib::generateDataJson(130, QStringLiteral("changed")));
+		store->remove(TestLib::generateKey(131));
+		store->loadChanges(10, cursor, collector);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(130), TestLib::generateKey(131)}));
+		QVERIFY(cursor > lastCursor);
+		keys.clear();
+
+		//numbers never decrease, even if the newest change is completed
+		store->markUnchanged(TestLib::generateKey(131), 2, true);
+		store->save(TestLib::generateKey(135), TestLib::generateDataJson(135));
+		store->loadChanges(10, cursor, collector);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(135)}));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testTrashSweep()
+{
+	try {
+		auto nName = QStringLiteral("trash");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.resetCacheSize();
+			});
+			auto trashDir = defaults.storageDir();
+			QVERIFY(trashDir.mkpath(QStringLiteral("trash/leftover/ab/cd")));
+			QVERIFY(trashDir.cd(QStringLiteral("trash")));
+			for(auto i = 0; i < 10; i++) {
+				QFile file{trashDir.absoluteFilePath(QStringLiteral("leftover/ab/cd/%1.dat").arg(i))};
+				QVERIFY(file.open(QIODevice::WriteOnly));
+				file.write("junk");
+			}
+
+			//leftovers of a previous run are removed on start
+			LocalStore trashStore(defaults);
+			QTRY_VERIFY(!trashDir.exists());
+
+			//clearing moves the directory away, the files are removed later
+			for(auto i = 140; i < 150; i++)
+				trashStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i, QString(2048, QLatin1Char('t'))));
+			auto typeDir = defaults.storageDir();
+			QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+			trashStore.clear(TestLib::TypeName);
+			QVERIFY(!typeDir.exists());
+			QCOMPARE(trashStore.count(TestLib::TypeName), 0ull);
+			QTRY_VERIFY(!trashDir.exists());
+
+			//the store can be used again right away
+			trashStore.save(TestLib::generateKey(140), TestLib::generateDataJson(140, QString(2048, QLatin1Char('t'))));
+			QCOMPARE(dataFiles(typeDir).size(), 1);
+			trashStore.reset(false);
+			QVERIFY(!defaults.storageDir().exists(QStringLiteral("store")));
+			QTRY_VERIFY(!trashDir.exists());
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testWriteCoalescing()
+{
+	try {
+		auto nName = QStringLiteral("coalescing");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.resetCacheSize()
+						.setCoalescingWindow(60000);
+			});
+			LocalStore coalStore(defaults);
+			auto key0 = TestLib::generateKey(150);
+			auto key1 = TestLib::generateKey(151);
+
+			//repeated saves are kept in memory, but loaded as saved
+			for(auto i = 0; i < 10; i++)
+				coalStore.save(key0, TestLib::generateDataJson(150, QString::number(i)));
+			coalStore.save(key1, TestLib::generateDataJson(151));
+			QCOMPARE(coalStore.load(key0), TestLib::generateDataJson(150, QStringLiteral("9")));
+			QCOMPARE(coalStore.changeCount(), 0u);
+
+			//flushing writes only the last state
+			coalStore.flush();
+			QCOMPARE(coalStore.changeCount(), 2u);
+			auto scope = coalStore.startSync(key0);
+			QCOMPARE(std::get<1>(coalStore.loadChangeInfo(scope)), 1ull);
+			coalStore.commitSync(scope);
+
+			//reading the type writes it first
+			coalStore.save(key0, TestLib::generateDataJson(150, QStringLiteral("changed")));
+			coalStore.save(TestLib::generateKey(152), TestLib::generateDataJson(152));
+			QCOMPARE(coalStore.count(TestLib::TypeName), 3ull);
+			QCOMPARE(coalStore.changeCount(), 3u);
+			{
+				LocalStore otherStore(defaults);
+				QCOMPARE(otherStore.load(key0), TestLib::generateDataJson(150, QStringLiteral("changed")));
+			}
+
+			//cleared datasets are never written
+			coalStore.save(TestLib::generateKey(153), TestLib::generateDataJson(153));
+			coalStore.clear(TestLib::TypeName);
+			coalStore.flush();
+			QCOMPARE(coalStore.count(TestLib::TypeName), 0ull);
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testGroupCommit_data()
+{
+	QTest::addColumn<Setup::Durability>("durability");
+	QTest::addColumn<Setup::StorageEngine>("engine");
+
+	QTest::newRow("normal.file") << Setup::DurabilityNormal
+								 << Setup::FileStorage;
+	QTest::newRow("normal.pack") << Setup::DurabilityNormal
+								 << Setup::PackStorage;
+	QTest::newRow("relaxed.file") << Setup::DurabilityRelaxed
+								  << Setup::FileStorage;
+	QTest::newRow("relaxed.pack") << Setup::DurabilityRelaxed
+								  << Setup::PackStorage;
+}
+
+void TestLocalStore::testGroupCommit()
+{
+	QFETCH(Setup::Durability, durability);
+	QFETCH(Setup::StorageEngine, engine);
+
+	try {
+		auto nName = QStringLiteral("groupcommit.") + QString::fromUtf8(QTest::currentDataTag());
+		{
+			auto defaults = createSetup(nName, [&](Setup &setup) {
+				setup.resetCacheSize()
+						.setDurability(durability)
+						.setStorageEngine(engine);
+			});
+			const auto threads = 4 * QThread::idealThreadCount();
+			const auto perThread = 10;
+
+			//concurrent saves of different and the same keys
+			QList<QFuture<void>> futures;
+			for(auto t = 0; t < threads; t++) {
+				futures.append(QtConcurrent::run([&, t](){
+					LocalStore lStore(defaults);//thread without eventloop!
+					for(auto i = 0; i < perThread; i++) {
+						lStore.save(TestLib::generateKey(1000 + t * perThread + i),
+									TestLib::generateDataJson(1000 + t * perThread + i, QString(2048, QLatin1Char('g'))));
+						lStore.save(TestLib::generateKey(160), TestLib::generateDataJson(160, QString::number(t)));
+					}
+				}));
+			}
+			for(auto f : futures)
+				f.waitForFinished();
+
+			LocalStore groupStore(defaults);
+			QCOMPARE(groupStore.count(TestLib::TypeName), static_cast<quint64>(threads * perThread + 1));
+			for(auto i = 0; i < threads * perThread; i++) {
+				QCOMPARE(groupStore.load(TestLib::generateKey(1000 + i)),
+						 TestLib::generateDataJson(1000 + i, QString(2048, QLatin1Char('g'))));
+			}
+			auto scope = groupStore.startSync(TestLib::generateKey(160));
+			QCOMPARE(std::get<1>(groupStore.loadChangeInfo(scope)), static_cast<quint64>(threads * perThread));
+			groupStore.commitSync(scope);
+
+			//replacing data still leaves only the latest file
+			if(engine == Setup::FileStorage) {
+				auto typeDir = defaults.storageDir();
+				QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+				const auto fileCount = dataFiles(typeDir).size();
+				groupStore.save(TestLib::generateKey(1000), TestLib::generateDataJson(1000, QString(2048, QLatin1Char('r'))));
+				QCOMPARE(dataFiles(typeDir).size(), fileCount);
+				QCOMPARE(groupStore.load(TestLib::generateKey(1000)), TestLib::generateDataJson(1000, QString(2048, QLatin1Char('r'))));
+			}
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testObjectCache()
+{
+	ObjectCache cache{100 * 1024};
+	auto hotKey = TestLib::generateKey(170);
+	QJsonObject data;
+
+	//frequently used entries survive a scan over many new ones
+	cache.put(hotKey, TestLib::generateDataJson(170), 1024);
+	for(auto i = 0; i < 10; i++)
+		QVERIFY(cache.get(hotKey, data));
+	for(auto i = 0; i < 1000; i++)
+		cache.put(TestLib::generateKey(2000 + i), TestLib::generateDataJson(2000 + i), 1024);
+	QVERIFY(cache.get(hotKey, data));
+	QCOMPARE(data, TestLib::generateDataJson(170));
+	QVERIFY(cache.totalCost() <= cache.maxCost());
+
+	//replace and remove entries
+	cache.put(hotKey, TestLib::generateDataJson(170, QStringLiteral("changed")), 2048);
+	QVERIFY(cache.get(hotKey, data));
+	QCOMPARE(data, TestLib::generateDataJson(170, QStringLiteral("changed")));
+	QVERIFY(cache.remove(hotKey));
+	QVERIFY(!cache.get(hotKey, data));
+	QVERIFY(!cache.remove(hotKey));
+
+	//typed values belong to the data they were created from
+	auto generation = cache.put(hotKey, data, 1024);
+	QVERIFY(generation != 0);
+	QVariant value;
+	QVERIFY(!cache.getTyped(hotKey, QMetaType::QString, value));
+	cache.putTyped(hotKey, generation, QMetaType::QString, QStringLiteral("typed"));
+	QVERIFY(cache.getTyped(hotKey, QMetaType::QString, value));
+	QCOMPARE(value.toString(), QStringLiteral("typed"));
+	QVERIFY(!cache.getTyped(hotKey, QMetaType::QByteArray, value));
+	auto newGeneration = cache.put(hotKey, data, 1024);
+	QVERIFY(newGeneration != generation);
+	QVERIFY(!cache.getTyped(hotKey, QMetaType::QString, value));
+	cache.putTyped(hotKey, generation, QMetaType::QString, QStringLiteral("outdated"));
+	QVERIFY(!cache.getTyped(hotKey, QMetaType::QString, value));
+	cache.putTyped(hotKey, newGeneration, QMetaType::QString, QStringLiteral("typed"));
+	QVERIFY(cache.remove(hotKey));
+	QVERIFY(!cache.getTyped(hotKey, QMetaType::QString, value));
+
+	//entries larger than the cache are never cached
+	cache.put(hotKey, data, cache.maxCost() + 1);
+	QVERIFY(!cache.get(hotKey, data));
+
+	//entries that fit the shard, but not its main segments, are rejected as well
+	QCOMPARE(cache.totalCost(), 0);
+	cache.put(TestLib::generateKey(171), TestLib::generateDataJson(171), 1024);
+	QVERIFY(cache.get(TestLib::generateKey(171), data));
+	cache.put(hotKey, data, cache.maxCost() * 995 / 1000);
+	QVERIFY(!cache.get(hotKey, data));
+	QVERIFY(cache.totalCost() <= cache.maxCost());
+	QVERIFY(cache.put(hotKey, data, cache.maxCost() / 2) != 0);
+	QVERIFY(cache.get(hotKey, data));
+	QVERIFY(cache.totalCost() <= cache.maxCost());
+
+	cache.clear();
+	QCOMPARE(cache.totalCost(), 0);
+}
+
+void TestLocalStore::testCacheStatistics()
+{
+	ObjectCache cache{100 * 1024};
+	QJsonObject data;
+
+	QVERIFY(cache.statistics().isEmpty());
+	cache.put(TestLib::generateKey(180), TestLib::generateDataJson(180), 1024);
+	cache.put(TestLib::generateKey(181), TestLib::generateDataJson(181), 1024);
+	cache.put(TestLib::generateKey(180), TestLib::generateDataJson(180), 2048);
+	QVERIFY(cache.get(TestLib::generateKey(180), data));
+	QVERIFY(!cache.get(TestLib::generateKey(182), data));
+	cache.put(TestLib::generateKey(183), data, cache.maxCost() + 1);
+
+	auto stats = cache.statistics();
+	QCOMPARE(stats.size(), 1);
+	auto typeStats = stats.value(TestLib::TypeName);
+	QCOMPARE(typeStats.hits, 1ull);
+	QCOMPARE(typeStats.misses, 1ull);
+	QCOMPARE(typeStats.inserts, 3ull);
+	QCOMPARE(typeStats.evictions, 1ull);
+	QCOMPARE(typeStats.bytes, 3072ll);
+	QCOMPARE(typeStats.costModel, Setup::StoredSizeCost);
+
+	QVERIFY(cache.remove(TestLib::generateKey(181)));
+	QCOMPARE(cache.statistics().value(TestLib::TypeName).bytes, 2048ll);
+	cache.clear();
+	typeStats = cache.statistics().value(TestLib::TypeName);
+	QCOMPARE(typeStats.bytes, 0ll);
+	QCOMPARE(typeStats.inserts, 3ull);
+
+	//the memory cost model ignores the passed cost
+	ObjectCache memoryCache{100 * 1024, Setup::MemorySizeCost};
+	auto generation = memoryCache.put(TestLib::generateKey(180), TestLib::generateDataJson(180), 1);
+	QVERIFY(generation != 0);
+	auto dataCost = memoryCache.totalCost();
+	QVERIFY(dataCost > QJsonDocument(TestLib::generateDataJson(180)).toBinaryData().size());
+	QCOMPARE(memoryCache.statistics().value(TestLib::TypeName).bytes, static_cast<qint64>(dataCost));
+	memoryCache.putTyped(TestLib::generateKey(180), generation, QMetaType::QString, QStringLiteral("typed"));
+	QCOMPARE(memoryCache.totalCost(), dataCost + QMetaType::sizeOf(QMetaType::QString));
+	QCOMPARE(memoryCache.statistics().value(TestLib::TypeName).costModel, Setup::MemorySizeCost);
+}
+
+void TestLocalStore::testPreload()
+{
+	try {
+		auto nName = QStringLiteral("preload");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.resetCacheSize()
+						.preload<TestData>(2);
+			});
+			auto cache = defaults.cacheHandle().value<QSharedPointer<ObjectCache>>();
+			QVERIFY(cache);
+			QVERIFY(defaults.accessTracker()->isTracked(TestLib::TypeName));
+
+			LocalStore preloadStore{defaults};
+			for(auto i = 0; i < 5; i++)
+				preloadStore.save(TestLib::generateKey(190 + i), TestLib::generateDataJson(190 + i));
+			//the hints have a resolution of milliseconds
+			for(auto i = 0; i < 5; i++) {
+				QThread::msleep(2);
+				preloadStore.load(TestLib::generateKey(190 + i));
+			}
+			preloadStore.flushAccessHints();
+
+			//only the most recently loaded datasets are preloaded
+			cache->clear();
+			QCOMPARE(preloadStore.preload(TestLib::TypeName, 2), 2);
+			QJsonObject data;
+			QVERIFY(cache->get(TestLib::generateKey(194), data));
+			QCOMPARE(data, TestLib::generateDataJson(194));
+			QVERIFY(cache->get(TestLib::generateKey(193), data));
+			QVERIFY(!cache->get(TestLib::generateKey(190), data));
+
+			//or all of them
+			cache->clear();
+			QCOMPARE(preloadStore.preload(TestLib::TypeName, 0), 5);
+			for(auto i = 0; i < 5; i++)
+				QVERIFY(cache->get(TestLib::generateKey(190 + i), data));
+
+			//hints of removed datasets are gone as well
+			QVERIFY(preloadStore.remove(TestLib::generateKey(194)));
+			cache->clear();
+			QCOMPARE(preloadStore.preload(TestLib::TypeName, 2), 2);
+			QVERIFY(cache->get(TestLib::generateKey(192), data));
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testKeyFilter()
+{
+	try {
+		auto keyFilter = DefaultsPrivate::obtainDefaults(DefaultSetup)->keyFilter();
+		store->clear(TestLib::TypeName);
+		QVERIFY(!keyFilter->isReady(TestLib::TypeName));
+
+		//the first check builds the filter from the stored keys
+		store->save(TestLib::generateKey(200), TestLib::generateDataJson(200));
+		QVERIFY(!store->contains(TestLib::generateKey(201)));
+		QVERIFY(keyFilter->isReady(TestLib::TypeName));
+		QVERIFY(keyFilter->mayContain(TestLib::generateKey(200)));
+		QVERIFY(store->contains(TestLib::generateKey(200)));
+
+		//saved keys are added, removed ones are checked in the store
+		store->save(TestLib::generateKey(201), TestLib::generateDataJson(201));
+		QVERIFY(keyFilter->mayContain(TestLib::generateKey(201)));
+		QVERIFY(store->contains(TestLib::generateKey(201)));
+		QVERIFY(store->remove(TestLib::generateKey(200)));
+		QVERIFY(!store->contains(TestLib::generateKey(200)));
+
+		QJsonObject data;
+		QVERIFY(store->tryLoad(TestLib::generateKey(201), data));
+		QCOMPARE(data, TestLib::generateDataJson(201));
+		QVERIFY(!store->tryLoad(TestLib::generateKey(202), data));
+		QVERIFY_EXCEPTION_THROWN(store->load(TestLib::generateKey(202)), NoDataException);
+
+		//most missing keys never reach the database
+		auto falsePositives = 0;
+		for(auto i = 0; i < 1000; i++) {
+			if(keyFilter->mayContain(TestLib::generateKey(10000 + i)))
+				falsePositives++;
+		}
+		QVERIFY(falsePositives < 50);
+
+		//keys stored by another connection are found before any change notification arrives
+		const auto foreignKey = TestLib::generateKey(203);
+		QVERIFY(!store->contains(foreignKey));
+		{
+			auto foreignDb = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("foreign"));
+			foreignDb.setDatabaseName(DefaultsPrivate::obtainDefaults(DefaultSetup)->storageDir().absoluteFilePath(QStringLiteral("store.db")));
+			QVERIFY(foreignDb.open());
+			QSqlQuery foreignQuery(foreignDb);
+			foreignQuery.prepare(QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Changed, Data) VALUES(?, ?, 1, ':inline', 1, x'00')"));
+			foreignQuery.addBindValue(foreignKey.typeName);
+			foreignQuery.addBindValue(foreignKey.id);
+			QVERIFY2(foreignQuery.exec(), qUtf8Printable(foreignQuery.lastError().text()));
+			foreignDb.close();
+		}
+		QSqlDatabase::removeDatabase(QStringLiteral("foreign"));
+		QVERIFY(store->contains(foreignKey));
+		QVERIFY(keyFilter->mayContain(foreignKey));
+
+		//cleared types are built again
+		store->clear(TestLib::TypeName);
+		QVERIFY(!keyFilter->isReady(TestLib::TypeName));
+		QVERIFY(!store->contains(TestLib::generateKey(201)));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testRecordFormat()
+{
+	const auto key0 = TestLib::generateKey(210);
+	const auto data0 = TestLib::generateDataJson(210);
+	const auto key1 = TestLib::generateKey(211);
+	const auto data1 = TestLib::generateDataJson(211);
+
+	//every json type survives the round trip
+	QJsonObject complex {
+		{QStringLiteral("null"), QJsonValue::Null},
+		{QStringLiteral("bools"), QJsonArray{true, false}},
+		{QStringLiteral("ints"), QJsonArray{0, 30, 31, -1, -4096, 9007199254740992.0}},
+		{QStringLiteral("doubles"), QJsonArray{0.5, -1e300, 1e20}},
+		{QStringLiteral("text"), QStringLiteral("\u00e4\u00f6\u00fc - %1").arg(QString(64, QLatin1Char('x')))},
+		{QStringLiteral("nested"), QJsonObject{{QStringLiteral("empty"), QJsonObject{}}, {QString(), QJsonArray{}}}}
+	};
+	auto record = RecordCodec::createRecord(RecordCodec::encodeBody(complex));
+	QVERIFY(RecordCodec::isRecord(record));
+	QJsonObject decoded;
+	QString error;
+	auto bodySize = 0;
+	QVERIFY2(RecordCodec::readRecord(record, decoded, error, &bodySize), qUtf8Printable(error));
+	QCOMPARE(decoded, complex);
+	QCOMPARE(bodySize, record.size() - RecordCodec::HeaderSize);
+
+	auto compressed = RecordCodec::createRecord(qCompress(RecordCodec::encodeBody(complex)), RecordCodec::Compressed);
+	QVERIFY2(RecordCodec::readRecord(compressed, decoded, error), qUtf8Printable(error));
+	QCOMPARE(decoded, complex);
+
+	//damaged records are detected
+	auto damaged = record;
+	damaged[damaged.size() - 1] = static_cast<char>(damaged[damaged.size() - 1] ^ 0x01);
+	QVERIFY(!RecordCodec::readRecord(damaged, decoded, error));
+	QVERIFY(!RecordCodec::readRecord(RecordCodec::createRecord(record.mid(RecordCodec::HeaderSize, 10)), decoded, error));
+	QVERIFY(!RecordCodec::isRecord(QJsonDocument(complex).toBinaryData()));
+
+	try {
+		auto nName = QStringLiteral("format");
+		{
+			auto defaults = createSetup(nName);
+			LocalStore formatStore(defaults);
+			formatStore.save(key0, data0);
+			formatStore.save(key1, data1);
+			QVERIFY(!formatStore.convertLegacyRecords(10));
+
+			//replace the first dataset by binary json, as written by older versions
+			auto typeDir = defaults.storageDir();
+			QVERIFY(typeDir.cd(QStringLiteral("store/data_TestData")));
+			QString location;
+			{
+				auto scope = formatStore.startSync(key0);
+				location = std::get<2>(formatStore.loadChangeInfo(scope));
+			}
+			QFile file(typeDir.absoluteFilePath(location + QStringLiteral(".dat")));
+			QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+			file.write(QJsonDocument(data0).toBinaryData());
+			file.close();
+			auto database = defaults.aquireDatabase(this);
+			QSqlQuery legacyQuery(database);
+			legacyQuery.prepare(QStringLiteral("UPDATE DataIndex SET Format = NULL WHERE Type = ? AND Id = ?"));
+			legacyQuery.addBindValue(key0.typeName);
+			legacyQuery.addBindValue(key0.id);
+			QVERIFY(legacyQuery.exec());
+			QCOMPARE(formatStore.load(key0), data0);
+
+			//conversion rewrites it in batches
+			QVERIFY(formatStore.convertLegacyRecords(1));
+			QVERIFY(!formatStore.convertLegacyRecords(1));
+			{
+				auto scope = formatStore.startSync(key0);
+				location = std::get<2>(formatStore.loadChangeInfo(scope));
+			}
+			file.setFileName(typeDir.absoluteFilePath(location + QStringLiteral(".dat")));
+			QVERIFY(file.open(QIODevice::ReadOnly));
+			QVERIFY(RecordCodec::isRecord(file.readAll()));
+			file.close();
+			QCOMPAREUNORDERED(formatStore.loadAll(TestLib::TypeName), QList<QJsonObject>({data0, data1}));
+
+			//a damaged dataset fails to load instead of returning wrong data
+			QVERIFY(file.open(QIODevice::ReadWrite));
+			QVERIFY(file.seek(file.size() - 1));
+			auto last = file.peek(1);
+			file.write(QByteArray(1, static_cast<char>(last[0] ^ 0x01)));
+			file.close();
+			QVERIFY_EXCEPTION_THROWN(formatStore.load(key0), LocalStoreException);
+		}
+
+		removeSetup(nName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::benchmarkCacheContention_data()
+{
+	QTest::addColumn<int>("threads");
+
+	for(auto threads : {1, 4, 16})
+		QTest::addRow("threads-%d", threads) << threads;
+}
+
+void TestLocalStore::benchmarkCacheContention()
+{
+	QFETCH(int, threads);
+
+	const auto keyCount = 10000;
+	const auto opCount = 10000;
+	ObjectCache cache{100 * 1024 * 1024};
+	QList<ObjectKey> keys;
+	QList<QJsonObject> values;
+	QList<int> costs;
+	for(auto i = 0; i < keyCount; i++) {
+		keys.append(TestLib::generateKey(i));
+		values.append(TestLib::generateDataJson(i));
+		costs.append(1024);
+	}
+	cache.put(keys, values, costs);
+
+	//mostly reads, every tenth operation replaces an entry
+	QThreadPool pool;
+	pool.setMaxThreadCount(threads);
+	QBENCHMARK {
+		for(auto t = 0; t < threads; t++) {
+			QtConcurrent::run(&pool, [&, t](){
+				QJsonObject data;
+				for(auto i = 0; i < opCount; i++) {
+					auto index = (i * 7919 + t * 104729) % keyCount;
+					if(i % 10 == 0)
+						cache.put(keys[index], values[index], costs[index]);
+					else
+						cache.get(keys[index], data);
+				}
+			});
+		}
+		pool.waitForDone();
+	}
+}
+
+void TestLocalStore::benchmarkRecordFormat_data()
+{
+	QTest::addColumn<bool>("legacy");
+
+	QTest::newRow("binaryjson") << true;
+	QTest::newRow("record") << false;
+}
+
+void TestLocalStore::benchmarkRecordFormat()
+{
+	QFETCH(bool, legacy);
+
+	QList<QByteArray> encoded;
+	auto legacySize = 0;
+	auto recordSize = 0;
+	for(auto i = 0; i < 1000; i++) {
+		auto data = TestLib::generateDataJson(i, QStringLiteral("text %1").arg(i));
+		data[QStringLiteral("values")] = QJsonArray{i, i * 0.5, QString::number(i), i % 2 == 0};
+		data[QStringLiteral("nested")] = QJsonObject{{QStringLiteral("id"), i}, {QStringLiteral("flag"), true}};
+		auto legacyData = QJsonDocument(data).toBinaryData();
+		auto recordData = RecordCodec::createRecord(RecordCodec::encodeBody(data));
+		legacySize += legacyData.size();
+		recordSize += recordData.size();
+		encoded.append(legacy ? legacyData : recordData);
+	}
+	//the records must be smaller than the binary json they replace
+	QVERIFY(recordSize < legacySize);
+
+	//decoding includes reading every value, as binary json is only parsed lazily
+	QBENCHMARK {
+		for(const auto &data : qAsConst(encoded)) {
+			QJsonObject object;
+			if(legacy)
+				object = QJsonDocument::fromBinaryData(data).object();
+			else {
+				QString error;
+				RecordCodec::readRecord(data, object, error);
+			}
+			for(auto it = object.constBegin(); it != object.constEnd(); it++)
+				QVERIFY(!it.value().isUndefined());
+		}
+	}
+}
+
+Defaults TestLocalStore::createSetup(const QString &name, const std::function<void(Setup&)> &configure)
+{
+	Setup setup;
+	TestLib::setup(setup);
+	//every setup gets its own directory, and the cache is disabled to always read from the store
+	setup.setLocalDir(setup.localDir() + QLatin1Char('/') + name)
+			.setCacheSize(0);
+	if(configure)
+		configure(setup);
+	setup.create(name);
+	return Defaults{DefaultsPrivate::obtainDefaults(name)};
+}
+
+void TestLocalStore::removeSetup(const QString &name)
+{
+	Setup::removeSetup(name, true);
+}
+
+QFileInfoList TestLocalStore::dataFiles(const QDir &typeDir)
+{
+	QFileInfoList files;
+	QDirIterator iterator(typeDir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+	while(iterator.hasNext()) {
+		iterator.next();
+		files.append(iterator.fileInfo());
+	}
+	return files;
+}
+
 QTEST_MAIN(TestLocalStore)
 
 #include "tst_localstore.moc"
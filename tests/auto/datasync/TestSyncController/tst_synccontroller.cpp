@@ -27,9 +27,18 @@ private Q_SLOTS:
 	void testResolver_data();
 	void testResolver();
 
+	void testJsonHash_data();
+	void testJsonHash();
+	void benchmarkJsonHash_data();
+	void benchmarkJsonHash();
+
 private:
 	LocalStore *store;
 	SyncController *controller;
+
+	static QJsonObject generateHashData(int size);
+	static QByteArray legacyJsonHash(const QJsonObject &object);
+	static void legacyHashNext(QCryptographicHash &hash, const QJsonValue &value);
 };
 
 void TestSyncController::initTestCase()
@@ -574,6 +583,135 @@ void TestSyncController::testResolver()
 	}
 }
 
+void TestSyncController::testJsonHash_data()
+{
+	QTest::addColumn<QJsonObject>("data");
+
+	QTest::newRow("empty") << QJsonObject();
+	QTest::newRow("small") << generateHashData(1);
+	QTest::newRow("medium") << generateHashData(50);
+	QTest::newRow("unicode") << QJsonObject({
+												{QStringLiteral("k\u00e4y"), QStringLiteral("v\u00e4lue \u263a")},
+												{QStringLiteral("num"), 0.1},
+												{QStringLiteral("null"), QJsonValue::Null}
+											});
+}
+
+void TestSyncController::testJsonHash()
+{
+	QFETCH(QJsonObject, data);
+
+	//sha3 checksums must stay identical to existing ones
+	auto sha3 = SyncHelper::jsonHash(data);
+	QCOMPARE(sha3, legacyJsonHash(data));
+	QCOMPARE(SyncHelper::jsonHash(data, Setup::Sha3Checksum), sha3);
+	QCOMPARE(SyncHelper::checksumAlgorithm(sha3), Setup::Sha3Checksum);
+
+	auto blake2b = SyncHelper::jsonHash(data, Setup::Blake2bChecksum);
+	QCOMPARE(blake2b.size(), 33);
+	QVERIFY(blake2b != sha3);
+	QCOMPARE(SyncHelper::jsonHash(data, Setup::Blake2bChecksum), blake2b);
+	QCOMPARE(SyncHelper::checksumAlgorithm(blake2b), Setup::Blake2bChecksum);
+}
+
+void TestSyncController::benchmarkJsonHash_data()
+{
+	QTest::addColumn<QJsonObject>("data");
+	QTest::addColumn<int>("mode"); //0: legacy, 1: sha3, 2: blake2b
+
+	for(auto size : {1, 10, 100, 1000}) {
+		auto data = generateHashData(size);
+		QTest::addRow("legacy-%d", size) << data << 0;
+		QTest::addRow("sha3-%d", size) << data << 1;
+		QTest::addRow("blake2b-%d", size) << data << 2;
+	}
+}
+
+void TestSyncController::benchmarkJsonHash()
+{
+	QFETCH(QJsonObject, data);
+	QFETCH(int, mode);
+
+	switch(mode) {
+	case 0:
+		QBENCHMARK {
+			legacyJsonHash(data);
+		}
+		break;
+	case 1:
+		QBENCHMARK {
+			SyncHelper::jsonHash(data, Setup::Sha3Checksum);
+		}
+		break;
+	case 2:
+		QBENCHMARK {
+			SyncHelper::jsonHash(data, Setup::Blake2bChecksum);
+		}
+		break;
+	default:
+		Q_UNREACHABLE();
+		break;
+	}
+}
+
+QJsonObject TestSyncController::generateHashData(int size)
+{
+	QJsonObject data;
+	for(auto i = 0; i < size; i++) {
+		data.insert(QStringLiteral("text%1").arg(i), QStringLiteral("Some text for the value %1").arg(i));
+		data.insert(QStringLiteral("number%1").arg(i), i * 1.5);
+		data.insert(QStringLiteral("flag%1").arg(i), i % 2 == 0);
+		if(i % 10 == 0) {
+			data.insert(QStringLiteral("child%1").arg(i), QJsonObject {
+							{QStringLiteral("list"), QJsonArray {i, QStringLiteral("entry"), QJsonValue::Null}},
+							{QStringLiteral("name"), QStringLiteral("child")}
+						});
+		}
+	}
+	return data;
+}
+
+//the original, recursive implementation, kept as reference
+QByteArray TestSyncController::legacyJsonHash(const QJsonObject &object)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha3_256);
+	legacyHashNext(hash, object);
+	return hash.result();
+}
+
+void TestSyncController::legacyHashNext(QCryptographicHash &hash, const QJsonValue &value)
+{
+	switch (value.type()) {
+	case QJsonValue::Null:
+		hash.addData("null");
+		break;
+	case QJsonValue::Bool:
+		hash.addData(value.toBool() ? "true" : "false");
+		break;
+	case QJsonValue::Double:
+		hash.addData(QByteArray::number(value.toDouble(), 'g', QLocale::FloatingPointShortest));
+		break;
+	case QJsonValue::String:
+		hash.addData(value.toString().toUtf8());
+		break;
+	case QJsonValue::Array:
+		for(auto v : value.toArray())
+			legacyHashNext(hash, v);
+		break;
+	case QJsonValue::Object:
+	{
+		auto obj = value.toObject();
+		for(auto it = obj.begin(); it != obj.end(); it++) {
+			hash.addData(it.key().toUtf8());
+			legacyHashNext(hash, it.value());
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
 QTEST_MAIN(TestSyncController)
 
 #include "tst_synccontroller.moc"